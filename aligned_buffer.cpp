@@ -0,0 +1,190 @@
+/* aligned_buffer.cpp */
+#include "aligned_buffer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <vector>
+
+#if __has_include(<sys/mman.h>) && __has_include(<unistd.h>)
+#include <sys/mman.h>
+#include <unistd.h>
+#define MK_HAVE_MMAP 1
+#endif
+
+namespace mk
+{
+
+const char *toString(PageKind kind)
+{
+    switch (kind)
+    {
+    case PageKind::None:
+        return "none";
+    case PageKind::Heap:
+        return "heap";
+    case PageKind::Normal:
+        return "normal pages";
+    case PageKind::TransparentHuge:
+        return "transparent huge pages";
+    case PageKind::ExplicitHuge:
+        return "explicit huge pages";
+    }
+    return "?";
+}
+
+namespace detail
+{
+
+namespace
+{
+
+constexpr std::size_t hugePageSize = std::size_t{2} << 20; // 2 MB
+
+std::size_t roundUp(std::size_t n, std::size_t multiple)
+{
+    return (n + multiple - 1) / multiple * multiple;
+}
+
+std::size_t pageSize()
+{
+#ifdef MK_HAVE_MMAP
+    static const std::size_t size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+#else
+    return 4096;
+#endif
+}
+
+#ifdef MK_HAVE_MMAP
+
+void *mapAnonymous(std::size_t bytes, int extraFlags)
+{
+    void *p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | extraFlags, -1, 0);
+    return p == MAP_FAILED ? nullptr : p;
+}
+
+// Map bytes starting at a multiple of alignment: map alignment more than needed, and unmap the ends.
+bool mapAligned(PageBlock &block, std::size_t bytes, std::size_t alignment)
+{
+    std::size_t length = roundUp(bytes, pageSize());
+    std::size_t slack = alignment > pageSize() ? alignment : 0;
+    char *p = static_cast<char *>(mapAnonymous(length + slack, 0));
+    if (p == nullptr)
+        return false;
+
+    char *start = reinterpret_cast<char *>(roundUp(reinterpret_cast<std::uintptr_t>(p), alignment));
+    if (start > p)
+        munmap(p, static_cast<std::size_t>(start - p));
+    char *end = p + length + slack;
+    if (end > start + length)
+        munmap(start + length, static_cast<std::size_t>(end - (start + length)));
+
+    block.data = block.mapping = start;
+    block.mappingBytes = length;
+    return true;
+}
+
+#endif
+
+} // namespace
+
+PageBlock allocatePages(std::size_t bytes, const AlignedBufferOptions &options)
+{
+    assert(options.alignment > 0 && (options.alignment & (options.alignment - 1)) == 0);
+
+    PageBlock block;
+    if (bytes == 0)
+        return block;
+    block.bytes = bytes;
+
+#ifdef MK_HAVE_MMAP
+    // A buffer smaller than a huge page cannot use one: no point in aligning it to 2 MB.
+    bool wantHuge = options.pages != PagePolicy::Normal && bytes >= hugePageSize;
+
+#ifdef MAP_HUGETLB
+    if (wantHuge && options.pages == PagePolicy::ExplicitHuge && options.alignment <= hugePageSize)
+    {
+        std::size_t length = roundUp(bytes, hugePageSize);
+        if (void *p = mapAnonymous(length, MAP_HUGETLB))
+        {
+            block.data = block.mapping = p;
+            block.mappingBytes = length;
+            block.kind = PageKind::ExplicitHuge;
+            return block;
+        }
+        // no reserved huge pages: try transparent ones
+    }
+#endif
+
+    // whole huge pages only, so that the end of the buffer can be one as well
+    std::size_t length = wantHuge ? roundUp(bytes, hugePageSize) : bytes;
+    if (mapAligned(block, length, std::max(options.alignment, wantHuge ? hugePageSize : pageSize())))
+    {
+        block.kind = PageKind::Normal;
+#ifdef MADV_HUGEPAGE
+        if (wantHuge && madvise(block.mapping, block.mappingBytes, MADV_HUGEPAGE) == 0)
+            block.kind = PageKind::TransparentHuge;
+#endif
+        return block;
+    }
+#endif
+
+    // no mmap (or it failed): the heap; throws bad_alloc if that fails as well
+    block.alignment = std::max(options.alignment, alignof(std::max_align_t));
+    block.mappingBytes = roundUp(bytes, block.alignment);
+    block.data = block.mapping = ::operator new(block.mappingBytes, std::align_val_t{block.alignment});
+    std::memset(block.data, 0, block.mappingBytes);
+    block.kind = PageKind::Heap;
+    return block;
+}
+
+void freePages(PageBlock &block) noexcept
+{
+    if (block.kind == PageKind::Heap)
+        ::operator delete(block.mapping, std::align_val_t{block.alignment});
+#ifdef MK_HAVE_MMAP
+    else if (block.kind != PageKind::None)
+        munmap(block.mapping, block.mappingBytes);
+#endif
+    block = {};
+}
+
+// Write one byte per page: the first write to a page faults it in (a read would map the shared zero page instead).
+// Transparent huge pages are a request, not a promise: step through them in normal pages, in case some are normal.
+void prefaultPages(const PageBlock &block, unsigned threads)
+{
+    if (block.kind == PageKind::None || block.kind == PageKind::Heap)
+        return; // the heap block was zero-filled already
+
+    const std::size_t step = block.kind == PageKind::ExplicitHuge ? hugePageSize : pageSize();
+    const std::size_t pages = (block.mappingBytes + step - 1) / step;
+    char *base = static_cast<char *>(block.mapping);
+
+    auto touch = [=](std::size_t fromPage, std::size_t toPage) {
+        for (std::size_t p = fromPage; p < toPage; ++p)
+            static_cast<volatile char *>(base)[p * step] = 0;
+    };
+
+    threads = std::max(1u, std::min<unsigned>(threads, static_cast<unsigned>(pages)));
+    if (threads == 1)
+    {
+        touch(0, pages);
+        return;
+    }
+
+    // thread i touches the i-th contiguous part: the same partition the workers should use later
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (unsigned i = 0; i < threads; ++i)
+        workers.emplace_back(touch, pages * i / threads, pages * (i + 1) / threads);
+    for (auto &w : workers)
+        w.join();
+}
+
+} // namespace detail
+
+} // namespace mk
@@ -0,0 +1,203 @@
+/* aligned_buffer.h */
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+/*
+AlignedBuffer: large arrays of numbers, on large pages.
+
+new double[size] gets its memory from malloc, in 4 KB pages. The CPU translates every address through the page tables,
+and caches the recent translations in the TLB, which has room for a few thousand pages: a few MB. A loop over a
+multi-GB array leaves the TLB far behind, and random accesses into it pay a page-table walk almost every time. On top
+of that, every 4 KB page costs a page fault the first time it is touched.
+
+A huge page is 2 MB (on x86-64 and most ARM64 Linux systems): 512 times fewer translations, and 512 times fewer faults.
+AlignedBuffer<T> maps its memory directly with mmap, and asks for huge pages in one of two ways:
+
+    PagePolicy::TransparentHuge  madvise(MADV_HUGEPAGE): the kernel backs the range with huge pages when it can (no
+                                 setup needed, when /sys/kernel/mm/transparent_hugepage/enabled is not "never")
+    PagePolicy::ExplicitHuge     mmap(MAP_HUGETLB): pages from the pool the administrator reserved in
+                                 /proc/sys/vm/nr_hugepages. Falls back to TransparentHuge when the pool is empty.
+
+and falls back to normal pages when neither works (or on systems without them, e.g. macOS). pageKind() tells what the
+buffer actually got.
+
+Options:
+    alignment     of the first element, in bytes (a power of two; at least a page anyway when memory is mapped)
+    prefault      touch every page now, so that the page faults happen here and not in the first loop over the data
+    touchThreads  prefault with this many threads, each touching its own contiguous part. Linux places a page on the
+                  NUMA node of the thread that touches it first ("first touch"), so when worker i later processes part
+                  i of the array, with the same partition, its memory is local.
+
+The buffer is zero-filled (fresh mapped pages are), move-only, and returned by value:
+
+    mk::AlignedBuffer<double> data(1 << 27, {.pages = mk::PagePolicy::TransparentHuge, .prefault = true});
+    std::span<double> s = data;
+
+It holds trivial types only (numbers, and structs of numbers): their constructors and destructors need not run.
+*/
+namespace mk
+{
+
+enum class PagePolicy
+{
+    Normal,
+    TransparentHuge,
+    ExplicitHuge
+};
+
+enum class PageKind
+{
+    None,            // an empty buffer
+    Heap,            // aligned operator new (no mmap on this system)
+    Normal,          // mapped, normal pages
+    TransparentHuge, // mapped, huge pages advised
+    ExplicitHuge     // mapped from the reserved huge page pool
+};
+
+const char *toString(PageKind kind);
+
+struct AlignedBufferOptions
+{
+    std::size_t alignment = 64;
+    PagePolicy pages = PagePolicy::TransparentHuge;
+    bool prefault = false;
+    unsigned touchThreads = 1;
+};
+
+namespace detail
+{
+
+// The memory behind an AlignedBuffer; not typed, so that the mapping code lives in aligned_buffer.cpp.
+struct PageBlock
+{
+    void *data = nullptr;    // the aligned start
+    std::size_t bytes = 0;   // requested
+    void *mapping = nullptr; // what to unmap (or delete)
+    std::size_t mappingBytes = 0;
+    std::size_t alignment = 0; // of a heap block, for its delete
+    PageKind kind = PageKind::None;
+};
+
+// Throws std::bad_alloc if no memory at all can be had.
+PageBlock allocatePages(std::size_t bytes, const AlignedBufferOptions &options);
+void freePages(PageBlock &block) noexcept;
+void prefaultPages(const PageBlock &block, unsigned threads);
+
+} // namespace detail
+
+template <typename T> class AlignedBuffer
+{
+    static_assert(std::is_trivially_default_constructible_v<T> && std::is_trivially_destructible_v<T>,
+                  "AlignedBuffer holds trivial types");
+
+    detail::PageBlock block;
+    std::size_t count = 0;
+
+  public:
+    using value_type = T;
+
+    AlignedBuffer() = default;
+
+    explicit AlignedBuffer(std::size_t n, const AlignedBufferOptions &options = {})
+        : block{detail::allocatePages(n * sizeof(T), options)}, count{n}
+    {
+        assert(options.alignment >= alignof(T));
+        if (options.prefault)
+            detail::prefaultPages(block, options.touchThreads);
+    }
+
+    AlignedBuffer(const AlignedBuffer &) = delete;
+    AlignedBuffer &operator=(const AlignedBuffer &) = delete;
+
+    AlignedBuffer(AlignedBuffer &&other) noexcept
+        : block{std::exchange(other.block, {})}, count{std::exchange(other.count, 0)}
+    {
+    }
+
+    AlignedBuffer &operator=(AlignedBuffer &&other) noexcept
+    {
+        if (this != &other)
+        {
+            detail::freePages(block);
+            block = std::exchange(other.block, {});
+            count = std::exchange(other.count, 0);
+        }
+        return *this;
+    }
+
+    ~AlignedBuffer()
+    {
+        detail::freePages(block);
+    }
+
+    std::size_t size() const
+    {
+        return count;
+    }
+    bool empty() const
+    {
+        return count == 0;
+    }
+    std::size_t bytes() const
+    {
+        return block.bytes;
+    }
+
+    // what the memory is made of (the policy is a request, this is the outcome)
+    PageKind pageKind() const
+    {
+        return block.kind;
+    }
+
+    T *data()
+    {
+        return static_cast<T *>(block.data);
+    }
+    const T *data() const
+    {
+        return static_cast<const T *>(block.data);
+    }
+
+    T &operator[](std::size_t i)
+    {
+        assert(i < count);
+        return data()[i];
+    }
+    const T &operator[](std::size_t i) const
+    {
+        assert(i < count);
+        return data()[i];
+    }
+
+    T *begin()
+    {
+        return data();
+    }
+    T *end()
+    {
+        return data() + count;
+    }
+    const T *begin() const
+    {
+        return data();
+    }
+    const T *end() const
+    {
+        return data() + count;
+    }
+
+    operator std::span<T>()
+    {
+        return {data(), count};
+    }
+    operator std::span<const T>() const
+    {
+        return {data(), count};
+    }
+};
+
+} // namespace mk
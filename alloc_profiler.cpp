@@ -0,0 +1,496 @@
+/*
+Allocation profiler - see alloc_profiler.h
+
+Replacing operator new
+The global allocation and deallocation functions are "replaceable": if a program defines its own
+    void* operator new(std::size_t);
+    void operator delete(void*) noexcept;
+(and the other forms), the linker uses them instead of the library's, for every new expression, every std::allocator
+and every std::make_unique in the whole program.
+
+To know how many bytes a delete frees, every block gets a small header that remembers its size.
+
+Cost
+Each thread counts into its own counters (thread_local): an allocation is two additions and a compare, a free two
+additions, without any lock or atomic read-modify-write instruction. allocTotals() adds up the counters of all threads.
+
+A scope does not count anything itself: it takes a copy of its thread's counters when it begins, and the difference
+when it ends - which includes its nested scopes, as it should. Only the peak needs help: the thread keeps the peak of
+its innermost scope next to its own, and a scope puts the one of the scope around it back when it ends.
+
+Peak live bytes are per thread: the total reports the highest of them. A peak of the whole process would need one
+counter that every allocation of every thread updates.
+*/
+
+#include "alloc_profiler.h"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+
+#ifdef MK_ALLOC_PROFILER
+#include <atomic>
+#include <bit>
+#include <mutex>
+#include <new>
+
+namespace
+{
+
+using mk::AllocStats;
+
+// 16 bytes: the blocks we hand out keep the alignment of std::max_align_t.
+constexpr std::size_t HeaderSize = 16;
+constexpr std::size_t UncountedBit = std::size_t{1} << 63;
+
+int sizeClassOf(std::size_t size)
+{
+    if (size <= 8)
+        return 0;
+    int sizeClass = std::bit_width(size - 1) - 3;
+    return std::min(sizeClass, AllocStats::SizeClasses - 1);
+}
+
+// Only its own thread writes these counters, so a relaxed load + store (a plain add) is enough. They are atomics
+// only because allocTotals() reads them from another thread.
+template <typename T> void bump(std::atomic<T> &counter, T n)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+// The number of allocations is the sum of the histogram, and the live bytes are allocated minus freed bytes: the
+// fewer counters an allocation has to touch, the cheaper it is.
+struct ThreadAccount
+{
+    std::atomic<std::uint64_t> histogram[AllocStats::SizeClasses]{};
+    std::atomic<std::uint64_t> bytesAllocated{0};
+    std::atomic<std::uint64_t> frees{0};
+    std::atomic<std::uint64_t> bytesFreed{0};
+    std::atomic<std::int64_t> peakLiveBytes{0};
+
+    ThreadAccount *next = nullptr;
+
+    void addTo(AllocStats &s) const
+    {
+        for (int i = 0; i < AllocStats::SizeClasses; ++i)
+        {
+            std::uint64_t count = histogram[i].load(std::memory_order_relaxed);
+            s.histogram[i] += count;
+            s.allocations += count;
+        }
+        std::uint64_t allocated = bytesAllocated.load(std::memory_order_relaxed);
+        std::uint64_t freed = bytesFreed.load(std::memory_order_relaxed);
+        s.bytesAllocated += allocated;
+        s.frees += frees.load(std::memory_order_relaxed);
+        s.bytesFreed += freed;
+        s.liveBytes += std::int64_t(allocated - freed);
+        s.threadPeakLiveBytes =
+            std::max<std::int64_t>(s.threadPeakLiveBytes, peakLiveBytes.load(std::memory_order_relaxed));
+    }
+};
+
+struct ScopeRecord
+{
+    std::uint64_t calls = 0;
+    AllocStats stats;
+};
+
+// All of these are constant-initialized, so they work for allocations that happen before main() as well.
+constinit std::mutex profilerMutex;
+constinit ThreadAccount *accounts = nullptr; // the registered threads that are still running
+constinit AllocStats retired;                // the counts of the threads that have finished
+
+thread_local constinit ThreadAccount account;
+thread_local constinit mk::AllocScope *currentScope = nullptr;
+// the peak of the live bytes since the innermost scope began (since the thread began, outside scopes): never above the
+// thread's own peak, so that only a new scope peak can be a new thread peak
+thread_local constinit std::int64_t scopePeakLiveBytes = 0;
+thread_local constinit bool registered = false;
+// registered, and not inside the profiler's own code (whose allocations are not counted): one flag for the fast path
+thread_local constinit bool counting = false;
+
+// never destroyed: scopes may end while static objects are being destroyed.
+std::map<std::string, ScopeRecord> &scopeRecords()
+{
+    static auto *records = new std::map<std::string, ScopeRecord>;
+    return *records;
+}
+
+// Retires the thread's account when the thread ends (constructed on the thread's first allocation).
+struct AccountRetirer
+{
+    ~AccountRetirer()
+    {
+        std::lock_guard<std::mutex> lock{profilerMutex};
+        account.addTo(retired);
+        for (ThreadAccount **p = &accounts; *p; p = &(*p)->next)
+            if (*p == &account)
+            {
+                *p = account.next;
+                break;
+            }
+    }
+};
+
+void registerThread()
+{
+    registered = true;
+    {
+        std::lock_guard<std::mutex> lock{profilerMutex};
+        account.next = accounts;
+        accounts = &account;
+    }
+    thread_local AccountRetirer retirer;
+    (void)retirer;
+    counting = true;
+}
+
+// Run f with counting switched off (and restored afterwards): for the profiler's own allocations. The thread is
+// registered first: f may allocate with profilerMutex locked, and registering then would lock it a second time.
+template <typename F> void uncounted(F f)
+{
+    if (!registered)
+        registerThread();
+    bool wasCounting = counting;
+    counting = false;
+    f();
+    counting = wasCounting;
+}
+
+// Should this allocation or free be counted? Registers the thread on its first allocation.
+inline bool shouldCount()
+{
+    if (counting)
+        return true;
+    if (registered)
+        return false; // inside the profiler
+    registerThread();
+    return true;
+}
+
+// Called on every allocation and every free: keep them small, so that they are inlined into operator new/delete.
+inline bool onAllocate(std::size_t size)
+{
+    if (!shouldCount())
+        return false;
+
+    bump(account.histogram[sizeClassOf(size)], std::uint64_t{1});
+    const std::uint64_t allocated = account.bytesAllocated.load(std::memory_order_relaxed) + size;
+    account.bytesAllocated.store(allocated, std::memory_order_relaxed);
+    const std::int64_t live = std::int64_t(allocated - account.bytesFreed.load(std::memory_order_relaxed));
+    if (live > scopePeakLiveBytes)
+    {
+        scopePeakLiveBytes = live;
+        if (live > account.peakLiveBytes.load(std::memory_order_relaxed))
+            account.peakLiveBytes.store(live, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+inline void onFree(std::size_t size)
+{
+    if (!shouldCount())
+        return;
+
+    bump(account.frees, std::uint64_t{1});
+    bump(account.bytesFreed, std::uint64_t{size});
+}
+
+// [raw ... | size | user block ...]: the size sits in the 8 bytes right before the block.
+inline void *allocateBlock(std::size_t size, std::size_t alignment)
+{
+    std::size_t header = std::max(HeaderSize, alignment);
+    std::size_t total = (header + size + alignment - 1) / alignment * alignment; // aligned_alloc wants a multiple
+    void *raw = alignment <= HeaderSize ? std::malloc(header + size) : std::aligned_alloc(alignment, total);
+    if (!raw)
+        return nullptr;
+
+    // the top bit marks the profiler's own blocks, which are not counted when they are freed either.
+    char *block = static_cast<char *>(raw) + header;
+    reinterpret_cast<std::size_t *>(block)[-1] = onAllocate(size) ? size : size | UncountedBit;
+    return block;
+}
+
+inline void freeBlock(void *p, std::size_t alignment)
+{
+    if (!p)
+        return;
+    char *block = static_cast<char *>(p);
+    std::size_t size = reinterpret_cast<std::size_t *>(block)[-1];
+    if (!(size & UncountedBit))
+        onFree(size);
+    std::free(block - std::max(HeaderSize, alignment));
+}
+
+// out of memory: give the new-handler a chance to free some, as the library's operator new does.
+void *allocateAfterFailure(std::size_t size, std::size_t alignment)
+{
+    for (;;)
+    {
+        std::new_handler handler = std::get_new_handler();
+        if (!handler)
+            throw std::bad_alloc();
+        handler();
+        if (void *p = allocateBlock(size, alignment))
+            return p;
+    }
+}
+
+// The fast path first, with the new-handler loop out of line: one call of allocateBlock, inlined into operator new.
+inline void *allocateOrThrow(std::size_t size, std::size_t alignment)
+{
+    if (void *p = allocateBlock(size, alignment))
+        return p;
+    return allocateAfterFailure(size, alignment);
+}
+
+void writeStats(std::ostream &os, const AllocStats &s)
+{
+    os << "\"allocations\": " << s.allocations << ", \"frees\": " << s.frees
+       << ", \"bytes_allocated\": " << s.bytesAllocated << ", \"bytes_freed\": " << s.bytesFreed
+       << ", \"live_bytes\": " << s.liveBytes << ", \"thread_peak_live_bytes\": " << s.threadPeakLiveBytes
+       << ", \"histogram\": [";
+    bool first = true;
+    for (int i = 0; i < AllocStats::SizeClasses; ++i)
+    {
+        if (!s.histogram[i])
+            continue;
+        os << (first ? "" : ", ") << "{\"max_size\": ";
+        if (i == AllocStats::SizeClasses - 1)
+            os << "null";
+        else
+            os << AllocStats::sizeClassLimit(i);
+        os << ", \"count\": " << s.histogram[i] << "}";
+        first = false;
+    }
+    os << "]";
+}
+
+void writeJsonString(std::ostream &os, const std::string &s)
+{
+    os << '"';
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+            os << '\\';
+        os << c;
+    }
+    os << '"';
+}
+
+void writeReport(std::ostream &os, const AllocStats &total, const std::map<std::string, ScopeRecord> &records)
+{
+    os << "{\n  \"enabled\": true,\n  \"total\": {";
+    writeStats(os, total);
+    os << "},\n  \"scopes\": [";
+    bool first = true;
+    for (const auto &[name, record] : records)
+    {
+        os << (first ? "\n" : ",\n") << "    {\"name\": ";
+        writeJsonString(os, name);
+        os << ", \"calls\": " << record.calls << ", ";
+        writeStats(os, record.stats);
+        os << "}";
+        first = false;
+    }
+    os << "\n  ]\n}\n";
+}
+
+
+} // namespace
+
+void *operator new(std::size_t size)
+{
+    return allocateOrThrow(size, HeaderSize);
+}
+
+void *operator new[](std::size_t size)
+{
+    return allocateOrThrow(size, HeaderSize);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+    return allocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return allocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    return allocateBlock(size, HeaderSize);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    return allocateBlock(size, HeaderSize);
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    return allocateBlock(size, static_cast<std::size_t>(alignment));
+}
+
+void *operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept
+{
+    return allocateBlock(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void *p) noexcept
+{
+    freeBlock(p, HeaderSize);
+}
+
+void operator delete[](void *p) noexcept
+{
+    freeBlock(p, HeaderSize);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    freeBlock(p, HeaderSize);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+    freeBlock(p, HeaderSize);
+}
+
+void operator delete(void *p, std::align_val_t alignment) noexcept
+{
+    freeBlock(p, static_cast<std::size_t>(alignment));
+}
+
+void operator delete[](void *p, std::align_val_t alignment) noexcept
+{
+    freeBlock(p, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void *p, std::size_t, std::align_val_t alignment) noexcept
+{
+    freeBlock(p, static_cast<std::size_t>(alignment));
+}
+
+void operator delete[](void *p, std::size_t, std::align_val_t alignment) noexcept
+{
+    freeBlock(p, static_cast<std::size_t>(alignment));
+}
+
+namespace mk
+{
+
+bool allocProfilerEnabled()
+{
+    return true;
+}
+
+AllocStats allocTotals()
+{
+    std::lock_guard<std::mutex> lock{profilerMutex};
+    AllocStats total = retired;
+    for (ThreadAccount *a = accounts; a; a = a->next)
+        a->addTo(total);
+    return total;
+}
+
+AllocScope::AllocScope(const char *name) : name(name), parent(currentScope)
+{
+    currentScope = this;
+    account.addTo(stats);
+    enclosingPeak = scopePeakLiveBytes;
+    scopePeakLiveBytes = stats.liveBytes;
+}
+
+// The counts of the scope are the thread's counts now, less those when it began; its peak is the highest the live bytes
+// went above where they were then. The enclosing scope's peak is that peak too, if it is higher.
+AllocScope::~AllocScope()
+{
+    currentScope = parent;
+    AllocStats now;
+    account.addTo(now);
+    stats.allocations = now.allocations - stats.allocations;
+    stats.frees = now.frees - stats.frees;
+    stats.bytesAllocated = now.bytesAllocated - stats.bytesAllocated;
+    stats.bytesFreed = now.bytesFreed - stats.bytesFreed;
+    for (int i = 0; i < AllocStats::SizeClasses; ++i)
+        stats.histogram[i] = now.histogram[i] - stats.histogram[i];
+    stats.threadPeakLiveBytes = scopePeakLiveBytes - stats.liveBytes;
+    stats.liveBytes = now.liveBytes - stats.liveBytes;
+    scopePeakLiveBytes = std::max(enclosingPeak, scopePeakLiveBytes);
+
+    uncounted([this] {
+        std::lock_guard<std::mutex> lock{profilerMutex};
+        ScopeRecord &r = scopeRecords()[name];
+        ++r.calls;
+        r.stats.allocations += stats.allocations;
+        r.stats.frees += stats.frees;
+        r.stats.bytesAllocated += stats.bytesAllocated;
+        r.stats.bytesFreed += stats.bytesFreed;
+        r.stats.liveBytes += stats.liveBytes;
+        r.stats.threadPeakLiveBytes = std::max(r.stats.threadPeakLiveBytes, stats.threadPeakLiveBytes);
+        for (int i = 0; i < AllocStats::SizeClasses; ++i)
+            r.stats.histogram[i] += stats.histogram[i];
+    });
+}
+
+void writeAllocReport(std::ostream &os)
+{
+    AllocStats total = allocTotals();
+
+    uncounted([&] {
+        std::map<std::string, ScopeRecord> records;
+        {
+            std::lock_guard<std::mutex> lock{profilerMutex};
+            records = scopeRecords();
+        }
+        writeReport(os, total, records);
+    });
+}
+
+} // namespace mk
+
+#else // MK_ALLOC_PROFILER
+
+namespace mk
+{
+
+bool allocProfilerEnabled()
+{
+    return false;
+}
+
+AllocStats allocTotals()
+{
+    return {};
+}
+
+AllocScope::AllocScope(const char *name) : name(name), parent(nullptr)
+{
+}
+
+AllocScope::~AllocScope()
+{
+}
+
+void writeAllocReport(std::ostream &os)
+{
+    os << "{\n  \"enabled\": false\n}\n";
+}
+
+} // namespace mk
+
+#endif // MK_ALLOC_PROFILER
+
+bool mk::writeAllocReport(const std::string &path)
+{
+    std::ofstream ofs{path};
+    if (!ofs)
+        return false;
+    writeAllocReport(ofs);
+    return bool(ofs);
+}
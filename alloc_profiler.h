@@ -0,0 +1,93 @@
+/* alloc_profiler.h */
+#pragma once
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+/*
+Allocation profiler
+
+How many heap allocations does vectorBasics() make? How many bytes does words_of_sentence() keep alive at its peak?
+Compiled with -DMK_ALLOC_PROFILER, alloc_profiler.cpp replaces the global operator new and operator delete, and counts
+every allocation and every free:
+
+    * the number of allocations and frees, and their bytes
+    * a histogram of the allocation sizes (size classes: up to 8 bytes, up to 16, up to 32, ...)
+    * the live bytes (allocated, not yet freed), and their peak in a thread
+
+The counts are attributed to the innermost running scope of the thread. A scope is opened by
+
+    void vectorBasics()
+    {
+        MK_PROFILE_FUNCTION(); // or MK_PROFILE_SCOPE("a name")
+        ...
+
+and ends with the enclosing block. A scope includes the scopes nested in it. Finished scopes are merged by name, so a
+function that runs several times shows up once, with its number of calls. writeAllocReport() writes it all as JSON.
+
+Without -DMK_ALLOC_PROFILER the macros expand to nothing and the global operators are the library's: no overhead at
+all. The flag replaces operators for the whole program, so every translation unit has to be compiled with it.
+*/
+namespace mk
+{
+
+struct AllocStats
+{
+    // size class k holds the sizes in (2^(k+2), 2^(k+3)], class 0 holds 0..8 bytes, the last class everything above.
+    static constexpr int SizeClasses = 24;
+
+    std::uint64_t allocations = 0;
+    std::uint64_t frees = 0;
+    std::uint64_t bytesAllocated = 0;
+    std::uint64_t bytesFreed = 0;
+    std::int64_t liveBytes = 0;
+    // The highest liveBytes of one thread: of a scope, in the thread it ran in (the highest of its calls); of
+    // allocTotals(), the highest peak of any thread. Not the peak of the whole process: that would take a counter
+    // shared by all threads, updated by every allocation.
+    std::int64_t threadPeakLiveBytes = 0;
+    std::uint64_t histogram[SizeClasses]{};
+
+    // the upper bound of a size class, in bytes
+    static std::uint64_t sizeClassLimit(int sizeClass)
+    {
+        return std::uint64_t{8} << sizeClass;
+    }
+};
+
+// true if the program was compiled with -DMK_ALLOC_PROFILER
+bool allocProfilerEnabled();
+
+// everything counted so far, in all threads and scopes (empty if the profiler is not compiled in)
+AllocStats allocTotals();
+
+// The report, as JSON: {"enabled": ..., "total": {...}, "scopes": [{"name": ..., "calls": ..., ...}, ...]}
+void writeAllocReport(std::ostream &os);
+bool writeAllocReport(const std::string &path);
+
+// Use through MK_PROFILE_SCOPE / MK_PROFILE_FUNCTION. name must outlive the scope (a literal, or __func__).
+class AllocScope
+{
+    const char *name;
+    AllocScope *parent;
+    AllocStats stats;               // the thread's counts when the scope began; its own when it ends
+    std::int64_t enclosingPeak = 0; // the peak of the enclosing scope, until this one ends
+
+  public:
+    explicit AllocScope(const char *name);
+    ~AllocScope();
+
+    AllocScope(const AllocScope &) = delete;
+    AllocScope &operator=(const AllocScope &) = delete;
+};
+
+} // namespace mk
+
+#ifdef MK_ALLOC_PROFILER
+#define MK_PROFILE_CONCAT_(a, b) a##b
+#define MK_PROFILE_CONCAT(a, b) MK_PROFILE_CONCAT_(a, b)
+#define MK_PROFILE_SCOPE(name) mk::AllocScope MK_PROFILE_CONCAT(mkAllocScope_, __LINE__)(name)
+#else
+#define MK_PROFILE_SCOPE(name) ((void)0)
+#endif
+
+#define MK_PROFILE_FUNCTION() MK_PROFILE_SCOPE(__func__)
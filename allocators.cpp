@@ -0,0 +1,428 @@
+/*
+Allocators
+
+Every "new" (and every make_unique, and every std::string that outgrows its small buffer) is a call into the global
+allocator: it has to find a free block of the right size, maybe take a lock, maybe ask the operating system for more
+memory - and every delete has to put the block back. For a few objects we never notice. For hundreds of thousands of
+small objects that are created together and die together, that bookkeeping is most of the work, and the objects end
+up scattered across the heap.
+
+The polymorphic memory resources of C++17 let us choose where a container (and the elements inside it) get their
+memory from, at run time, without changing the container's type:
+
+    std::pmr::vector<int> v{&resource}; // allocates from resource instead of operator new
+
+See arena.h for the two arenas we use, and PmrEntity in domain.h for an allocator-aware domain type.
+*/
+
+#include "aligned_buffer.h"
+#include "alloc_profiler.h"
+#include "arena.h"
+#include "domain.h"
+#include "functions.h"
+#include "mk_benchmark.h"
+#include "object_pool.h"
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if __has_include(<sys/resource.h>)
+#include <sys/resource.h>
+#define MK_HAVE_RUSAGE 1
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using std::cout;
+using std::endl;
+using std::string;
+
+// How often the global heap was hit so far: build with -DMK_ALLOC_PROFILER to count (see alloc_profiler.h).
+static std::size_t allocationsSoFar()
+{
+    return mk::allocTotals().allocations;
+}
+
+void arenaBasics()
+{
+    printTitle("Arena Basics");
+
+    // A monotonic arena with 4 KiB of initial capacity. When it runs out, it asks its upstream resource (the global
+    // heap, by default) for a bigger chunk.
+    mk::MonotonicArena arena{4096};
+
+    // The vector gets its buffer from the arena, and - because PmrEntity is allocator-aware - every element gets the
+    // arena's allocator, so the names are allocated there as well.
+    std::pmr::vector<mk::PmrEntity> batch{arena.allocator()};
+    batch.emplace_back("An entity with a name too long for SSO", 1);
+    batch.emplace_back("E2", 2);
+
+    for (const auto &e : batch)
+        cout << e << " allocated from the arena: " << (e.get_allocator().resource() == arena.resource()) << endl;
+
+    // single objects, created in the arena
+    mk::PmrEntity *pe = arena.create<mk::PmrEntity>("Created in the arena", 3);
+    cout << *pe << endl;
+
+    // The pool arena reuses the block of a destroyed object for the next object of the same size.
+    mk::PoolArena pool;
+    mk::PmrEntity *first = pool.create<mk::PmrEntity>("first", 1);
+    pool.destroy(first);
+    mk::PmrEntity *second = pool.create<mk::PmrEntity>("second", 2);
+    cout << "pool reused the freed block: " << (first == second) << endl;
+    pool.destroy(second);
+}
+
+// Names long enough to defeat the small string optimization, so that every name is a real allocation.
+static std::vector<string> makeNames(int count)
+{
+    std::vector<string> names;
+    names.reserve(count);
+    for (int i = 0; i < count; ++i)
+        names.push_back("entity-with-a-long-name-" + std::to_string(i));
+    return names;
+}
+
+struct BatchResult
+{
+    double ms;
+    std::size_t allocations;
+};
+
+// build a batch of entities and tear it down again, the way smartPointers() does it.
+static BatchResult batchWithMakeUnique(const std::vector<string> &names)
+{
+    std::size_t before = allocationsSoFar();
+    mk::Stopwatch sw;
+    {
+        std::vector<std::unique_ptr<mk::PmrEntity>> vec;
+        for (int i = 0; i < (int)names.size(); ++i)
+            vec.push_back(std::make_unique<mk::PmrEntity>(names[i], i));
+        mk::doNotOptimize(vec.back()->getSize());
+    } // one delete per entity and one per name
+    return {sw.elapsedMs(), allocationsSoFar() - before};
+}
+
+template <typename Arena> static BatchResult batchInArena(const std::vector<string> &names, Arena &arena)
+{
+    std::size_t before = allocationsSoFar();
+    mk::Stopwatch sw;
+    {
+        // the vector itself lives in the arena, and is never destroyed: release() below is the whole teardown.
+        auto *vec = arena.template create<std::pmr::vector<mk::PmrEntity>>();
+        for (int i = 0; i < (int)names.size(); ++i)
+            vec->emplace_back(names[i], i);
+        mk::doNotOptimize(vec->back().getSize());
+        arena.release();
+    }
+    return {sw.elapsedMs(), allocationsSoFar() - before};
+}
+
+static void printBatchResult(const string &label, const BatchResult &r)
+{
+    mk::printTiming(label, r.ms);
+#ifdef MK_ALLOC_PROFILER
+    cout << "    global allocations: " << r.allocations << endl;
+#endif
+}
+
+void arenaBenchmark()
+{
+    MK_PROFILE_FUNCTION();
+    printTitle("Arena Benchmark");
+
+    const int N = 200'000;
+    const int RUNS = 5;
+    std::vector<string> names = makeNames(N);
+
+#ifndef MK_ALLOC_PROFILER
+    cout << "(build with -DMK_ALLOC_PROFILER to count global allocations)\n";
+#endif
+    cout << N << " entities, build + teardown, best of " << RUNS << " runs\n";
+
+    BatchResult best{1e300, 0};
+    for (int run = 0; run < RUNS; ++run)
+    {
+        BatchResult r = batchWithMakeUnique(names);
+        if (r.ms < best.ms)
+            best = r;
+    }
+    printBatchResult("make_unique + vector<unique_ptr>", best);
+
+    best = {1e300, 0};
+    for (int run = 0; run < RUNS; ++run)
+    {
+        mk::MonotonicArena arena;
+        BatchResult r = batchInArena(names, arena);
+        if (r.ms < best.ms)
+            best = r;
+    }
+    printBatchResult("monotonic arena", best);
+
+    best = {1e300, 0};
+    for (int run = 0; run < RUNS; ++run)
+    {
+        mk::PoolArena arena;
+        BatchResult r = batchInArena(names, arena);
+        if (r.ms < best.ms)
+            best = r;
+    }
+    printBatchResult("pool arena", best);
+}
+
+/*
+dynamicMemory() and smartPointers() allocate entities one by one; a pool keeps them together, and replaces the raw
+pointer by a handle that knows when the object behind it is gone (see object_pool.h).
+*/
+void objectPoolBasics()
+{
+    printTitle("Object Pool Basics");
+
+    mk::ObjectPool<mk::Entity> pool;
+    pool.reserve(4); // warm-up: the only allocation the pool makes
+
+    mk::PoolHandle h1 = pool.create("E1", 1);
+    mk::PoolHandle h2 = pool.create("E2", 2);
+    cout << "h1: " << pool.get(h1) << ", h2: " << pool.get(h2) << endl;
+
+    pool.destroy(h1);
+
+    // h1 is stale now: in pointer terms, it dangles. The pool knows.
+    cout << "h1 alive after destroy: " << pool.isAlive(h1) << endl;
+    if (!pool.tryGet(h1))
+        cout << "tryGet(h1): nullptr" << endl;
+    // pool.get(h1); // assertion failure in a debug build
+
+    // The slot of E1 is reused, with a new generation, so the old handle still does not match.
+    mk::PoolHandle h3 = pool.create("E3", 3);
+    cout << "h3 reuses slot " << h3.index() << " of h1 (slot " << h1.index() << "), h1 alive: " << pool.isAlive(h1)
+         << endl;
+
+    std::size_t before = allocationsSoFar();
+    for (int i = 0; i < 1000; ++i)
+        pool.destroy(pool.create("E4", 4)); // Entity prints on construction and destruction, too.
+#ifdef MK_ALLOC_PROFILER
+    cout << "global allocations during 1000 create/destroy: " << allocationsSoFar() - before << endl;
+#else
+    (void)before;
+#endif
+
+    cout << "live entities:";
+    pool.forEach([](const mk::Entity &e) { cout << " " << e.getName(); });
+    cout << endl;
+}
+
+// A small allocation and its delete, in a loop: the case where the profiler's bookkeeping weighs the most.
+static double nsPerSmallAllocation(int count)
+{
+    mk::Stopwatch sw;
+    for (int i = 0; i < count; ++i)
+    {
+        int *p = new int{i};
+        mk::doNotOptimize(p);
+        delete p;
+    }
+    return sw.elapsedNs() / count;
+}
+
+void allocProfilerBasics()
+{
+    MK_PROFILE_FUNCTION();
+    printTitle("Allocation Profiler Basics");
+
+    cout << "profiler compiled in: " << mk::allocProfilerEnabled() << endl;
+
+    {
+        MK_PROFILE_SCOPE("strings");
+        std::vector<string> names = makeNames(1000); // 1001 allocations: the vector's buffer and 1000 names
+        mk::doNotOptimize(names.back());
+    }
+
+    const int N = 10'000'000;
+    cout << "new int + delete: " << nsPerSmallAllocation(N) << " ns (compare builds with and without the profiler)\n";
+
+    mk::AllocStats total = mk::allocTotals();
+    cout << "allocations so far: " << total.allocations
+         << ", peak live bytes of a thread: " << total.threadPeakLiveBytes << endl;
+}
+
+
+// page faults of this process so far (minor: served from memory, no disk involved)
+static long long minorPageFaults()
+{
+#ifdef MK_HAVE_RUSAGE
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt;
+#else
+    return -1;
+#endif
+}
+
+// Counts the data TLB misses of this thread (user space only) with a Linux perf event. Where perf events are not
+// available (other systems, containers, perf_event_paranoid > 2) value() is -1.
+class TlbMissCounter
+{
+    int fd = -1;
+
+  public:
+    TlbMissCounter()
+    {
+#ifdef __linux__
+        perf_event_attr attr{};
+        attr.size = sizeof attr;
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+    }
+
+    TlbMissCounter(const TlbMissCounter &) = delete;
+    TlbMissCounter &operator=(const TlbMissCounter &) = delete;
+
+    ~TlbMissCounter()
+    {
+#ifdef __linux__
+        if (fd >= 0)
+            close(fd);
+#endif
+    }
+
+    void start()
+    {
+#ifdef __linux__
+        if (fd >= 0)
+        {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    long long value()
+    {
+#ifdef __linux__
+        long long count = 0;
+        if (fd >= 0 && ioctl(fd, PERF_EVENT_IOC_DISABLE, 0) == 0 && read(fd, &count, sizeof count) == sizeof count)
+            return count;
+#endif
+        return -1;
+    }
+};
+
+// How much of the mapping at address the kernel backs with transparent huge pages (Linux: /proc/self/smaps), in KB.
+static long long hugePageKb(const void *address)
+{
+    std::ifstream smaps{"/proc/self/smaps"};
+    std::string line;
+    bool inMapping = false;
+    auto a = reinterpret_cast<std::uintptr_t>(address);
+    while (std::getline(smaps, line))
+    {
+        std::uintptr_t from, to;
+        char dash;
+        std::istringstream header{line};
+        if (header >> std::hex >> from >> dash >> to && dash == '-')
+            inMapping = from <= a && a < to;
+        else if (inMapping && line.rfind("AnonHugePages:", 0) == 0)
+            return std::stoll(line.substr(14));
+    }
+    return -1;
+}
+
+static void printCount(const string &label, long long n)
+{
+    cout << "    " << label << (n < 0 ? string{"n/a"} : std::to_string(n)) << "\n";
+}
+
+/*
+The same work on 512 MB of doubles, in memory from new double[] and from AlignedBuffers with the three page policies:
+    first touch   write every element once: every page faults in
+    sequential    sum all elements in order: the hardware prefetcher hides most of the translations
+    random        sum 8M elements at random positions: nearly every access needs a new translation
+*/
+static void pageRun(const string &title, double *data, std::size_t n)
+{
+    const std::size_t RANDOM_READS = 8'000'000;
+    TlbMissCounter tlb;
+
+    cout << title << "\n";
+
+    long long faults = minorPageFaults();
+    mk::Stopwatch sw;
+    for (std::size_t i = 0; i < n; ++i)
+        data[i] = static_cast<double>(i & 1023);
+    mk::doNotOptimize(data[n - 1]);
+    mk::printTiming("  first touch", sw.elapsedMs());
+    printCount("page faults: ", minorPageFaults() - faults);
+
+    tlb.start();
+    sw.restart();
+    double sum = 0;
+    for (std::size_t i = 0; i < n; ++i)
+        sum += data[i];
+    mk::doNotOptimize(sum);
+    mk::printTiming("  sequential sum", sw.elapsedMs());
+    printCount("dTLB misses: ", tlb.value());
+
+    std::uint64_t x = 88172645463325252ull; // xorshift64: a cheap random index that the prefetcher cannot guess
+    tlb.start();
+    sw.restart();
+    sum = 0;
+    for (std::size_t k = 0; k < RANDOM_READS; ++k)
+    {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        sum += data[x % n];
+    }
+    mk::doNotOptimize(sum);
+    mk::printTiming("  random reads", sw.elapsedMs());
+    printCount("dTLB misses: ", tlb.value());
+}
+
+void alignedBufferBenchmark()
+{
+    MK_PROFILE_FUNCTION();
+    printTitle("Aligned Buffer Benchmark");
+
+    const std::size_t N = std::size_t{64} << 20; // 64M doubles: 512 MB
+
+    {
+        std::unique_ptr<double[]> raw{new double[N]}; // uninitialized: its pages are not touched yet
+        pageRun("new double[]", raw.get(), N);
+    }
+
+    const std::pair<mk::PagePolicy, const char *> policies[] = {{mk::PagePolicy::Normal, "Normal"},
+                                                                {mk::PagePolicy::TransparentHuge, "TransparentHuge"},
+                                                                {mk::PagePolicy::ExplicitHuge, "ExplicitHuge"}};
+    for (auto [policy, name] : policies)
+    {
+        // the policy is a request: the title shows what the buffer got
+        mk::AlignedBuffer<double> buffer(N, {.pages = policy});
+        pageRun(string{"AlignedBuffer, "} + name + " -> " + mk::toString(buffer.pageKind()), buffer.data(), N);
+        printCount("huge pages (KB): ", hugePageKb(buffer.data()));
+    }
+
+    // Prefaulted: the faults happen in the constructor, the first loop over the data runs at full speed.
+    mk::Stopwatch sw;
+    long long faults = minorPageFaults();
+    mk::AlignedBuffer<double> prefaulted(N, {.pages = mk::PagePolicy::TransparentHuge, .prefault = true});
+    mk::printTiming("prefault in the constructor", sw.elapsedMs());
+    printCount("page faults: ", minorPageFaults() - faults);
+    pageRun("AlignedBuffer, prefaulted", prefaulted.data(), N);
+}
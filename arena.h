@@ -0,0 +1,84 @@
+/* arena.h */
+#pragma once
+#include <cstddef>
+#include <memory_resource>
+#include <utility>
+
+/*
+An arena (also: region, zone) is a block of memory that many small objects are carved out of, and that is given back
+to the system as a whole. Instead of one trip to the global allocator per object, a batch of work allocates from the
+arena, and at the end of the batch everything is freed at once by releasing the arena.
+
+The standard library (C++17, <memory_resource>) already provides the two classic arenas as memory resources:
+
+    * std::pmr::monotonic_buffer_resource
+      Bump-pointer allocation: allocate() just advances a pointer, deallocate() does nothing. Memory only grows, and is
+      returned by release() or by the destructor. Fastest, if objects of the batch die together.
+
+    * std::pmr::unsynchronized_pool_resource
+      Pools of fixed-size blocks, one pool per size class. Freed blocks are reused by later allocations of the same
+      size, so it suits batches where objects come and go. Not thread-safe (synchronized_pool_resource is).
+
+A std::pmr::polymorphic_allocator is a thin handle to a memory_resource; std::pmr containers and allocator-aware
+types (like mk::PmrEntity) take one and allocate everything through it.
+
+    mk::MonotonicArena arena{64 * 1024};
+    std::pmr::vector<mk::PmrEntity> batch{arena.allocator()};
+    batch.emplace_back("E1", 1);
+
+Releasing an arena does not run destructors. That is exactly what makes the teardown O(1) per arena chunk (instead of
+O(objects)), and it is fine for objects whose only resources were taken from that very arena - but nothing else may
+be created in it.
+*/
+namespace mk
+{
+
+template <typename Resource> class BasicArena
+{
+    Resource res;
+
+  public:
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+    // arguments are forwarded to the underlying memory resource.
+    template <typename... Args> explicit BasicArena(Args &&...args) : res(std::forward<Args>(args)...)
+    {
+    }
+
+    // an arena owns its memory: it cannot be copied or moved.
+    BasicArena(const BasicArena &) = delete;
+    BasicArena &operator=(const BasicArena &) = delete;
+
+    allocator_type allocator()
+    {
+        return allocator_type{&res};
+    }
+
+    std::pmr::memory_resource *resource()
+    {
+        return &res;
+    }
+
+    // Construct a T in the arena. If T is allocator-aware, it receives the arena's allocator as well.
+    template <typename T, typename... Args> T *create(Args &&...args)
+    {
+        return allocator().template new_object<T>(std::forward<Args>(args)...);
+    }
+
+    // Destroy a single object, and give its memory back (a no-op for the monotonic arena).
+    template <typename T> void destroy(T *p)
+    {
+        allocator().delete_object(p);
+    }
+
+    // Free everything that was allocated in the arena, without calling any destructor.
+    void release()
+    {
+        res.release();
+    }
+};
+
+using MonotonicArena = BasicArena<std::pmr::monotonic_buffer_resource>;
+using PoolArena = BasicArena<std::pmr::unsynchronized_pool_resource>;
+
+} // namespace mk
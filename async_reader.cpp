@@ -0,0 +1,462 @@
+/* async_reader.cpp */
+#include "async_reader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+#define MK_HAVE_IO_URING 1
+#endif
+
+namespace mk
+{
+
+const char *toString(AsyncBackend backend)
+{
+    switch (backend)
+    {
+    case AsyncBackend::Auto:
+        return "auto";
+    case AsyncBackend::IoUring:
+        return "io_uring";
+    case AsyncBackend::ThreadPool:
+        return "thread pool";
+    }
+    return "?";
+}
+
+namespace detail
+{
+
+// one block being read: bytes [offset, offset + length) of the file into buffer
+struct ReadSlot
+{
+    std::vector<char> buffer;
+    std::uint64_t offset = 0;
+    std::size_t length = 0;
+    std::size_t filled = 0;
+    bool ready = false;
+    int error = 0; // errno of a failed read
+    iovec rest{};  // the io_uring engine's request: it must stay put until the read completes
+};
+
+class AsyncEngine
+{
+  public:
+    virtual ~AsyncEngine() = default;
+    virtual void submit(ReadSlot &slot) = 0;
+    // returns when slot is ready (filled, or failed)
+    virtual void wait(ReadSlot &slot) = 0;
+    // returns when no read is in flight any more: before the buffers go away
+    virtual void drain() = 0;
+};
+
+#ifdef MK_HAVE_IO_URING
+
+/*
+The rings are shared memory: the kernel reads the submission ring's tail and writes its head, we do the opposite, and
+the other way round for the completion ring. The indices are published with release stores and read with acquire loads,
+so that an entry is complete before its index is seen.
+*/
+class IoUringEngine : public AsyncEngine
+{
+    int fileFd;
+    int ringFd = -1;
+    void *sqRing = MAP_FAILED, *cqRing = MAP_FAILED;
+    std::size_t sqRingBytes = 0, cqRingBytes = 0;
+    io_uring_sqe *sqes = static_cast<io_uring_sqe *>(MAP_FAILED);
+    std::size_t sqesBytes = 0;
+    unsigned *sqTail, *sqMask, *sqArray;
+    unsigned *cqHead, *cqTail, *cqMask;
+    io_uring_cqe *cqes;
+    unsigned toSubmit = 0, inFlight = 0;
+
+    template <typename T> static T *at(void *ring, std::uint32_t offset)
+    {
+        return reinterpret_cast<T *>(static_cast<char *>(ring) + offset);
+    }
+
+    void enter(unsigned minComplete)
+    {
+        for (;;)
+        {
+            long n = ::syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete,
+                               minComplete ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0);
+            if (n >= 0)
+            {
+                toSubmit -= static_cast<unsigned>(n);
+                return;
+            }
+            if (errno != EINTR)
+                throw std::system_error(errno, std::generic_category(), "io_uring_enter");
+        }
+    }
+
+    // take all completions off the ring
+    void reap()
+    {
+        unsigned head = *cqHead;
+        const unsigned tail = std::atomic_ref<unsigned>{*cqTail}.load(std::memory_order_acquire);
+        for (; head != tail; ++head)
+        {
+            const io_uring_cqe &cqe = cqes[head & *cqMask];
+            auto &slot = *reinterpret_cast<ReadSlot *>(static_cast<std::uintptr_t>(cqe.user_data));
+            --inFlight;
+            if (cqe.res < 0 && (cqe.res == -EINTR || cqe.res == -EAGAIN))
+                submit(slot);
+            else if (cqe.res < 0)
+                slot.error = -cqe.res, slot.ready = true;
+            else if (cqe.res == 0)
+                slot.error = EIO, slot.ready = true; // the file got shorter under us
+            else if ((slot.filled += static_cast<std::size_t>(cqe.res)) < slot.length)
+                submit(slot); // a short read: ask for the rest
+            else
+                slot.ready = true;
+        }
+        std::atomic_ref<unsigned>{*cqHead}.store(head, std::memory_order_release);
+    }
+
+  public:
+    IoUringEngine(int fileFd, unsigned entries) : fileFd(fileFd)
+    {
+        io_uring_params params{};
+        ringFd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+        if (ringFd < 0)
+            throw std::system_error(errno, std::generic_category(), "io_uring_setup");
+
+        try
+        {
+            sqRingBytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cqRingBytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            if (params.features & IORING_FEAT_SINGLE_MMAP)
+                sqRingBytes = cqRingBytes = std::max(sqRingBytes, cqRingBytes);
+            sqRing = ::mmap(nullptr, sqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd,
+                            IORING_OFF_SQ_RING);
+            if (sqRing == MAP_FAILED)
+                throw std::system_error(errno, std::generic_category(), "mmap of the submission ring");
+            if (params.features & IORING_FEAT_SINGLE_MMAP)
+                cqRing = sqRing;
+            else
+            {
+                cqRing = ::mmap(nullptr, cqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd,
+                                IORING_OFF_CQ_RING);
+                if (cqRing == MAP_FAILED)
+                    throw std::system_error(errno, std::generic_category(), "mmap of the completion ring");
+            }
+            sqesBytes = params.sq_entries * sizeof(io_uring_sqe);
+            void *p = ::mmap(nullptr, sqesBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd,
+                             IORING_OFF_SQES);
+            if (p == MAP_FAILED)
+                throw std::system_error(errno, std::generic_category(), "mmap of the submission entries");
+            sqes = static_cast<io_uring_sqe *>(p);
+        }
+        catch (...)
+        {
+            release();
+            throw;
+        }
+
+        sqTail = at<unsigned>(sqRing, params.sq_off.tail);
+        sqMask = at<unsigned>(sqRing, params.sq_off.ring_mask);
+        sqArray = at<unsigned>(sqRing, params.sq_off.array);
+        cqHead = at<unsigned>(cqRing, params.cq_off.head);
+        cqTail = at<unsigned>(cqRing, params.cq_off.tail);
+        cqMask = at<unsigned>(cqRing, params.cq_off.ring_mask);
+        cqes = at<io_uring_cqe>(cqRing, params.cq_off.cqes);
+    }
+
+    ~IoUringEngine() override
+    {
+        release();
+    }
+
+    void release()
+    {
+        if (sqes != MAP_FAILED)
+            ::munmap(sqes, sqesBytes);
+        if (cqRing != MAP_FAILED && cqRing != sqRing)
+            ::munmap(cqRing, cqRingBytes);
+        if (sqRing != MAP_FAILED)
+            ::munmap(sqRing, sqRingBytes);
+        if (ringFd >= 0)
+            ::close(ringFd);
+        sqes = static_cast<io_uring_sqe *>(MAP_FAILED);
+        sqRing = cqRing = MAP_FAILED;
+        ringFd = -1;
+    }
+
+    // Queue a read of the rest of the slot; io_uring_enter() submits it, together with the others queued. READV, not
+    // READ: READ came with Linux 5.6, and on 5.1 to 5.5 every read of it would fail with EINVAL.
+    void submit(ReadSlot &slot) override
+    {
+        const unsigned tail = *sqTail;
+        const unsigned index = tail & *sqMask;
+        io_uring_sqe &sqe = sqes[index];
+        std::memset(&sqe, 0, sizeof sqe);
+        slot.rest.iov_base = slot.buffer.data() + slot.filled;
+        slot.rest.iov_len = slot.length - slot.filled;
+        sqe.opcode = IORING_OP_READV;
+        sqe.fd = fileFd;
+        sqe.addr = reinterpret_cast<std::uintptr_t>(&slot.rest);
+        sqe.len = 1;
+        sqe.off = slot.offset + slot.filled;
+        sqe.user_data = reinterpret_cast<std::uintptr_t>(&slot);
+        sqArray[index] = index;
+        std::atomic_ref<unsigned>{*sqTail}.store(tail + 1, std::memory_order_release);
+        ++toSubmit;
+        ++inFlight;
+    }
+
+    void wait(ReadSlot &slot) override
+    {
+        while (!slot.ready)
+        {
+            enter(1);
+            reap();
+        }
+    }
+
+    void drain() override
+    {
+        while (inFlight > 0)
+        {
+            enter(1);
+            reap();
+        }
+    }
+};
+
+#endif
+
+class ThreadPoolEngine : public AsyncEngine
+{
+    int fileFd;
+    std::mutex mutex;
+    std::condition_variable work, done;
+    std::deque<ReadSlot *> queue;
+    unsigned active = 0;
+    bool stopping = false;
+    std::vector<std::thread> threads;
+
+    static void readSlot(int fd, ReadSlot &slot)
+    {
+        while (slot.filled < slot.length)
+        {
+            ssize_t n = ::pread(fd, slot.buffer.data() + slot.filled, slot.length - slot.filled,
+                                static_cast<off_t>(slot.offset + slot.filled));
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+            {
+                slot.error = n < 0 ? errno : EIO;
+                return;
+            }
+            slot.filled += static_cast<std::size_t>(n);
+        }
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock{mutex};
+        for (;;)
+        {
+            work.wait(lock, [&] { return stopping || !queue.empty(); });
+            if (stopping)
+                return;
+            ReadSlot &slot = *queue.front();
+            queue.pop_front();
+            ++active;
+            lock.unlock();
+            readSlot(fileFd, slot);
+            lock.lock();
+            --active;
+            slot.ready = true;
+            done.notify_all();
+        }
+    }
+
+  public:
+    ThreadPoolEngine(int fileFd, unsigned threadCount) : fileFd(fileFd)
+    {
+        for (unsigned t = 0; t < std::max(1u, threadCount); ++t)
+            threads.emplace_back([this] { run(); });
+    }
+
+    ~ThreadPoolEngine() override
+    {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            stopping = true;
+        }
+        work.notify_all();
+        for (auto &t : threads)
+            t.join();
+    }
+
+    void submit(ReadSlot &slot) override
+    {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            queue.push_back(&slot);
+        }
+        work.notify_one();
+    }
+
+    void wait(ReadSlot &slot) override
+    {
+        std::unique_lock<std::mutex> lock{mutex};
+        done.wait(lock, [&] { return slot.ready; });
+    }
+
+    void drain() override
+    {
+        std::unique_lock<std::mutex> lock{mutex};
+        queue.clear();
+        done.wait(lock, [&] { return active == 0; });
+    }
+};
+
+} // namespace detail
+
+AsyncFileReader::AsyncFileReader(const std::string &path, const AsyncReaderOptions &options)
+    : path{path}, options{options}
+{
+    this->options.blockSize = std::max<std::size_t>(this->options.blockSize, 4096);
+    this->options.queueDepth = std::max(this->options.queueDepth, 1u);
+
+    fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw std::system_error(errno, std::generic_category(), "cannot open " + path);
+    struct stat st{};
+    if (::fstat(fd, &st) != 0)
+    {
+        int error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), "cannot stat " + path);
+    }
+    fileSize = static_cast<std::uint64_t>(st.st_size);
+    // the kernel may read ahead as far as it likes
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    AsyncBackend &backend = this->options.backend;
+#ifdef MK_HAVE_IO_URING
+    if (backend != AsyncBackend::ThreadPool)
+    {
+        try
+        {
+            engine = std::make_unique<detail::IoUringEngine>(fd, this->options.queueDepth);
+            backend = AsyncBackend::IoUring;
+        }
+        catch (const std::system_error &)
+        {
+            if (backend == AsyncBackend::IoUring)
+            {
+                ::close(fd);
+                throw;
+            }
+        }
+    }
+#else
+    if (backend == AsyncBackend::IoUring)
+    {
+        ::close(fd);
+        throw std::system_error(std::make_error_code(std::errc::function_not_supported), "io_uring");
+    }
+#endif
+    if (!engine)
+    {
+        engine = std::make_unique<detail::ThreadPoolEngine>(fd, this->options.threads);
+        backend = AsyncBackend::ThreadPool;
+    }
+}
+
+AsyncFileReader::~AsyncFileReader()
+{
+    engine.reset();
+    ::close(fd);
+}
+
+void AsyncFileReader::read(const std::function<void(std::string_view)> &onBlock)
+{
+    const std::uint64_t blockSize = options.blockSize;
+    const std::uint64_t blocks = (fileSize + blockSize - 1) / blockSize;
+    std::vector<detail::ReadSlot> slots(static_cast<std::size_t>(std::min<std::uint64_t>(options.queueDepth, blocks)));
+    for (auto &slot : slots)
+        slot.buffer.resize(options.blockSize);
+
+    // The slots must outlive the reads into them, whatever happens below. Waiting for the reads fails only if
+    // io_uring_enter() does, and must not throw while an exception of onBlock is on its way: the slots are then
+    // leaked, so that no read lands in freed memory.
+    struct Drain
+    {
+        detail::AsyncEngine &engine;
+        std::vector<detail::ReadSlot> &slots;
+        ~Drain()
+        {
+            try
+            {
+                engine.drain();
+            }
+            catch (...)
+            {
+                new std::vector<detail::ReadSlot>(std::move(slots));
+            }
+        }
+    } drain{*engine, slots};
+
+    auto start = [&](detail::ReadSlot &slot, std::uint64_t block) {
+        slot.offset = block * blockSize;
+        slot.length = static_cast<std::size_t>(std::min(blockSize, fileSize - slot.offset));
+        slot.filled = 0;
+        slot.ready = false;
+        slot.error = 0;
+        engine->submit(slot);
+    };
+
+    for (std::uint64_t b = 0; b < slots.size(); ++b)
+        start(slots[b], b);
+    for (std::uint64_t b = 0; b < blocks; ++b)
+    {
+        detail::ReadSlot &slot = slots[b % slots.size()];
+        engine->wait(slot);
+        if (slot.error)
+            throw std::system_error(slot.error, std::generic_category(), "cannot read " + path);
+        onBlock(std::string_view{slot.buffer.data(), slot.length});
+        if (b + slots.size() < blocks)
+            start(slot, b + slots.size());
+    }
+}
+
+ReadingFile readReadings(AsyncFileReader &reader, std::size_t maxReportedErrors)
+{
+    ReadingFile result;
+    result.readings.reserve(static_cast<std::size_t>(reader.size() / 6)); // "h t.t\n": lines are rarely shorter
+    forEachLineChunk(reader, [&](std::string_view text) {
+        result.lines += forEachReading(
+            text, result.lines + 1, [&](const Reading &r) { result.readings.push_back(r); },
+            [&](std::size_t line, const char *message, std::string_view lineText) {
+                ++result.malformedLines;
+                if (result.errors.size() < maxReportedErrors)
+                    result.errors.push_back({line, message, std::string{lineText.substr(0, 80)}});
+            });
+    });
+    return result;
+}
+
+} // namespace mk
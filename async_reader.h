@@ -0,0 +1,139 @@
+/* async_reader.h */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "readings.h"
+
+/*
+AsyncFileReader: reads a file front to back with several large reads in flight at once.
+
+A blocking stream issues one read, waits for it, hands over the bytes, and only then issues the next: the device
+works on one request at a time, and sits idle while we parse. An NVMe drive is fastest with many requests queued (it
+has many flash channels working in parallel), so the reader keeps queueDepth reads of blockSize bytes each in flight,
+and hands each block to the callback as soon as it and all blocks before it are there:
+
+    mk::AsyncFileReader reader{"temperatures.txt"}; // throws std::system_error if it cannot be opened
+    reader.read([](std::string_view block) { ... }); // in file order, on this thread; the next reads run meanwhile
+
+Two ways to keep reads in flight:
+    io_uring     Linux 5.1+: a pair of ring buffers shared with the kernel. We put read requests into the submission
+                 ring and take results from the completion ring; one io_uring_enter() call submits and waits for a
+                 whole batch. Used through the raw system calls, without liburing.
+    thread pool  pread() from a few threads, each blocking on its own read. Used where io_uring is not available
+                 (older kernels, or containers that forbid it), or when asked for.
+
+Adapters make it the byte source of the line reader (forEachLine) and of the reading parser (readReadings).
+*/
+namespace mk
+{
+
+enum class AsyncBackend
+{
+    Auto, // io_uring if it can be set up, else the thread pool
+    IoUring,
+    ThreadPool
+};
+
+const char *toString(AsyncBackend backend);
+
+struct AsyncReaderOptions
+{
+    std::size_t blockSize = std::size_t{1} << 20;
+    unsigned queueDepth = 8; // reads in flight
+    AsyncBackend backend = AsyncBackend::Auto;
+    unsigned threads = 4; // for the thread pool
+};
+
+namespace detail
+{
+class AsyncEngine; // io_uring, or the thread pool
+}
+
+class AsyncFileReader
+{
+    std::string path;
+    AsyncReaderOptions options;
+    int fd = -1;
+    std::uint64_t fileSize = 0;
+    std::unique_ptr<detail::AsyncEngine> engine;
+
+  public:
+    // Opens the file. Throws std::system_error if it cannot be opened, or if io_uring was asked for and cannot be set
+    // up.
+    explicit AsyncFileReader(const std::string &path, const AsyncReaderOptions &options = {});
+
+    AsyncFileReader(const AsyncFileReader &) = delete;
+    AsyncFileReader &operator=(const AsyncFileReader &) = delete;
+    ~AsyncFileReader();
+
+    std::uint64_t size() const
+    {
+        return fileSize;
+    }
+
+    // the backend read() uses (never Auto)
+    AsyncBackend backend() const
+    {
+        return options.backend;
+    }
+
+    // Calls onBlock with every block of the file, in order. The bytes are valid until onBlock returns. Throws
+    // std::system_error on read errors. May be called again, to read the file again.
+    void read(const std::function<void(std::string_view)> &onBlock);
+};
+
+// Calls onLines with text that holds whole lines only (a line split across blocks is put together), in file order.
+// The last line of the file may lack its newline.
+template <typename OnLines> void forEachLineChunk(AsyncFileReader &reader, OnLines &&onLines)
+{
+    std::string carry; // the start of a line that continues in the next block
+    reader.read([&](std::string_view block) {
+        std::size_t newline = block.rfind('\n');
+        if (newline == std::string_view::npos)
+        {
+            carry.append(block);
+            return;
+        }
+        std::size_t start = 0;
+        if (!carry.empty())
+        {
+            start = block.find('\n') + 1;
+            carry.append(block.substr(0, start));
+            onLines(std::string_view{carry});
+            carry.clear();
+        }
+        if (start <= newline)
+            onLines(block.substr(start, newline + 1 - start));
+        carry.append(block.substr(newline + 1));
+    });
+    if (!carry.empty())
+        onLines(std::string_view{carry});
+}
+
+// Calls onLine with every line, without its newline.
+template <typename OnLine> void forEachLine(AsyncFileReader &reader, OnLine &&onLine)
+{
+    forEachLineChunk(reader, [&](std::string_view text) {
+        while (!text.empty())
+        {
+            std::size_t newline = text.find('\n');
+            if (newline == std::string_view::npos)
+            {
+                onLine(text);
+                return;
+            }
+            onLine(text.substr(0, newline));
+            text.remove_prefix(newline + 1);
+        }
+    });
+}
+
+// loadReadings() with the reader as the byte source
+ReadingFile readReadings(AsyncFileReader &reader, std::size_t maxReportedErrors = 100);
+
+} // namespace mk
@@ -1,8 +1,16 @@
+#include "alloc_profiler.h"
 #include "domain.h"
+#include "flat_map.h"
 #include "functions.h"
+#include "mk_benchmark.h"
+#include "small_vector.h"
 #include <iomanip> // std::setprecision
 #include <iostream>
 #include <map>
+#include <memory_resource>
+#include <random>
+#include <set>
+#include <string_view>
 
 using std::cout;
 using std::endl;
@@ -13,6 +21,7 @@ using std::vector;
 
 void vectorBasics()
 {
+    MK_PROFILE_FUNCTION();
     printTitle("Vector Basics");
 
     /*
@@ -414,6 +423,8 @@ void mapBasics()
         cout << "ok: " << removal_word << " removed\n";
     else
         cout << "oops: " << removal_word << " not found!\n";
+
+    // the words of a whole corpus, without a string per word: mk::countWords() (word_count.h)
 }
 
 void setBasics()
@@ -426,4 +437,173 @@ void setBasics()
     A set is most useful when we simply want to know whether a value is present.
 
     */
-}
\ No newline at end of file
+
+    // filled once, then only searched: FlatSet (flat_map.h), a sorted vector
+    const mk::FlatSet<string> colours{"red", "green", "blue", "green"};
+    cout << colours.size() << " colours, green: " << colours.contains(std::string_view{"green"}) << endl;
+
+    // a table of flags, read far more often than it is changed
+    mk::FlatMap<string, bool> primary{{"red", true}, {"green", true}, {"blue", true}, {"purple", false}};
+    primary["orange"] = false;
+    for (const auto &[colour, isPrimary] : primary)
+        cout << colour << (isPrimary ? " is" : " is not") << " a primary colour\n";
+}
+
+/*
+Create a vector, push_back size ints, read them, destroy the vector: std::vector against SmallVector<int, 16>, for
+small sizes. Up to 16 ints the SmallVector does not allocate; beyond that it spills to the free store, and from then
+on it behaves like std::vector (which starts with no capacity, and so makes a few more allocations on the way).
+
+The allocations per round are counted by the allocation profiler (build with -DMK_ALLOC_PROFILER; the profiler also
+adds a little time to every allocation, so take the timings from a build without it).
+*/
+template <typename Vec> static void createFillDestroy(std::size_t size, int rounds, const string &label)
+{
+    std::uint64_t allocationsBefore = mk::allocTotals().allocations;
+    mk::Stopwatch sw;
+    for (int r = 0; r < rounds; ++r)
+    {
+        Vec v;
+        for (std::size_t i = 0; i < size; ++i)
+            v.push_back(static_cast<int>(i));
+        int sum = 0;
+        for (int x : v)
+            sum += x;
+        mk::doNotOptimize(sum);
+    }
+    double ns = sw.elapsedNs() / rounds;
+    std::uint64_t allocations = mk::allocTotals().allocations - allocationsBefore;
+
+    std::streamsize precision = cout.precision();
+    cout << std::setw(6) << size << "  " << std::left << std::setw(22) << label << std::right << std::fixed
+         << std::setprecision(1) << std::setw(9) << ns << " ns";
+    if (mk::allocProfilerEnabled())
+        cout << std::setw(8) << static_cast<double>(allocations) / rounds << " allocations";
+    cout << std::defaultfloat << std::setprecision(precision) << endl;
+}
+
+void smallVectorBenchmark()
+{
+    MK_PROFILE_FUNCTION();
+    printTitle("SmallVector Benchmark");
+
+    const int ROUNDS = 1'000'000;
+    cout << "create, fill with size ints, read, destroy; per round, " << ROUNDS << " rounds\n";
+    if (!mk::allocProfilerEnabled())
+        cout << "(build with -DMK_ALLOC_PROFILER to count the allocations)\n";
+
+    for (std::size_t size : {0, 1, 2, 4, 8, 16, 32, 64})
+    {
+        createFillDestroy<vector<int>>(size, ROUNDS, "std::vector<int>");
+        createFillDestroy<mk::SmallVector<int, 16>>(size, ROUNDS, "SmallVector<int, 16>");
+    }
+}
+
+// counts the bytes the containers on it hold, and takes them from the free store
+class CountingResource : public std::pmr::memory_resource
+{
+    std::size_t held = 0;
+
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        held += bytes;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void *p, std::size_t bytes, std::size_t alignment) override
+    {
+        held -= bytes;
+        std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+        return this == &other;
+    }
+
+  public:
+    std::size_t bytes() const
+    {
+        return held;
+    }
+};
+
+// ns per lookup of every key in queries, which are all in the table
+template <typename Table> static double lookupNs(const Table &table, const vector<std::uint64_t> &queries)
+{
+    mk::Stopwatch sw;
+    std::uint64_t sum = 0;
+    for (std::uint64_t q : queries)
+        sum += table.find(q) != table.end();
+    mk::doNotOptimize(sum);
+    return sw.elapsedNs() / static_cast<double>(queries.size());
+}
+
+/*
+A table of n random 64-bit keys and values, built once and read many times, for n from 10^3 to 10^7:
+    std::map            a node per pair (its memory counted through a pmr resource: the node, not malloc's extras)
+    FlatMap             two sorted vectors, std::lower_bound
+    FlatMap branchless  the same vectors, BranchlessLowerBound
+The time per lookup of a random key of the table, and the memory. Then strings: a std::set<string> and a FlatSet of
+them, looked up with string_views.
+*/
+void flatMapBenchmark()
+{
+    MK_PROFILE_FUNCTION();
+    printTitle("FlatMap Benchmark");
+
+    std::mt19937_64 gen{50};
+    const std::size_t QUERIES = 1'000'000;
+    cout << std::setw(10) << "keys" << std::setw(16) << "std::map ns" << std::setw(12) << "KB" << std::setw(16)
+         << "FlatMap ns" << std::setw(16) << "branchless ns" << std::setw(12) << "KB" << endl;
+    for (std::size_t n = 1'000; n <= 10'000'000; n *= 10)
+    {
+        vector<pair<std::uint64_t, std::uint64_t>> pairs(n);
+        for (auto &[key, value] : pairs)
+            key = gen(), value = gen();
+        vector<std::uint64_t> queries(QUERIES);
+        for (auto &q : queries)
+            q = pairs[gen() % n].first;
+
+        CountingResource resource;
+        double mapNs;
+        std::size_t mapBytes;
+        {
+            std::pmr::map<std::uint64_t, std::uint64_t> tree{&resource};
+            for (const auto &[key, value] : pairs)
+                tree.emplace(key, value);
+            mapNs = lookupNs(tree, queries);
+            mapBytes = resource.bytes();
+        }
+        const mk::FlatMap<std::uint64_t, std::uint64_t> flat{pairs};
+        const mk::FlatMap<std::uint64_t, std::uint64_t, std::less<>, mk::BranchlessLowerBound> branchless{pairs};
+        const double flatNs = lookupNs(flat, queries), branchlessNs = lookupNs(branchless, queries);
+
+        cout << std::fixed << std::setprecision(1) << std::setw(10) << n << std::setw(16) << mapNs << std::setw(12)
+             << mapBytes / 1000 << std::setw(16) << flatNs << std::setw(16) << branchlessNs << std::setw(12)
+             << flat.bytes() / 1000 << std::defaultfloat << endl;
+    }
+
+    // words of 4 to 12 letters, looked up by string_view (std::set<string, std::less<>> can do that too)
+    vector<string> words(100'000);
+    for (auto &w : words)
+        for (std::size_t n = 4 + gen() % 9; n > 0; --n)
+            w += static_cast<char>('a' + gen() % 26);
+    vector<std::string_view> lookups(QUERIES);
+    for (auto &l : lookups)
+        l = words[gen() % words.size()];
+    const std::set<string, std::less<>> tree(words.begin(), words.end());
+    const mk::FlatSet<string> flat{words};
+    auto timeStrings = [&](const auto &table, const string &label) {
+        mk::Stopwatch sw;
+        std::size_t found = 0;
+        for (std::string_view l : lookups)
+            found += table.contains(l);
+        mk::doNotOptimize(found);
+        cout << "    " << std::left << std::setw(36) << label << std::right << std::fixed << std::setprecision(1)
+             << sw.elapsedNs() / static_cast<double>(lookups.size()) << " ns" << std::defaultfloat << endl;
+    };
+    cout << words.size() << " strings, looked up by string_view:" << endl;
+    timeStrings(tree, "std::set<string, std::less<>>");
+    timeStrings(flat, "FlatSet<string>");
+}
@@ -0,0 +1,219 @@
+/* ctime_index.cpp */
+#include "ctime_index.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace mk
+{
+
+namespace
+{
+
+constexpr std::size_t CtimeLength = 24; // "Www Mmm dd hh:mm:ss yyyy"
+
+constexpr std::uint32_t nameKey(const char *name)
+{
+    return static_cast<std::uint32_t>(static_cast<unsigned char>(name[0])) |
+           static_cast<std::uint32_t>(static_cast<unsigned char>(name[1])) << 8 |
+           static_cast<std::uint32_t>(static_cast<unsigned char>(name[2])) << 16;
+}
+
+/*
+A perfect hash of three-letter names: the top bits of key * multiplier are different for every name of the set (the
+multipliers were found by trying them in turn). A slot holds the key of its name, so that anything else is rejected by
+one compare.
+*/
+template <std::size_t Names, unsigned Bits> struct NameTable
+{
+    std::uint32_t multiplier;
+    std::array<std::uint32_t, 1u << Bits> keys{};
+    std::array<std::uint8_t, 1u << Bits> values{};
+
+    constexpr NameTable(const char *const (&names)[Names], std::uint32_t multiplier) : multiplier(multiplier)
+    {
+        for (std::size_t i = 0; i < Names; ++i)
+        {
+            const std::uint32_t slot = slotOf(nameKey(names[i]));
+            if (keys[slot] != 0)
+                throw "two names in one slot"; // not a constant expression: a compile error
+            keys[slot] = nameKey(names[i]);
+            values[slot] = static_cast<std::uint8_t>(i);
+        }
+    }
+
+    constexpr std::uint32_t slotOf(std::uint32_t key) const
+    {
+        return (key * multiplier) >> (32 - Bits);
+    }
+
+    // the index of the name, or -1
+    int find(const char *text) const
+    {
+        const std::uint32_t key = nameKey(text);
+        const std::uint32_t slot = slotOf(key);
+        return keys[slot] == key ? values[slot] : -1;
+    }
+};
+
+constexpr const char *DayNames[] = {"Mon", "Tue", "Wed", "Thu", "Fri", "Sat", "Sun"}; // in the order of enum Day
+constexpr const char *MonthNames[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                      "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+constexpr NameTable<7, 3> Days{DayNames, 2522};
+constexpr NameTable<12, 4> Months{MonthNames, 26596};
+
+bool isDigit(char c)
+{
+    return static_cast<unsigned char>(c - '0') < 10;
+}
+
+unsigned twoDigits(const char *p)
+{
+    return static_cast<unsigned>(p[0] - '0') * 10 + static_cast<unsigned>(p[1] - '0');
+}
+
+/*
+"Www Mmm dd hh:mm": blanks at 3, 7 and 10, a colon at 13, digits at 9, 11, 12, 14 and 15, and a digit or a blank at 8
+(the day of the month is padded with a blank). The letters are checked by the name lookup.
+*/
+bool validLayout(const char *p)
+{
+#ifdef __SSE2__
+    const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    const __m128i separatorMask = _mm_setr_epi8(0, 0, 0, -1, 0, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0);
+    const __m128i separators = _mm_setr_epi8(0, 0, 0, ' ', 0, 0, 0, ' ', 0, 0, ' ', 0, 0, ':', 0, 0);
+    const __m128i digitMask = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 0, -1, 0, -1, -1, 0, -1, -1);
+    const __m128i blankMask = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, -1, 0, 0, 0, 0, 0, 0, 0);
+
+    // a digit minus '0' is 0-9: unchanged by an unsigned min with 9
+    const __m128i fromZero = _mm_sub_epi8(bytes, _mm_set1_epi8('0'));
+    const __m128i digits = _mm_cmpeq_epi8(_mm_min_epu8(fromZero, _mm_set1_epi8(9)), fromZero);
+    const __m128i digitsOrBlanks = _mm_or_si128(digits, _mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')));
+    const __m128i all = _mm_set1_epi8(-1);
+
+    // every byte: the right separator where there is one, a digit where there must be one, ...
+    __m128i ok = _mm_cmpeq_epi8(_mm_and_si128(bytes, separatorMask), separators);
+    ok = _mm_and_si128(ok, _mm_or_si128(digits, _mm_andnot_si128(digitMask, all)));
+    ok = _mm_and_si128(ok, _mm_or_si128(digitsOrBlanks, _mm_andnot_si128(blankMask, all)));
+    return _mm_movemask_epi8(ok) == 0xFFFF;
+#else
+    return p[3] == ' ' && p[7] == ' ' && p[10] == ' ' && p[13] == ':' && (isDigit(p[8]) || p[8] == ' ') &&
+           isDigit(p[9]) && isDigit(p[11]) && isDigit(p[12]) && isDigit(p[14]) && isDigit(p[15]);
+#endif
+}
+
+} // namespace
+
+std::optional<CtimeFields> parseCtimeFields(std::string_view text)
+{
+    if (text.size() < CtimeLength)
+        return std::nullopt;
+    const char *p = text.data();
+
+    // the layout up to the minutes, then ":ss", an optional fraction, and " yyyy"
+    if (!validLayout(p) || p[16] != ':' || !isDigit(p[17]) || !isDigit(p[18]))
+        return std::nullopt;
+    std::size_t yearAt = 20;
+    if (p[19] == '.')
+    {
+        while (yearAt < text.size() && isDigit(p[yearAt]))
+            ++yearAt;
+        if (yearAt == 20 || yearAt + 5 > text.size())
+            return std::nullopt;
+        ++yearAt;
+    }
+    const char *y = p + yearAt;
+    if (y[-1] != ' ' || !isDigit(y[0]) || !isDigit(y[1]) || !isDigit(y[2]) || !isDigit(y[3]) ||
+        (yearAt + 4 < text.size() && isDigit(y[4])))
+        return std::nullopt;
+
+    const int dayName = Days.find(p);
+    const int monthName = Months.find(p + 4);
+    if (dayName < 0 || monthName < 0)
+        return std::nullopt;
+
+    CtimeFields f;
+    f.weekday = static_cast<Day>(dayName);
+    f.month = static_cast<Month>(monthName + 1);
+    f.day = static_cast<unsigned>(p[8] & 0x0F) * 10 + static_cast<unsigned>(p[9] - '0'); // ' ' & 0x0F is 0
+    f.hour = twoDigits(p + 11);
+    f.minute = twoDigits(p + 14);
+    f.second = twoDigits(p + 17);
+    f.year = static_cast<int>(twoDigits(y) * 100 + twoDigits(y + 2));
+
+    using namespace std::chrono;
+    const year_month_day date{year{f.year}, month{static_cast<unsigned>(monthName + 1)}, day{f.day}};
+    if (!date.ok() || f.hour > 23 || f.minute > 59 || f.second > 60 ||
+        weekday{sys_days{date}}.iso_encoding() != static_cast<unsigned>(dayName) + 1)
+        return std::nullopt;
+    return f;
+}
+
+std::optional<std::chrono::sys_seconds> parseCtime(std::string_view text)
+{
+    using namespace std::chrono;
+    const std::optional<CtimeFields> f = parseCtimeFields(text);
+    if (!f)
+        return std::nullopt;
+    const sys_days date{year{f->year} / month{static_cast<unsigned>(f->month)} / day{f->day}};
+    return date + hours{f->hour} + minutes{f->minute} + seconds{f->second};
+}
+
+CtimeIndex CtimeIndex::build(std::string_view text)
+{
+    CtimeIndex index;
+    index.textSize = text.size();
+    bool ordered = true;
+    for (std::size_t at = 0; at < text.size();)
+    {
+        const std::size_t newline = text.find('\n', at);
+        const std::size_t end = newline == std::string_view::npos ? text.size() : newline + 1;
+        if (const auto time = parseCtime(text.substr(at, end - at)))
+        {
+            ordered = ordered && (index.lines.empty() || index.lines.back().time <= *time);
+            index.lines.push_back({*time, at});
+        }
+        else
+            ++index.untimed;
+        at = end;
+    }
+
+    if (!ordered)
+    {
+        index.byTime = index.lines;
+        std::stable_sort(index.byTime.begin(), index.byTime.end(),
+                         [](const TimestampedLine &a, const TimestampedLine &b) { return a.time < b.time; });
+    }
+    return index;
+}
+
+std::span<const TimestampedLine> CtimeIndex::between(std::chrono::sys_seconds from, std::chrono::sys_seconds to) const
+{
+    const std::vector<TimestampedLine> &sorted = byTime.empty() ? lines : byTime;
+    auto before = [](const TimestampedLine &l, std::chrono::sys_seconds t) { return l.time < t; };
+    auto first = std::lower_bound(sorted.begin(), sorted.end(), from, before);
+    auto last = std::lower_bound(first, sorted.end(), to, before);
+    if (to <= from)
+        last = first;
+    return {first, last};
+}
+
+std::pair<std::uint64_t, std::uint64_t> CtimeIndex::byteRange(std::chrono::sys_seconds from,
+                                                              std::chrono::sys_seconds to) const
+{
+    if (!inTimeOrder())
+        throw std::logic_error("CtimeIndex::byteRange: the timestamps are not in time order");
+    const std::span<const TimestampedLine> found = between(from, to);
+    if (found.empty())
+        return {0, 0};
+    const std::size_t after = static_cast<std::size_t>(found.data() - lines.data()) + found.size();
+    return {found.front().offset, after < lines.size() ? lines[after].offset : textSize};
+}
+
+} // namespace mk
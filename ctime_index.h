@@ -0,0 +1,107 @@
+/* ctime_index.h */
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "enums.h"
+
+/*
+Timestamps in ctime() format, "Mon Jan 23 12:00:50 2023", as writeFile() and the LogWriter put them at the start of
+their lines: parsing them, and finding the lines of a time range in a log without parsing all of it.
+
+std::get_time and strptime() take a format string, interpret it for every timestamp, compare the names with the
+locale's day and month names one by one, and convert field by field through a stream. The format here is fixed, so
+parseCtime() checks the layout of the first 16 characters at once (SSE2: the separators, and that the digits are
+digits, in a few vector instructions; byte by byte elsewhere), finds the day and month names with a perfect hash of
+their three letters (one multiply, one table lookup, one compare), and reads the numbers as pairs of digits. The
+date becomes days since the epoch with the civil-calendar arithmetic of std::chrono, without a time zone lookup.
+
+    std::optional<mk::CtimeFields> f = mk::parseCtimeFields("Mon Jan 23 12:00:50 2023"); // f->weekday == Monday
+    std::optional<std::chrono::sys_seconds> t = mk::parseCtime(line);                    // nullopt if not a timestamp
+
+The fraction of a second the LogWriter can add ("12:00:50.123456 2023") is accepted and dropped. ctime() writes local
+time without saying which zone; the fields are taken as they are, as if they were UTC - so give the bounds of a query
+the same way (std::chrono::sys_days{2023y / 1 / 23} + 12h).
+
+CtimeIndex: the time and offset of every line that starts with a timestamp (other lines - blank lines, the rest of a
+multi-line message - belong to the timestamp above them). A log is written in time order, so the index is sorted by
+time as it is: a time range is two binary searches, and its lines are one range of bytes in the file.
+
+    mk::MappedFile file{"out.txt"};
+    mk::CtimeIndex index = mk::CtimeIndex::build(file.text());
+    auto [begin, end] = index.byteRange(from, to); // the lines with from <= time < to
+    std::string_view lines = file.text().substr(begin, end - begin);
+
+A log whose clock went back (a time change, clocks corrected by NTP) is not in time order; the index then keeps a
+second, sorted copy, and between() still finds the lines, although not as one range of bytes.
+*/
+namespace mk
+{
+
+struct CtimeFields
+{
+    Day weekday;
+    Month month;
+    unsigned day;    // of the month
+    unsigned hour;   // 0-23
+    unsigned minute; // 0-59
+    unsigned second; // 0-60 (a leap second)
+    int year;
+};
+
+// The timestamp at the start of text. nullopt if it is not one: a wrong layout, an unknown day or month name, a date
+// that does not exist, or a weekday that does not go with the date.
+std::optional<CtimeFields> parseCtimeFields(std::string_view text);
+
+// the same, as seconds since the epoch
+std::optional<std::chrono::sys_seconds> parseCtime(std::string_view text);
+
+struct TimestampedLine
+{
+    std::chrono::sys_seconds time;
+    std::uint64_t offset; // of the line
+};
+
+class CtimeIndex
+{
+    std::vector<TimestampedLine> lines;  // in file order
+    std::vector<TimestampedLine> byTime; // sorted by time; only when lines is not
+    std::uint64_t textSize = 0;
+    std::size_t untimed = 0;
+
+  public:
+    static CtimeIndex build(std::string_view text);
+
+    // the lines that start with a timestamp
+    std::size_t size() const
+    {
+        return lines.size();
+    }
+
+    // the lines that do not (and belong to the timestamp above them)
+    std::size_t untimedLines() const
+    {
+        return untimed;
+    }
+
+    // are the timestamps in the file in time order?
+    bool inTimeOrder() const
+    {
+        return byTime.empty();
+    }
+
+    // The timestamped lines with from <= time < to, by time; lines with the same time in file order.
+    std::span<const TimestampedLine> between(std::chrono::sys_seconds from, std::chrono::sys_seconds to) const;
+
+    // The bytes [first, second) of the lines with from <= time < to, and of the untimed lines that follow them.
+    // Throws std::logic_error unless inTimeOrder().
+    std::pair<std::uint64_t, std::uint64_t> byteRange(std::chrono::sys_seconds from, std::chrono::sys_seconds to) const;
+};
+
+} // namespace mk
@@ -1,8 +1,15 @@
 #include "functions.h"
+#include "mk_benchmark.h"
 #include "mk_datastructures.h"
+#include "quantiles.h"
+#include <algorithm>
+#include <cmath>
 #include <forward_list>
 #include <iostream>
+#include <random>
 #include <stack>
+#include <thread>
+#include <vector>
 
 using std::cout;
 
@@ -106,4 +113,102 @@ void stackBasics()
         // container object.
         scores.pop();
     }
-}
\ No newline at end of file
+}
+
+// the fraction of values below x: where x really is, as a quantile
+static double rankOf(const std::vector<double> &sorted, double x)
+{
+    return static_cast<double>(std::lower_bound(sorted.begin(), sorted.end(), x) - sorted.begin()) /
+           static_cast<double>(sorted.size());
+}
+
+/*
+Median, p95 and p99 of a stream of temperatures, asked for every 10000 values:
+    sort                    copy and sort everything seen so far, for every query
+    RunningQuantile         three pairs of heaps (exact)
+    TDigest                 one digest (approximate, bounded memory), and 4 digests filled by 4 threads, then merged
+*/
+void runningQuantileBenchmark()
+{
+    printTitle("Running Quantile Benchmark");
+
+    const std::size_t N = 1'000'000, every = 10'000;
+    std::mt19937 gen{2024};
+    std::normal_distribution<double> temperature{15.0, 8.0};
+    std::vector<double> temps(N);
+    for (auto &t : temps)
+        t = std::round(temperature(gen) * 10) / 10;
+
+    double sorted[3] = {}, exact[3] = {}, approximate[3] = {};
+    const double qs[3] = {0.5, 0.95, 0.99};
+
+    mk::Stopwatch sw;
+    std::vector<double> seen, copy;
+    for (std::size_t i = 0; i < N; ++i)
+    {
+        seen.push_back(temps[i]);
+        if ((i + 1) % every == 0)
+        {
+            copy = seen;
+            std::sort(copy.begin(), copy.end());
+            for (int k = 0; k < 3; ++k)
+                sorted[k] = copy[std::max<std::size_t>(1, static_cast<std::size_t>(std::ceil(qs[k] * copy.size()))) - 1];
+        }
+    }
+    mk::printTiming("sort per query", sw.elapsedMs());
+
+    sw.restart();
+    mk::RunningQuantile running[3] = {mk::RunningQuantile{qs[0]}, mk::RunningQuantile{qs[1]}, mk::RunningQuantile{qs[2]}};
+    for (std::size_t i = 0; i < N; ++i)
+    {
+        for (auto &r : running)
+            r.add(temps[i]);
+        if ((i + 1) % every == 0)
+            for (int k = 0; k < 3; ++k)
+                exact[k] = running[k].value();
+    }
+    mk::printTiming("RunningQuantile (two heaps)", sw.elapsedMs());
+
+    sw.restart();
+    mk::TDigest digest;
+    for (std::size_t i = 0; i < N; ++i)
+    {
+        digest.add(temps[i]);
+        if ((i + 1) % every == 0)
+            for (int k = 0; k < 3; ++k)
+                approximate[k] = digest.quantile(qs[k]);
+    }
+    mk::printTiming("TDigest", sw.elapsedMs());
+    std::cout << "    " << digest.centroidCount() << " centroids, " << digest.bytes() << " bytes (the heaps: "
+              << 3 * N * sizeof(double) << " bytes)\n";
+
+    // 4 threads, one digest each, merged
+    sw.restart();
+    const unsigned threads = 4;
+    std::vector<mk::TDigest> parts(threads);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t)
+        workers.emplace_back([&, t] {
+            for (std::size_t i = t * N / threads; i < (t + 1) * N / threads; ++i)
+                parts[t].add(temps[i]);
+        });
+    for (auto &w : workers)
+        w.join();
+    mk::TDigest merged;
+    for (const auto &part : parts)
+        merged.merge(part);
+    mk::printTiming("TDigest, 4 threads + merge", sw.elapsedMs());
+
+    // how far off the digests are, as quantiles: 0.95 found at the rank of 0.9497 is an error of 0.0003
+    std::sort(temps.begin(), temps.end());
+    std::cout << "   q      sort  two heaps   t-digest (rank)    merged (rank)\n";
+    std::streamsize precision = std::cout.precision(4);
+    for (int k = 0; k < 3; ++k)
+    {
+        double m = merged.quantile(qs[k]);
+        std::cout << std::setw(4) << qs[k] << std::setw(10) << sorted[k] << std::setw(11) << exact[k] << std::setw(11)
+                  << approximate[k] << " (" << rankOf(temps, approximate[k]) << ")" << std::setw(10) << m << " ("
+                  << rankOf(temps, m) << ")\n";
+    }
+    std::cout.precision(precision);
+}
@@ -0,0 +1,88 @@
+/*
+Object lifetimes
+
+Every object is created by a constructor (default, from arguments, copy or move) and ends with exactly one destructor
+call. Which constructor runs, and how often, is decided by the language rules for initialization, argument passing,
+returning and container growth - and the answers are not always the ones we expect. mk::X prints every event;
+LifetimeProbe (lifetime_probe.h) counts them, so that we can check them with assert.
+*/
+
+#include "functions.h"
+#include "lifetime_probe.h"
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+using std::cout;
+using std::endl;
+
+using StringProbe = mk::LifetimeProbe<std::string>;
+
+// Returning a by-value parameter: no copy elision is possible, but the return is an implicit move.
+static StringProbe passThrough(StringProbe p)
+{
+    return p;
+}
+
+// Returning a local: the object is constructed right in the caller (named return value optimization).
+static StringProbe makeLocal()
+{
+    StringProbe local{"local"};
+    return local;
+}
+
+void lifetimeProbeBasics()
+{
+    printTitle("Lifetime Probe Basics");
+
+    // switched off, a probe is nothing but the object itself
+    static_assert(sizeof(mk::LifetimeProbe<std::string, false>) == sizeof(std::string));
+    static_assert(std::is_trivially_copyable_v<mk::LifetimeProbe<int, false>>);
+
+    auto whole = mk::probe_scope<std::string>();
+
+    {
+        // A growing vector moves its elements to the new buffer, if the move constructor is noexcept.
+        auto s = mk::probe_scope<std::string>();
+        std::vector<StringProbe> v;
+        for (int i = 0; i < 100; ++i)
+            v.emplace_back("element");
+        s.report("vector growth");
+        if constexpr (mk::lifetimeProbeEnabled)
+            assert(s.counts().copies() == 0);
+    }
+
+    {
+        StringProbe arg{"argument"};
+        auto s = mk::probe_scope<std::string>();
+        StringProbe result = passThrough(std::move(arg));
+        s.report("passThrough(std::move(arg))");
+        if constexpr (mk::lifetimeProbeEnabled)
+            assert(s.counts().copies() == 0 && s.counts().moveConstructions == 2); // into the parameter, and out
+    }
+
+    {
+        auto s = mk::probe_scope<std::string>();
+        StringProbe result = makeLocal();
+        s.report("makeLocal()");
+        if constexpr (mk::lifetimeProbeEnabled)
+            assert(s.counts().moves() <= 1 && s.counts().copies() == 0); // 0 with NRVO
+    }
+
+    {
+        // all probes, whatever the wrapped type: the bytes of the vector's buffers, too
+        auto s = mk::probe_scope();
+        std::vector<mk::LifetimeProbe<int>, mk::ProbeAllocator<mk::LifetimeProbe<int>>> v(10);
+        v.push_back(42);
+        s.report("vector<LifetimeProbe<int>>");
+        // a buffer of 10, then one of 20 (libstdc++ doubles the capacity), and the first one freed
+        if constexpr (mk::lifetimeProbeEnabled)
+            assert(s.counts().heapBytesAllocated == 30 * sizeof(mk::LifetimeProbe<int>) &&
+                   s.counts().heapBytesFreed == 10 * sizeof(mk::LifetimeProbe<int>));
+    }
+
+    // Every scope above has ended: everything that was constructed, has been destroyed.
+    cout << "live string probes: " << whole.counts().live() << endl;
+}
@@ -166,6 +166,30 @@ ostream &operator<<(ostream &os, const Entity &e)
     // return os;
 }
 
+PmrEntity::PmrEntity(const allocator_type &alloc) : e_name(alloc)
+{
+}
+
+PmrEntity::PmrEntity(std::string_view name, int s, const allocator_type &alloc) : e_name(name, alloc), e_size(s)
+{
+}
+
+PmrEntity::PmrEntity(const PmrEntity &other, const allocator_type &alloc)
+    : e_name(other.e_name, alloc), e_size(other.e_size)
+{
+}
+
+// If other lives in a different resource, the name cannot be stolen and is copied into ours instead.
+PmrEntity::PmrEntity(PmrEntity &&other, const allocator_type &alloc)
+    : e_name(std::move(other.e_name), alloc), e_size(other.e_size)
+{
+}
+
+ostream &operator<<(ostream &os, const PmrEntity &e)
+{
+    return os << "PmrEntity{name:" << e.getName() << ", size:" << e.getSize() << "}";
+}
+
 } // namespace mk
   /*
   #include <iostream>
@@ -4,6 +4,10 @@
 #pragma once
 #include <cmath>
 #include <iostream>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <variant>
 
 // using namespace std;
 // using std::ostream;
@@ -109,11 +113,66 @@ bool operator==(const Entity &lhs, const Entity &rhs);
 // Operator overloading using non-member function:
 std::ostream &operator<<(std::ostream &os, const mk::Entity &e);
 
+/*
+Allocator-aware variant of Entity.
+Entity hits the global allocator once for the object (new / make_unique) and once more for its name. PmrEntity keeps
+its name in a std::pmr::string, so both the entity and its name come from whatever std::pmr::memory_resource it was
+created with - typically an arena (see arena.h) that is released as a whole at the end of a batch.
+
+Declaring allocator_type makes the class "allocator-aware": a std::pmr container hands its own allocator to every
+element it constructs (uses-allocator construction), so
+
+    std::pmr::vector<PmrEntity> batch{arena.allocator()};
+    batch.emplace_back("E1", 1); // the name is allocated from the arena, too.
+
+Unlike Entity, it does not print from its constructors: it is meant to be created by the hundred thousand.
+*/
+class PmrEntity
+{
+    std::pmr::string e_name;
+    int e_size = 0;
+
+  public:
+    using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+    PmrEntity() = default;
+    explicit PmrEntity(const allocator_type &alloc);
+    PmrEntity(std::string_view n, int s = 1, const allocator_type &alloc = {});
+
+    // Copy and move constructors, plus their allocator-extended forms used by pmr containers.
+    PmrEntity(const PmrEntity &other) = default;
+    PmrEntity(PmrEntity &&other) noexcept = default;
+    PmrEntity(const PmrEntity &other, const allocator_type &alloc);
+    PmrEntity(PmrEntity &&other, const allocator_type &alloc);
+
+    PmrEntity &operator=(const PmrEntity &other) = default;
+    PmrEntity &operator=(PmrEntity &&other) = default;
+
+    allocator_type get_allocator() const
+    {
+        return e_name.get_allocator();
+    }
+
+    const std::pmr::string &getName() const
+    {
+        return e_name;
+    }
+    int getSize() const
+    {
+        return e_size;
+    }
+
+}; // class PmrEntity
+
+std::ostream &operator<<(std::ostream &os, const mk::PmrEntity &e);
+
 class Shape2D
 {
 
   public:
-    double perimeter();
+    // A base class that is used polymorphically (through a Shape2D* or Shape2D&) needs a virtual destructor, so that
+    // deleting a derived object through a base pointer runs the derived destructor, too.
+    virtual ~Shape2D() = default;
 
     void info()
     {
@@ -135,15 +194,52 @@ class Shape2D
 
     // An abstract class contains at least one pure virtual function. You declare a pure virtual function by using a
     // pure specifier(= 0) in the declaration of a virtual member function in the class declaration.
-    virtual double area() = 0;
+    // Both are quiet, const computations: printing is the caller's business.
+    virtual double area() const = 0;
+    virtual double perimeter() const = 0;
 };
 
-class Rectangle : public Shape2D
+// final: nothing derives from Rectangle or Circle, so a call on one of them (not through a Shape2D) needs no vtable.
+class Rectangle final : public Shape2D
 {
     double width, height;
+
+  public:
+    Rectangle(double w, double h) : width(w), height(h)
+    {
+    }
+
+    void info()
+    {
+        std::cout << "This is Rectangle with width: " << width << ", height: " << height << "\n";
+    }
+
+    void draw() override
+    {
+        std::cout << "Drawing a Rectangle" << std::endl;
+    }
+
+    double area() const override
+    {
+        return width * height;
+    }
+
+    double perimeter() const override
+    {
+        return 2 * (width + height);
+    }
+
+    double getWidth() const
+    {
+        return width;
+    }
+    double getHeight() const
+    {
+        return height;
+    }
 };
 
-class Circle : public Shape2D
+class Circle final : public Shape2D
 {
     double radius;
 
@@ -167,14 +263,136 @@ class Circle : public Shape2D
     }
 
     // override pure virtual function of the base.
-    double area() override
+    double area() const override
+    {
+        return radius * radius * M_PI;
+    }
+
+    double perimeter() const override
+    {
+        return 2 * M_PI * radius;
+    }
+
+    double getRadius() const
     {
-        double a = radius * radius * M_PI;
-        std::cout << "Area: " << a << std::endl;
-        return a;
+        return radius;
     }
 };
 
+/*
+Static polymorphism
+The virtual functions above are dispatched at run time: the call goes through the vtable of the object. When the
+set of shape types is known at compile time, the dispatch can be resolved by the compiler instead, which lets it
+inline the call (and, in a loop, vectorize it).
+
+1. CRTP (Curiously Recurring Template Pattern)
+A class template that is instantiated with the derived class itself. The base knows the derived type, so it can call
+its members with a static_cast instead of a virtual call:
+
+    class StaticCircle : public StaticShape2D<StaticCircle> { ... };
+
+There is no common base class: StaticShape2D<StaticCircle> and StaticShape2D<StaticRectangle> are unrelated types,
+so a container can only hold one kind of shape, and generic code is written as templates.
+*/
+template <typename Derived> class StaticShape2D
+{
+  public:
+    void draw()
+    {
+        static_cast<Derived *>(this)->drawImpl();
+    }
+
+    double area() const
+    {
+        return static_cast<const Derived *>(this)->areaImpl();
+    }
+
+    double perimeter() const
+    {
+        return static_cast<const Derived *>(this)->perimeterImpl();
+    }
+};
+
+class StaticCircle : public StaticShape2D<StaticCircle>
+{
+    double radius;
+
+    // the base calls the private implementation
+    friend class StaticShape2D<StaticCircle>;
+
+    void drawImpl()
+    {
+        std::cout << "Drawing a Circle" << std::endl;
+    }
+
+    double areaImpl() const
+    {
+        return radius * radius * M_PI;
+    }
+
+    double perimeterImpl() const
+    {
+        return 2 * M_PI * radius;
+    }
+
+  public:
+    StaticCircle(double r) : radius(r)
+    {
+    }
+};
+
+class StaticRectangle : public StaticShape2D<StaticRectangle>
+{
+    double width, height;
+
+    friend class StaticShape2D<StaticRectangle>;
+
+    void drawImpl()
+    {
+        std::cout << "Drawing a Rectangle" << std::endl;
+    }
+
+    double areaImpl() const
+    {
+        return width * height;
+    }
+
+    double perimeterImpl() const
+    {
+        return 2 * (width + height);
+    }
+
+  public:
+    StaticRectangle(double w, double h) : width(w), height(h)
+    {
+    }
+};
+
+/*
+2. std::variant
+A closed set of alternatives, stored by value: a variant holds exactly one of its types, plus an index telling which.
+std::visit calls the overload for the active alternative through a table of function pointers indexed by that index
+(a jump table), and every entry calls a concrete type, so no vtable is involved.
+Unlike CRTP, a vector<ShapeVariant> can hold circles and rectangles side by side, without a pointer per shape.
+*/
+using ShapeVariant = std::variant<Circle, Rectangle>;
+
+// The lambda is instantiated once per alternative; s is a Circle& or a Rectangle&, so the calls are not virtual.
+inline double area(const ShapeVariant &shape)
+{
+    return std::visit([](const auto &s) { return s.area(); }, shape);
+}
+
+inline double perimeter(const ShapeVariant &shape)
+{
+    return std::visit([](const auto &s) { return s.perimeter(); }, shape);
+}
+
+inline void draw(ShapeVariant &shape)
+{
+    std::visit([](auto &s) { s.draw(); }, shape);
+}
+
 class NoCopy
 {
     /*
@@ -206,7 +424,8 @@ class NoCopy
     NoCopy &operator=(const NoCopy &other) = delete; // prevent copying
 };
 
-// simple test class
+// simple test class: prints every construction, copy and destruction.
+// (To count them instead, and check the counts, see LifetimeProbe in lifetime_probe.h)
 struct X
 {
     int val;
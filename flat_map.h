@@ -0,0 +1,483 @@
+/* flat_map.h */
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+FlatSet and FlatMap: a set and a map in sorted vectors.
+
+std::set and std::map are red-black trees: every element is a node of its own on the free store, with three pointers
+and a colour next to it (32 bytes on a 64-bit machine, and the allocator's own bookkeeping on top), and a lookup
+follows log2(n) pointers to nodes anywhere in memory - a cache miss each, once the tree no longer fits the cache.
+
+A table that is built once and then only read needs none of that: the elements sorted in a vector are enough. A
+lookup is a binary search over contiguous keys, the table takes the memory of its elements and nothing more, and a
+loop over it is a loop over an array. The price is paid by updates: an insert or an erase moves every element after
+it, O(n). So build in bulk - sort once, drop the duplicates:
+
+    mk::FlatMap<std::string, int> ids{std::move(pairs)};         // of pairs with equal keys, the first one stays
+    if (auto it = ids.find(std::string_view{name}); it != ids.end())
+        use((*it).second);
+
+The keys and the values are two vectors (like C++23's std::flat_map): a search only reads keys, so more of them share a
+cache line. An iterator gives a pair of references, {key, value}. Bool values are kept a byte each, not in the bits
+of a std::vector<bool>, so that there is a bool & to give.
+
+Lookups with another type than the key work as with std::map: with a transparent comparison - the default, std::less<>
+- a std::string key is compared with a string_view or a const char * directly, and no string is made for the lookup.
+With a comparison that is not transparent, the key is converted once per lookup.
+
+How the binary search is done is a policy:
+    StdLowerBound           std::lower_bound: a branch per step, and the processor guesses the way - wrongly half of
+                            the time, on random keys
+    BranchlessLowerBound    the same steps, with a conditional move instead of the branch, and the two middles the
+                            next step may look at prefetched: no wrong guesses, and the memory of the next step is on
+                            its way during this one
+
+    mk::FlatSet<std::uint64_t, std::less<>, mk::BranchlessLowerBound> seen{std::move(ids)};
+
+The branchless search pays off with keys that compare in an instruction (integers); with strings the compare itself
+branches.
+*/
+namespace mk
+{
+
+// The index of the first of the n sorted keys at first that is not less than key.
+struct StdLowerBound
+{
+    template <typename T, typename K, typename Compare>
+    std::size_t operator()(const T *first, std::size_t n, const K &key, const Compare &less) const
+    {
+        return static_cast<std::size_t>(std::lower_bound(first, first + n, key, less) - first);
+    }
+};
+
+struct BranchlessLowerBound
+{
+    template <typename T, typename K, typename Compare>
+    std::size_t operator()(const T *first, std::size_t n, const K &key, const Compare &less) const
+    {
+        if (n == 0)
+            return 0;
+        // the answer is in [base, base + n]; every step keeps the half it is in
+        const T *base = first;
+        while (n > 1)
+        {
+            const std::size_t half = n / 2;
+#if defined(__GNUC__) || defined(__clang__)
+            __builtin_prefetch(base + (n - half) / 2);
+            __builtin_prefetch(base + half + (n - half) / 2);
+#endif
+            base = less(base[half], key) ? base + half : base;
+            n -= half;
+        }
+        return static_cast<std::size_t>(base - first) + (less(*base, key) ? 1 : 0);
+    }
+};
+
+namespace detail
+{
+
+// std::vector<bool> keeps its values in bits, and has no bool & to give out: a FlatMap keeps bools one to a Flag
+struct Flag
+{
+    bool value;
+};
+
+template <typename Value> using StoredValue = std::conditional_t<std::is_same_v<Value, bool>, Flag, Value>;
+
+// key as the comparison takes it: as it is if the comparison is transparent, or a Key already; else converted to Key
+template <typename Key, typename Compare, typename K> decltype(auto) lookupKey(const K &key)
+{
+    if constexpr (std::is_same_v<K, Key> || requires { typename Compare::is_transparent; })
+        return (key);
+    else
+        return Key(key);
+}
+
+} // namespace detail
+
+template <typename Key, typename Compare = std::less<>, typename Search = StdLowerBound> class FlatSet
+{
+    std::vector<Key> elements; // sorted, no two equal
+    [[no_unique_address]] Compare less;
+    [[no_unique_address]] Search search;
+
+    template <typename K> std::size_t lowerIndex(const K &key) const
+    {
+        const auto &k = detail::lookupKey<Key, Compare>(key);
+        return search(elements.data(), elements.size(), k, less);
+    }
+
+    template <typename K> bool foundAt(std::size_t i, const K &key) const
+    {
+        return i < elements.size() && !less(detail::lookupKey<Key, Compare>(key), elements[i]);
+    }
+
+  public:
+    using key_type = Key;
+    using value_type = Key;
+    using size_type = std::size_t;
+    using const_iterator = typename std::vector<Key>::const_iterator;
+    using iterator = const_iterator;
+
+    FlatSet() = default;
+
+    // The bulk build: sorts keys, and drops the repeated ones.
+    explicit FlatSet(std::vector<Key> keys, const Compare &compare = Compare{})
+        : elements(std::move(keys)), less(compare)
+    {
+        std::sort(elements.begin(), elements.end(), less);
+        auto equal = [&](const Key &a, const Key &b) { return !less(a, b) && !less(b, a); };
+        elements.erase(std::unique(elements.begin(), elements.end(), equal), elements.end());
+    }
+
+    FlatSet(std::initializer_list<Key> keys, const Compare &compare = Compare{})
+        : FlatSet(std::vector<Key>(keys), compare)
+    {
+    }
+
+    template <std::input_iterator It>
+    FlatSet(It first, It last, const Compare &compare = Compare{}) : FlatSet(std::vector<Key>(first, last), compare)
+    {
+    }
+
+    const_iterator begin() const
+    {
+        return elements.begin();
+    }
+
+    const_iterator end() const
+    {
+        return elements.end();
+    }
+
+    std::size_t size() const
+    {
+        return elements.size();
+    }
+
+    bool empty() const
+    {
+        return elements.empty();
+    }
+
+    // the keys, sorted
+    std::span<const Key> keys() const
+    {
+        return elements;
+    }
+
+    template <typename K> const_iterator lower_bound(const K &key) const
+    {
+        return elements.begin() + static_cast<std::ptrdiff_t>(lowerIndex(key));
+    }
+
+    template <typename K> const_iterator find(const K &key) const
+    {
+        const std::size_t i = lowerIndex(key);
+        return foundAt(i, key) ? elements.begin() + static_cast<std::ptrdiff_t>(i) : elements.end();
+    }
+
+    template <typename K> bool contains(const K &key) const
+    {
+        return foundAt(lowerIndex(key), key);
+    }
+
+    template <typename K> std::size_t count(const K &key) const
+    {
+        return contains(key) ? 1 : 0;
+    }
+
+    // One key, in O(size()). Returns where it is, and whether it was not there yet.
+    std::pair<const_iterator, bool> insert(Key key)
+    {
+        const std::size_t i = lowerIndex(key);
+        if (foundAt(i, key))
+            return {elements.begin() + static_cast<std::ptrdiff_t>(i), false};
+        return {elements.insert(elements.begin() + static_cast<std::ptrdiff_t>(i), std::move(key)), true};
+    }
+
+    // in O(size()); returns the number of keys erased, 0 or 1
+    template <typename K> std::size_t erase(const K &key)
+    {
+        const std::size_t i = lowerIndex(key);
+        if (!foundAt(i, key))
+            return 0;
+        elements.erase(elements.begin() + static_cast<std::ptrdiff_t>(i));
+        return 1;
+    }
+
+    void clear()
+    {
+        elements.clear();
+    }
+
+    void shrink_to_fit()
+    {
+        elements.shrink_to_fit();
+    }
+
+    // the memory of the set itself (not what the keys own, like the letters of long strings)
+    std::size_t bytes() const
+    {
+        return elements.capacity() * sizeof(Key);
+    }
+};
+
+template <typename Key, typename Value, typename Compare = std::less<>, typename Search = StdLowerBound> class FlatMap
+{
+    std::vector<Key> keyList;     // sorted, no two equal
+    std::vector<detail::StoredValue<Value>> valueList; // valueList[i] belongs to keyList[i]
+    [[no_unique_address]] Compare less;
+    [[no_unique_address]] Search search;
+
+    template <typename K> std::size_t lowerIndex(const K &key) const
+    {
+        const auto &k = detail::lookupKey<Key, Compare>(key);
+        return search(keyList.data(), keyList.size(), k, less);
+    }
+
+    template <typename K> bool foundAt(std::size_t i, const K &key) const
+    {
+        return i < keyList.size() && !less(detail::lookupKey<Key, Compare>(key), keyList[i]);
+    }
+
+    template <typename K> std::size_t indexOf(const K &key) const
+    {
+        const std::size_t i = lowerIndex(key);
+        return foundAt(i, key) ? i : keyList.size();
+    }
+
+    Value &valueAt(std::size_t i)
+    {
+        return const_cast<Value &>(std::as_const(*this).valueAt(i));
+    }
+
+    const Value &valueAt(std::size_t i) const
+    {
+        if constexpr (std::is_same_v<Value, bool>)
+            return valueList[i].value;
+        else
+            return valueList[i];
+    }
+
+    static detail::StoredValue<Value> stored(Value &&value)
+    {
+        if constexpr (std::is_same_v<Value, bool>)
+            return detail::Flag{value};
+        else
+            return std::move(value);
+    }
+
+  public:
+    // walks the two vectors side by side, by index; *it is a {key, value} pair of references
+    template <bool Const> class Iterator
+    {
+        using Map = std::conditional_t<Const, const FlatMap, FlatMap>;
+        using V = std::conditional_t<Const, const Value, Value>;
+        Map *map = nullptr;
+        std::size_t i = 0;
+
+      public:
+        using iterator_concept = std::input_iterator_tag;
+        using value_type = std::pair<Key, Value>;
+        using reference = std::pair<const Key &, V &>;
+        using difference_type = std::ptrdiff_t;
+
+        Iterator() = default;
+
+        Iterator(Map *map, std::size_t i) : map(map), i(i)
+        {
+        }
+
+        reference operator*() const
+        {
+            return {map->keyList[i], map->valueAt(i)};
+        }
+
+        Iterator &operator++()
+        {
+            ++i;
+            return *this;
+        }
+
+        Iterator operator++(int)
+        {
+            Iterator before = *this;
+            ++*this;
+            return before;
+        }
+
+        friend bool operator==(const Iterator &a, const Iterator &b)
+        {
+            return a.i == b.i;
+        }
+    };
+
+    using key_type = Key;
+    using mapped_type = Value;
+    using size_type = std::size_t;
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    FlatMap() = default;
+
+    // The bulk build: sorts the pairs by key; of pairs with equal keys, the first one stays.
+    explicit FlatMap(std::vector<std::pair<Key, Value>> pairs, const Compare &compare = Compare{}) : less(compare)
+    {
+        std::stable_sort(pairs.begin(), pairs.end(),
+                         [&](const auto &a, const auto &b) { return less(a.first, b.first); });
+        keyList.reserve(pairs.size());
+        valueList.reserve(pairs.size());
+        for (auto &[key, value] : pairs)
+            if (keyList.empty() || less(keyList.back(), key))
+            {
+                keyList.push_back(std::move(key));
+                valueList.push_back(stored(std::move(value)));
+            }
+        keyList.shrink_to_fit();
+        valueList.shrink_to_fit();
+    }
+
+    FlatMap(std::initializer_list<std::pair<Key, Value>> pairs, const Compare &compare = Compare{})
+        : FlatMap(std::vector<std::pair<Key, Value>>(pairs), compare)
+    {
+    }
+
+    iterator begin()
+    {
+        return {this, 0};
+    }
+
+    iterator end()
+    {
+        return {this, keyList.size()};
+    }
+
+    const_iterator begin() const
+    {
+        return {this, 0};
+    }
+
+    const_iterator end() const
+    {
+        return {this, keyList.size()};
+    }
+
+    std::size_t size() const
+    {
+        return keyList.size();
+    }
+
+    bool empty() const
+    {
+        return keyList.empty();
+    }
+
+    // the keys, sorted, and their values in the same order (not for bool values, which are not an array of bool)
+    std::span<const Key> keys() const
+    {
+        return keyList;
+    }
+
+    std::span<Value> values()
+        requires(!std::is_same_v<Value, bool>)
+    {
+        return valueList;
+    }
+
+    std::span<const Value> values() const
+        requires(!std::is_same_v<Value, bool>)
+    {
+        return valueList;
+    }
+
+    template <typename K> iterator find(const K &key)
+    {
+        return {this, indexOf(key)};
+    }
+
+    template <typename K> const_iterator find(const K &key) const
+    {
+        return {this, indexOf(key)};
+    }
+
+    template <typename K> bool contains(const K &key) const
+    {
+        return foundAt(lowerIndex(key), key);
+    }
+
+    // the value of key; throws std::out_of_range if there is none
+    template <typename K> Value &at(const K &key)
+    {
+        return const_cast<Value &>(std::as_const(*this).at(key));
+    }
+
+    template <typename K> const Value &at(const K &key) const
+    {
+        const std::size_t i = indexOf(key);
+        if (i == keyList.size())
+            throw std::out_of_range("FlatMap::at: no such key");
+        return valueAt(i);
+    }
+
+    // The value of key, inserted (value-initialized) in O(size()) if there is none.
+    Value &operator[](const Key &key)
+    {
+        const std::size_t i = lowerIndex(key);
+        if (!foundAt(i, key))
+        {
+            keyList.insert(keyList.begin() + static_cast<std::ptrdiff_t>(i), key);
+            valueList.insert(valueList.begin() + static_cast<std::ptrdiff_t>(i), stored(Value{}));
+        }
+        return valueAt(i);
+    }
+
+    // in O(size()); returns whether key was not there yet
+    bool insert_or_assign(Key key, Value value)
+    {
+        const std::size_t i = lowerIndex(key);
+        if (foundAt(i, key))
+        {
+            valueAt(i) = std::move(value);
+            return false;
+        }
+        keyList.insert(keyList.begin() + static_cast<std::ptrdiff_t>(i), std::move(key));
+        valueList.insert(valueList.begin() + static_cast<std::ptrdiff_t>(i), stored(std::move(value)));
+        return true;
+    }
+
+    // in O(size()); returns the number of pairs erased, 0 or 1
+    template <typename K> std::size_t erase(const K &key)
+    {
+        const std::size_t i = indexOf(key);
+        if (i == keyList.size())
+            return 0;
+        keyList.erase(keyList.begin() + static_cast<std::ptrdiff_t>(i));
+        valueList.erase(valueList.begin() + static_cast<std::ptrdiff_t>(i));
+        return 1;
+    }
+
+    void clear()
+    {
+        keyList.clear();
+        valueList.clear();
+    }
+
+    // the memory of the map itself (not what the keys and values own)
+    std::size_t bytes() const
+    {
+        return keyList.capacity() * sizeof(Key) + valueList.capacity() * sizeof(detail::StoredValue<Value>);
+    }
+};
+
+} // namespace mk
@@ -6,6 +6,7 @@
 
 #include "domain.h"
 #include "enums.h"
+#include "small_vector.h"
 
 /*
 
@@ -70,7 +71,7 @@ void increment_ptr(int *ptr);
 void increment_ref(int &ref);
 void print_refToConst(const std::string &s);
 void print_refToNonConst(std::string &s);
-double *createAndPassBack(int size);
+mk::SmallVector<double, 8> createAndPassBack(int size);
 int *returnTheAddressOfALocal();
 void functionPointerBasics();
 void lambdaBasics();
@@ -130,6 +131,7 @@ int binarySearch(int *arr, int cnt, int arg);
 void heapBasics();
 void listBasics();
 void stackBasics();
+void runningQuantileBenchmark();
 template <typename T> void processNode(T node);
 
 void exceptionBasics();
@@ -140,6 +142,34 @@ void throwACustomException();
 void fileBasics();
 void readFile();
 void writeFile();
+void readingsLoaderBenchmark();
+void readingsAggregationBenchmark();
+void readingArchiveBenchmark();
+void readingWriterBenchmark();
+void readingTailBenchmark();
+void readingCodecBenchmark();
+void slidingWindowBenchmark();
+void asyncReaderBenchmark();
+void lineIndexBenchmark();
+void logWriterBenchmark();
+void ctimeParserBenchmark();
+void tokenizerBenchmark();
+void wordCountBenchmark();
+void heavyHittersBenchmark();
+
+void arenaBasics();
+void arenaBenchmark();
+void objectPoolBasics();
+void lifetimeProbeBasics();
+void allocProfilerBasics();
+void alignedBufferBenchmark();
+void numArrayBasics();
+void numArrayBenchmark();
+void smallVectorBenchmark();
+void flatMapBenchmark();
+
+void shapeBatchBenchmark();
+void shapeDispatchBenchmark();
 
 // exercises
 unsigned long factorial(long n);
\ No newline at end of file
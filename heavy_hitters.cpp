@@ -0,0 +1,488 @@
+/* heavy_hitters.cpp */
+#include "heavy_hitters.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numbers>
+#include <stdexcept>
+#include <utility>
+
+#include "word_count.h"
+
+namespace mk
+{
+
+namespace
+{
+
+constexpr char SpaceSavingMagic[8] = {'M', 'K', 'T', 'O', 'P', 'K', 'S', '1'};
+constexpr char CountMinMagic[8] = {'M', 'K', 'C', 'M', 'S', 'K', 'T', '1'};
+constexpr std::uint32_t HeavyHittersVersion = 1;
+
+struct SpaceSavingHeader
+{
+    char magic[8]; // "MKTOPKS1"
+    std::uint32_t version;
+    std::uint32_t reserved;
+    std::uint64_t capacity;
+    std::uint64_t total;
+    std::uint64_t counterCount; // then per counter: varint length, the letters, varint count, varint error
+};
+static_assert(sizeof(SpaceSavingHeader) == 40);
+
+struct CountMinHeader
+{
+    char magic[8]; // "MKCMSKT1"
+    std::uint32_t version;
+    std::uint32_t depth;
+    std::uint64_t width;
+    std::uint64_t total; // then depth * width varint counters, row by row
+};
+static_assert(sizeof(CountMinHeader) == 32);
+
+void requireLittleEndian()
+{
+    if constexpr (std::endian::native != std::endian::little)
+        throw std::runtime_error("serialized sketches need a little-endian machine");
+}
+
+[[noreturn]] void corrupt(const char *what)
+{
+    throw std::runtime_error(std::string{"not a valid serialized sketch: "} + what);
+}
+
+void append(std::vector<std::uint8_t> &out, const void *data, std::size_t size)
+{
+    const auto *bytes = static_cast<const std::uint8_t *>(data);
+    out.insert(out.end(), bytes, bytes + size);
+}
+
+// 7 bits per byte, the lowest first; the high bit says that more follow (LEB128)
+void appendVarint(std::vector<std::uint8_t> &out, std::uint64_t value)
+{
+    for (; value >= 0x80; value >>= 7)
+        out.push_back(static_cast<std::uint8_t>(value | 0x80));
+    out.push_back(static_cast<std::uint8_t>(value));
+}
+
+class Reader
+{
+    std::string_view bytes;
+
+  public:
+    explicit Reader(std::string_view bytes) : bytes(bytes)
+    {
+    }
+
+    std::size_t left() const
+    {
+        return bytes.size();
+    }
+
+    std::string_view take(std::size_t size)
+    {
+        if (size > bytes.size())
+            corrupt("truncated");
+        std::string_view taken = bytes.substr(0, size);
+        bytes.remove_prefix(size);
+        return taken;
+    }
+
+    std::uint64_t varint()
+    {
+        std::uint64_t value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7)
+        {
+            const auto byte = static_cast<std::uint8_t>(take(1)[0]);
+            value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+                return value;
+        }
+        corrupt("a number of more than 64 bits");
+    }
+};
+
+template <typename Header> Header readHeader(Reader &in, const char (&magic)[8])
+{
+    requireLittleEndian();
+    Header header;
+    std::memcpy(&header, in.take(sizeof header).data(), sizeof header);
+    if (std::memcmp(header.magic, magic, sizeof header.magic) != 0)
+        corrupt("wrong magic");
+    if (header.version != HeavyHittersVersion)
+        corrupt("unknown version");
+    return header;
+}
+
+} // namespace
+
+SpaceSaving::SpaceSaving(std::size_t capacity) : k(capacity)
+{
+    if (capacity == 0 || capacity > std::numeric_limits<std::uint32_t>::max() / 4)
+        throw std::invalid_argument("SpaceSaving: the capacity must be between 1 and 2^30");
+    slots.assign(std::bit_ceil(2 * std::min<std::size_t>(k, 512)), 0);
+}
+
+// twice the slots, for the counters there are: at most half of them are ever in use
+void SpaceSaving::growSlots()
+{
+    slots.assign(slots.size() * 2, 0);
+    for (std::uint32_t counter = 0; counter < counters.size(); ++counter)
+        slots[findSlot(counters[counter].word, counters[counter].hash)] = counter + 1;
+}
+
+// the slot of word, or the empty slot where it would go
+std::size_t SpaceSaving::findSlot(std::string_view word, std::uint64_t hash) const
+{
+    const std::size_t mask = slots.size() - 1;
+    for (std::size_t i = hash & mask;; i = (i + 1) & mask)
+    {
+        if (slots[i] == 0)
+            return i;
+        const Counter &c = counters[slots[i] - 1];
+        if (c.hash == hash && c.word == word)
+            return i;
+    }
+}
+
+// Linear probing without tombstones: the entries after the removed one, up to the next empty slot, move back into the
+// gap unless that would put them before the slot their hash starts at.
+void SpaceSaving::removeSlot(std::size_t slot)
+{
+    const std::size_t mask = slots.size() - 1;
+    for (std::size_t next = (slot + 1) & mask; slots[next] != 0; next = (next + 1) & mask)
+    {
+        const std::size_t home = counters[slots[next] - 1].hash & mask;
+        // can the entry at next move to slot: is home outside (slot, next], cyclically?
+        const bool movable = slot <= next ? (home <= slot || home > next) : (home <= slot && home > next);
+        if (movable)
+        {
+            slots[slot] = slots[next];
+            slot = next;
+        }
+    }
+    slots[slot] = 0;
+}
+
+// the counter at position went up: down the heap, to where its children count at least as much
+void SpaceSaving::siftDown(std::size_t position)
+{
+    const std::uint32_t counter = heap[position];
+    const std::uint64_t count = counters[counter].count;
+    for (;;)
+    {
+        std::size_t child = 2 * position + 1;
+        if (child >= heap.size())
+            break;
+        if (child + 1 < heap.size() && counters[heap[child + 1]].count < counters[heap[child]].count)
+            ++child;
+        if (counters[heap[child]].count >= count)
+            break;
+        heap[position] = heap[child];
+        heapPosition[heap[position]] = static_cast<std::uint32_t>(position);
+        position = child;
+    }
+    heap[position] = counter;
+    heapPosition[counter] = static_cast<std::uint32_t>(position);
+}
+
+void SpaceSaving::add(std::string_view word, std::uint64_t hash, std::uint64_t n, std::uint64_t error)
+{
+    std::size_t slot = findSlot(word, hash);
+    if (slots[slot] != 0)
+    {
+        Counter &c = counters[slots[slot] - 1];
+        c.count += n;
+        c.error += error;
+        siftDown(heapPosition[slots[slot] - 1]);
+        return;
+    }
+
+    if (counters.size() < k)
+    {
+        if (2 * (counters.size() + 1) > slots.size())
+        {
+            growSlots();
+            slot = findSlot(word, hash);
+        }
+        // a new counter: up the heap, to below the first one that counts no more
+        const auto counter = static_cast<std::uint32_t>(counters.size());
+        counters.push_back({std::string{word}, hash, n, error});
+        slots[slot] = counter + 1;
+        std::size_t position = heap.size();
+        heap.push_back(counter);
+        heapPosition.push_back(0);
+        for (; position > 0 && counters[heap[(position - 1) / 2]].count > n; position = (position - 1) / 2)
+        {
+            heap[position] = heap[(position - 1) / 2];
+            heapPosition[heap[position]] = static_cast<std::uint32_t>(position);
+        }
+        heap[position] = counter;
+        heapPosition[counter] = static_cast<std::uint32_t>(position);
+        return;
+    }
+
+    // the word with the smallest count gives its counter to this one, which may have occurred that often unseen
+    const std::uint32_t counter = heap[0];
+    Counter &c = counters[counter];
+    removeSlot(findSlot(c.word, c.hash));
+    c.word.assign(word); // the capacity of the string is reused
+    c.hash = hash;
+    c.error = c.count + error;
+    c.count += n;
+    slots[findSlot(word, hash)] = counter + 1;
+    siftDown(0);
+}
+
+void SpaceSaving::add(std::string_view word, std::uint64_t n)
+{
+    words += n;
+    add(word, hashWord(word), n, 0);
+}
+
+std::uint64_t SpaceSaving::maxError() const
+{
+    return counters.size() < k ? 0 : counters[heap[0]].count;
+}
+
+std::vector<HeavyHitter> SpaceSaving::top(std::size_t n) const
+{
+    std::vector<const Counter *> sorted;
+    sorted.reserve(counters.size());
+    for (const Counter &c : counters)
+        sorted.push_back(&c);
+    n = std::min(n, sorted.size());
+    std::partial_sort(sorted.begin(), sorted.begin() + static_cast<std::ptrdiff_t>(n), sorted.end(),
+                      [](const Counter *a, const Counter *b) {
+                          return a->count != b->count ? a->count > b->count : a->word < b->word;
+                      });
+
+    std::vector<HeavyHitter> result;
+    result.reserve(n);
+    for (std::size_t i = 0; i < n; ++i)
+        result.push_back({sorted[i]->word, sorted[i]->count, sorted[i]->error});
+    return result;
+}
+
+/*
+The counts of both, word by word; a word missing from one of them gets that one's maxError() on top, as count and as
+error. Of those, the capacity() largest are kept, and inserted into empty counters again.
+*/
+void SpaceSaving::merge(const SpaceSaving &other)
+{
+    const std::uint64_t missingHere = maxError(), missingThere = other.maxError();
+    std::vector<Counter> merged;
+    merged.reserve(counters.size() + other.counters.size());
+    for (const Counter &c : counters)
+    {
+        const std::size_t slot = other.findSlot(c.word, c.hash);
+        if (other.slots[slot] != 0)
+        {
+            const Counter &o = other.counters[other.slots[slot] - 1];
+            merged.push_back({c.word, c.hash, c.count + o.count, c.error + o.error});
+        }
+        else
+            merged.push_back({c.word, c.hash, c.count + missingThere, c.error + missingThere});
+    }
+    for (const Counter &o : other.counters)
+        if (slots[findSlot(o.word, o.hash)] == 0)
+            merged.push_back({o.word, o.hash, o.count + missingHere, o.error + missingHere});
+
+    if (merged.size() > k)
+    {
+        std::nth_element(merged.begin(), merged.begin() + static_cast<std::ptrdiff_t>(k), merged.end(),
+                         [](const Counter &a, const Counter &b) { return a.count > b.count; });
+        merged.resize(k);
+    }
+
+    const std::uint64_t total = words + other.words;
+    counters.clear();
+    heap.clear();
+    heapPosition.clear();
+    std::fill(slots.begin(), slots.end(), 0);
+    for (Counter &c : merged)
+        add(c.word, c.hash, c.count, c.error);
+    words = total;
+}
+
+std::vector<std::uint8_t> SpaceSaving::serialize() const
+{
+    requireLittleEndian();
+    SpaceSavingHeader header{};
+    std::memcpy(header.magic, SpaceSavingMagic, sizeof SpaceSavingMagic);
+    header.version = HeavyHittersVersion;
+    header.capacity = k;
+    header.total = words;
+    header.counterCount = counters.size();
+
+    std::vector<std::uint8_t> out;
+    append(out, &header, sizeof header);
+    for (const Counter &c : counters)
+    {
+        appendVarint(out, c.word.size());
+        append(out, c.word.data(), c.word.size());
+        appendVarint(out, c.count);
+        appendVarint(out, c.error);
+    }
+    return out;
+}
+
+SpaceSaving SpaceSaving::deserialize(std::string_view bytes)
+{
+    Reader in{bytes};
+    const auto header = readHeader<SpaceSavingHeader>(in, SpaceSavingMagic);
+    // A counter takes 3 bytes at least, and memory is only taken for the counters there are, whatever the capacity: a
+    // header cannot make a few bytes cost gigabytes.
+    if (header.capacity == 0 || header.capacity > std::numeric_limits<std::uint32_t>::max() / 4 ||
+        header.counterCount > header.capacity || header.counterCount > in.left() / 3)
+        corrupt("wrong counter count");
+
+    SpaceSaving summary{static_cast<std::size_t>(header.capacity)};
+    for (std::uint64_t i = 0; i < header.counterCount; ++i)
+    {
+        const std::string_view word = in.take(in.varint());
+        const std::uint64_t count = in.varint(), error = in.varint();
+        const std::uint64_t hash = hashWord(word);
+        if (word.empty() || error > count || summary.slots[summary.findSlot(word, hash)] != 0)
+            corrupt("wrong counter");
+        summary.add(word, hash, count, error);
+    }
+    if (in.left() != 0)
+        corrupt("bytes after the end");
+    summary.words = header.total;
+    return summary;
+}
+
+CountMinSketch::CountMinSketch(std::size_t width, std::size_t depth) : width(std::bit_ceil(width)), depth(depth)
+{
+    if (width == 0 || depth == 0 || depth > 64)
+        throw std::invalid_argument("CountMinSketch: the width must be positive, the depth between 1 and 64");
+    counters.assign(this->width * depth, 0);
+}
+
+CountMinSketch CountMinSketch::withError(double epsilon, double delta)
+{
+    if (!(epsilon > 0 && epsilon < 1 && delta > 0 && delta < 1))
+        throw std::invalid_argument("CountMinSketch: epsilon and delta must be between 0 and 1");
+    return {static_cast<std::size_t>(std::ceil(std::numbers::e / epsilon)),
+            static_cast<std::size_t>(std::ceil(std::log(1 / delta)))};
+}
+
+/*
+The counter of row r is (h1 + r * h2) mod width, from the two halves of one 64-bit hash: as good as depth independent
+hash functions for the error bound (Kirsch, Mitzenmacher), at the price of one.
+*/
+namespace
+{
+
+struct RowHashes
+{
+    std::uint64_t first, step;
+
+    explicit RowHashes(std::string_view word)
+    {
+        const std::uint64_t hash = hashWord(word);
+        first = hash;
+        step = (std::rotl(hash, 32) * 0x9E3779B97F4A7C15ull) | 1; // odd: every row a different counter
+    }
+
+    std::size_t column(std::size_t row, std::size_t mask) const
+    {
+        return static_cast<std::size_t>(first + row * step) & mask;
+    }
+};
+
+} // namespace
+
+// conservative update: the word's counters go up to its new estimate, those that are higher already stay
+void CountMinSketch::add(std::string_view word, std::uint64_t n)
+{
+    const RowHashes h{word};
+    const std::size_t mask = width - 1;
+    std::uint64_t smallest = std::numeric_limits<std::uint64_t>::max();
+    for (std::size_t r = 0; r < depth; ++r)
+        smallest = std::min(smallest, counters[r * width + h.column(r, mask)]);
+    const std::uint64_t target = smallest + n;
+    for (std::size_t r = 0; r < depth; ++r)
+    {
+        std::uint64_t &c = counters[r * width + h.column(r, mask)];
+        c = std::max(c, target);
+    }
+    words += n;
+}
+
+std::uint64_t CountMinSketch::estimate(std::string_view word) const
+{
+    const RowHashes h{word};
+    const std::size_t mask = width - 1;
+    std::uint64_t smallest = std::numeric_limits<std::uint64_t>::max();
+    for (std::size_t r = 0; r < depth; ++r)
+        smallest = std::min(smallest, counters[r * width + h.column(r, mask)]);
+    return smallest;
+}
+
+double CountMinSketch::epsilon() const
+{
+    return std::numbers::e / static_cast<double>(width);
+}
+
+double CountMinSketch::delta() const
+{
+    return std::exp(-static_cast<double>(depth));
+}
+
+std::uint64_t CountMinSketch::errorBound() const
+{
+    return static_cast<std::uint64_t>(std::ceil(epsilon() * static_cast<double>(words)));
+}
+
+// Every counter is at least the count of every word that maps to it, in either sketch - and so is their sum.
+void CountMinSketch::merge(const CountMinSketch &other)
+{
+    if (other.width != width || other.depth != depth)
+        throw std::invalid_argument("CountMinSketch::merge: the sketches differ in width or depth");
+    for (std::size_t i = 0; i < counters.size(); ++i)
+        counters[i] += other.counters[i];
+    words += other.words;
+}
+
+std::vector<std::uint8_t> CountMinSketch::serialize() const
+{
+    requireLittleEndian();
+    CountMinHeader header{};
+    std::memcpy(header.magic, CountMinMagic, sizeof CountMinMagic);
+    header.version = HeavyHittersVersion;
+    header.depth = static_cast<std::uint32_t>(depth);
+    header.width = width;
+    header.total = words;
+
+    std::vector<std::uint8_t> out;
+    out.reserve(sizeof header + counters.size()); // most counters of a wide sketch fit into a byte
+    append(out, &header, sizeof header);
+    for (std::uint64_t c : counters)
+        appendVarint(out, c);
+    return out;
+}
+
+CountMinSketch CountMinSketch::deserialize(std::string_view bytes)
+{
+    Reader in{bytes};
+    const auto header = readHeader<CountMinHeader>(in, CountMinMagic);
+    // every counter takes a byte at least: a header that promises more counters than there are bytes is wrong
+    if (header.depth == 0 || header.depth > 64 || !std::has_single_bit(header.width) ||
+        header.width > in.left() / header.depth)
+        corrupt("wrong width or depth");
+
+    CountMinSketch sketch{static_cast<std::size_t>(header.width), header.depth};
+    for (std::uint64_t &c : sketch.counters)
+        c = in.varint();
+    if (in.left() != 0)
+        corrupt("bytes after the end");
+    sketch.words = header.total;
+    return sketch;
+}
+
+} // namespace mk
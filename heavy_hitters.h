@@ -0,0 +1,148 @@
+/* heavy_hitters.h */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+Word counts of an endless stream, in memory that does not grow.
+
+A map<string, size_t> (mapBasics()'s w_cnt), or countWords()'s tables, hold every different word they have seen: on
+a log that runs for months - ids, numbers, addresses in every line - that is without limit. Two summaries that stay
+the same size whatever comes, and pay for it with a known error:
+
+SpaceSaving (Metwally, Agrawal, El Abbadi, 2005): the top k. It counts at most k words. A word it does not count yet
+takes the place of the word with the smallest count, and starts from that count + 1 - it may have occurred that often
+before, unseen. So every count is too high by at most its error (the count it started from), and that is never more
+than total / k: a word that occurs more often than that is certain to be among the k.
+
+    mk::SpaceSaving top{1000};
+    for (std::string_view word : mk::tokens(line))
+        top.add(word);
+    for (const mk::HeavyHitter &w : top.top(10))  // w.count - w.error <= the true count <= w.count
+        ...
+
+CountMinSketch (Cormode, Muthukrishnan, 2005): a count for any word, from depth rows of width counters. A word adds to
+one counter in every row, chosen by a hash of its own per row; its estimate is the smallest of its counters - each is
+its count plus the counts of the words that collide with it there, so never too low. With width e / epsilon and depth
+ln(1 / delta), the estimate is too high by more than epsilon * total with probability at most delta. Conservative
+update raises the word's counters only as far as its new estimate - no higher than they must be - which leaves the
+bound as it is, and the estimates of the rare words much closer.
+
+Both are mergeable: the summaries of parts of a stream (threads, machines) merge into one of the whole stream, with
+the error bounds of the whole (the sketches must have the same width and depth). serialize() is the form to send them
+in: a small header and the numbers as varints, little-endian; deserialize() throws std::runtime_error on anything
+else.
+*/
+namespace mk
+{
+
+struct HeavyHitter
+{
+    std::string word;
+    std::uint64_t count; // at least the true count
+    std::uint64_t error; // and at most this much more: the true count is in [count - error, count]
+};
+
+class SpaceSaving
+{
+    struct Counter
+    {
+        std::string word;
+        std::uint64_t hash;
+        std::uint64_t count;
+        std::uint64_t error;
+    };
+    std::size_t k;
+    std::uint64_t words = 0;
+    std::vector<Counter> counters;           // at most k
+    std::vector<std::uint32_t> heap;         // the counters by count, the smallest first
+    std::vector<std::uint32_t> heapPosition; // of each counter
+    std::vector<std::uint32_t> slots;        // a hash table over the counters: counter + 1, 0 is empty
+
+    std::size_t findSlot(std::string_view word, std::uint64_t hash) const;
+    void growSlots();
+    void removeSlot(std::size_t slot);
+    void siftDown(std::size_t position);
+    void add(std::string_view word, std::uint64_t hash, std::uint64_t n, std::uint64_t error);
+
+  public:
+    // Counts at most capacity (> 0) words. The memory grows with the words counted, up to what capacity of them take.
+    explicit SpaceSaving(std::size_t capacity);
+
+    void add(std::string_view word, std::uint64_t n = 1);
+
+    // all the words added
+    std::uint64_t total() const
+    {
+        return words;
+    }
+
+    std::size_t capacity() const
+    {
+        return k;
+    }
+
+    // The largest error of any count, and the most often a word that is not counted can have occurred: the smallest
+    // count, once all the counters are in use (at most total() / capacity()); 0 before.
+    std::uint64_t maxError() const;
+
+    // the n largest counts, the largest first
+    std::vector<HeavyHitter> top(std::size_t n) const;
+
+    // Adds the counts of other: a word counted by only one of the two may have occurred up to the other's maxError()
+    // times there, which goes to its count and its error. Keeps the capacity() largest counts.
+    void merge(const SpaceSaving &other);
+
+    std::vector<std::uint8_t> serialize() const;
+    static SpaceSaving deserialize(std::string_view bytes);
+};
+
+class CountMinSketch
+{
+    std::size_t width; // a power of two
+    std::size_t depth;
+    std::uint64_t words = 0;
+    std::vector<std::uint64_t> counters; // depth rows of width
+
+  public:
+    // width is rounded up to a power of two
+    CountMinSketch(std::size_t width, std::size_t depth);
+
+    // The smallest sketch whose estimates are too high by more than epsilon * total() with probability at most delta.
+    static CountMinSketch withError(double epsilon, double delta);
+
+    void add(std::string_view word, std::uint64_t n = 1);
+
+    // at least the number of times word was added, and at most errorBound() more (with probability 1 - delta())
+    std::uint64_t estimate(std::string_view word) const;
+
+    std::uint64_t total() const
+    {
+        return words;
+    }
+
+    // e / width: the error of an estimate as a fraction of total()
+    double epsilon() const;
+
+    // e^-depth: the probability that an estimate is off by more than errorBound()
+    double delta() const;
+
+    // epsilon() * total()
+    std::uint64_t errorBound() const;
+
+    std::size_t bytes() const
+    {
+        return counters.size() * sizeof(std::uint64_t);
+    }
+
+    // Adds the counts of other, which must have the same width and depth (std::invalid_argument otherwise).
+    void merge(const CountMinSketch &other);
+
+    std::vector<std::uint8_t> serialize() const;
+    static CountMinSketch deserialize(std::string_view bytes);
+};
+
+} // namespace mk
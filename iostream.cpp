@@ -54,53 +54,62 @@ istream and the output classes from ostream. Thus, operations that can be perfor
 performed on either an ifstream or an istringstream. Similarly for the output classes, which inherit from ostream.
 */
 
+#include "alloc_profiler.h"
+#include "async_reader.h"
+#include "ctime_index.h"
 #include "functions.h"
+#include "heavy_hitters.h"
+#include "line_index.h"
+#include "log_writer.h"
+#include "mapped_file.h"
+#include "mk_benchmark.h"
+#include "reading_archive.h"
+#include "reading_codec.h"
+#include "reading_tail.h"
+#include "reading_writer.h"
+#include "readings.h"
+#include "sliding_window.h"
+#include "tokenizer.h"
+#include "word_count.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <cmath>
+#include <cstdio> // std::remove
+#include <cstring>
+#include <ctime>
 #include <fstream> // work with files
+#include <iomanip>
 #include <iostream>
+#include <map>
+#include <random>
 #include <sstream> // stringstream
+#include <system_error>
+#include <thread>
+#include <unordered_map>
 
+#include <fcntl.h>  // posix_fadvise
+#include <unistd.h>
+
+using mk::Reading; // Reading and its operators << and >> live in readings.h
 using std::cin;
 using std::cout;
 using std::endl;
 using std::ios;
 using std::string;
 
-// a temperature reading, for reading/writing a struct from file.
-struct Reading
-{
-    int hour{0}; // hour after midnight [0:23]
-    double temperature{0};
-
-    Reading() = default;
-    Reading(int h, double t) : hour(h), temperature(t)
-    {
-    }
-};
-
-// overloading '<<' operator.
-std::ostream &operator<<(std::ostream &os, const Reading &r)
-{
-    return os << r.hour << " " << r.temperature << endl;
-}
-
-// overloading '>>' operator.
-std::istream &operator>>(std::istream &is, Reading &r)
+// operator>> only reads: the prompt belongs to interactive input, not to every record read from a file.
+static bool promptForReading(Reading &r)
 {
     cout << "Enter hour and temperature, seperated by a space: (ie 21 33) ";
-    is >> r.hour >> r.temperature;
-
-    // cout << "Enter hour: ";
-    // is >> r.hour;
-    // cout << "Enter temperature: ";
-    // is >> r.temperature;
-
-    return is;
+    return static_cast<bool>(cin >> r);
 }
 
 /* Get a sentence as the input from the user */
 void words_of_sentence()
 {
+    MK_PROFILE_FUNCTION();
     string sentence;
     cout << "Enter a sentence, and i will extract words: ";
     std::getline(cin, sentence);
@@ -113,31 +122,35 @@ void words_of_sentence()
 
     // print words
     simplePrint(words);
+
+    // without a stream or a string per word: mk::tokens(sentence) (tokenizer.h)
 }
 
 void loadTemperaturesFromFile()
 {
 
-    // Defining an ifstream with a name string opens the file of that name for reading.
-    std::ifstream ifstr{"temperatures.txt"};
-
-    std::vector<Reading> temps;
-
-    if (ifstr)
+    // Defining an ifstream with a name string opens the file of that name for reading, and
+    //     for (Reading r; ifstr >> r;) temps.push_back(r);
+    // reads it record by record. loadReadings() maps the whole file instead, and parses it in place (readings.h).
+    mk::ReadingFile file;
+    try
     {
-        for (Reading r; ifstr >> r;)
-        {
-            temps.push_back(r);
-        }
-
-        ifstr.close();
+        file = mk::loadReadings("temperatures.txt");
+    }
+    catch (const std::exception &e)
+    {
+        cout << "Unable to open file: " << e.what() << endl;
+        return;
     }
 
-    else
-        cout << "Unable to open file";
+    // malformed lines do not stop the loading: they are reported, with their line numbers
+    for (const auto &e : file.errors)
+        std::cerr << "temperatures.txt:" << e.line << ": " << e.message << ": \"" << e.text << "\"\n";
+    if (file.malformedLines > file.errors.size())
+        std::cerr << "(" << file.malformedLines - file.errors.size() << " more malformed lines)\n";
 
     cout << "Readings from file: \n";
-    for (const auto &r : temps)
+    for (const auto &r : file.readings)
         cout << r;
 }
 
@@ -153,29 +166,25 @@ void saveTemperaturesToFile()
     // temps.emplace_back(23, 27);
 
     cout << "Please provide temperature readings." << endl;
-    // get temperature readings
-    for (Reading r; std::cin >> r;) // operator>> overloaded.
+    // get temperature readings: a prompt, then operator>>
+    for (Reading r; promptForReading(r);)
     {
         temps.push_back(r);
     }
 
-    // Defining an ofstream
-    // std::ofstream ofstr{"temperatures.txt"};
-    std::ofstream ofs{"temperatures.txt", ios::app};
-
-    // Defining an ofstream to "append"
-    // std::ofstream ofstr;
-    // flags can be combined using the bitwise operator OR (|)
-    // ofstr.open("temperatures.txt", ios::out | ios::app);
-
-    if (ofs)
+    // Defining an ofstream with ios::app opens the file for appending, and
+    //     for (const auto &t : temps) ofs << t;
+    // writes the readings with operator<<. ReadingWriter appends the same lines, formatted with to_chars into a buffer
+    // and written in one system call (reading_writer.h).
+    try
     {
-        for (const auto &t : temps)
-            ofs << t; // // operator<< overloaded.
+        mk::ReadingWriter writer{"temperatures.txt"};
+        writer.append(temps);
+        writer.flush(); // reports a write error; the destructor cannot
     }
-    else
+    catch (const std::system_error &e)
     {
-        std::cerr << "Error opening file." << endl;
+        std::cerr << "Error writing file: " << e.what() << endl;
     }
 }
 
@@ -211,6 +220,8 @@ void writeFile()
     }
     else
         cout << "Unable to open file";
+
+    // a program that logs many lines keeps a LogWriter (log_writer.h) open instead
 }
 
 void readFile()
@@ -234,4 +245,1319 @@ void readFile()
 
     else
         cout << "Unable to open file";
+
+    // a large file, with several reads in flight: forEachLine() (async_reader.h)
+}
+
+// "hour temperature" lines with one decimal, like a sensor would write them: independent temperatures, or (drifting)
+// ones that follow the time of day and change a little from one reading to the next
+static string readingsText(std::size_t count, bool drifting = false)
+{
+    std::mt19937 gen{2024};
+    std::normal_distribution<double> temperature{15.0, 8.0};
+    std::normal_distribution<double> drift{0.0, 0.3};
+    string text;
+    text.reserve(count * 9);
+    char line[32];
+    double t = 15.0;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        int hour = static_cast<int>(i % 24);
+        if (drifting)
+            t += drift(gen) + 0.5 * std::sin((hour - 9) * 3.14159265358979 / 12) - (t - 15.0) * 0.01;
+        int n = std::snprintf(line, sizeof line, "%d %.1f\n", hour, drifting ? t : temperature(gen));
+        text.append(line, static_cast<std::size_t>(n));
+    }
+    return text;
+}
+
+static void writeReadingsFile(const string &path, std::size_t count)
+{
+    string text = readingsText(count);
+    std::ofstream{path, ios::binary}.write(text.data(), static_cast<std::streamsize>(text.size()));
+}
+
+static void printThroughput(const string &label, double ms, std::size_t bytes)
+{
+    mk::printTiming(label, ms);
+    cout << "    " << static_cast<double>(bytes) / 1e6 / (ms / 1e3) << " MB/s\n";
+}
+
+/*
+The same readings file, loaded three ways:
+    ifstream >> Reading     the loop loadTemperaturesFromFile() used to run
+    loadReadings            mmap + hand-written parser into a reserved vector
+    forEachReading          the parser alone, over the mapped text (no vector)
+*/
+void readingsLoaderBenchmark()
+{
+    MK_PROFILE_FUNCTION();
+    printTitle("Readings Loader Benchmark");
+
+    const std::size_t N = 16'000'000;
+    const string path = "readings_benchmark.txt";
+    writeReadingsFile(path, N);
+    std::size_t bytes = static_cast<std::size_t>(std::ifstream{path, ios::binary | ios::ate}.tellg());
+    cout << N << " readings, " << bytes / 1'000'000 << " MB\n";
+
+    mk::Stopwatch sw;
+    std::vector<Reading> streamed;
+    {
+        std::ifstream ifstr{path};
+        for (Reading r; ifstr >> r;)
+            streamed.push_back(r);
+    }
+    printThroughput("ifstream >> Reading", sw.elapsedMs(), bytes);
+
+    sw.restart();
+    mk::ReadingFile loaded = mk::loadReadings(path);
+    printThroughput("loadReadings (mmap + parse)", sw.elapsedMs(), bytes);
+
+    {
+        mk::MappedFile file{path};
+        double best = 1e300;
+        for (int run = 0; run < 3; ++run)
+        {
+            sw.restart();
+            double sum = 0;
+            mk::forEachReading(
+                file.text(), 1, [&](const Reading &r) { sum += r.temperature; },
+                [](std::size_t, const char *, std::string_view) {});
+            mk::doNotOptimize(sum);
+            best = std::min(best, sw.elapsedMs());
+        }
+        printThroughput("forEachReading (parse only)", best, bytes);
+    }
+
+    bool same = streamed.size() == loaded.readings.size() &&
+                std::equal(streamed.begin(), streamed.end(), loaded.readings.begin(), [](const Reading &a, const Reading &b) {
+                    return a.hour == b.hour && a.temperature == b.temperature;
+                });
+    cout << "identical readings: " << std::boolalpha << same << std::noboolalpha << endl;
+    std::remove(path.c_str());
+
+    // a stream stops at the first bad record; the loader reports it and goes on
+    mk::ReadingFile bad = mk::parseReadings("13 33\n24 10\n7 warm\n\n8 12.5 C\n9 -1.5\n");
+    cout << "parsed " << bad.readings.size() << " of " << bad.lines << " lines\n";
+    for (const auto &e : bad.errors)
+        cout << "  line " << e.line << ": " << e.message << ": \"" << e.text << "\"\n";
+}
+
+static bool sameBits(const mk::HourlyStats &a, const mk::HourlyStats &b)
+{
+    for (std::size_t h = 0; h < a.hours.size(); ++h)
+    {
+        const mk::HourStats &x = a.hours[h], &y = b.hours[h];
+        if (x.count != y.count || std::memcmp(&x.sum, &y.sum, sizeof x.sum) != 0 || x.min != y.min || x.max != y.max)
+            return false;
+    }
+    return a.readings == b.readings && a.malformedLines == b.malformedLines;
+}
+
+/*
+Per-hour statistics of a readings file:
+    load + loop         loadReadings(), then one loop over the vector
+    aggregateReadings   straight from the mapped text, in fixed blocks, with 1, 2, 4, ... threads
+*/
+void readingsAggregationBenchmark()
+{
+    MK_PROFILE_FUNCTION();
+    printTitle("Readings Aggregation Benchmark");
+
+    const std::size_t N = 16'000'000;
+    const string path = "readings_benchmark.txt";
+    writeReadingsFile(path, N);
+    mk::MappedFile file{path};
+    cout << N << " readings, " << file.size() / 1'000'000 << " MB, " << std::thread::hardware_concurrency()
+         << " hardware threads\n";
+
+    mk::Stopwatch sw;
+    mk::HourlyStats naive;
+    for (const Reading &r : mk::loadReadings(path).readings)
+        naive.add(r);
+    printThroughput("load + loop", sw.elapsedMs(), file.size());
+
+    sw.restart();
+    mk::HourlyStats reference = mk::aggregateReadings(file.text(), 1);
+    printThroughput("aggregateReadings, 1 thread", sw.elapsedMs(), file.size());
+
+    unsigned maxThreads = std::max(4u, std::thread::hardware_concurrency());
+    for (unsigned threads = 2; threads <= maxThreads; threads *= 2)
+    {
+        sw.restart();
+        mk::HourlyStats parallel = mk::aggregateReadings(file.text(), threads);
+        printThroughput("aggregateReadings, " + std::to_string(threads) + " threads", sw.elapsedMs(), file.size());
+        cout << "    identical to 1 thread: " << std::boolalpha << sameBits(parallel, reference) << std::noboolalpha
+             << "\n";
+    }
+
+    // the plain loop adds the same numbers in another order: equal counts, min and max, means equal up to rounding
+    cout << "hour  count      min      max          mean   (mean of the plain loop)\n";
+    std::streamsize precision = cout.precision(10);
+    for (int h : {0, 6, 12, 18, 23})
+    {
+        const mk::HourStats &s = reference.hours[static_cast<std::size_t>(h)];
+        cout << std::setw(4) << h << std::setw(7) << s.count << std::setw(9) << s.min << std::setw(9) << s.max
+             << std::setw(14) << s.mean() << "   (" << naive.hours[static_cast<std::size_t>(h)].mean() << ")\n";
+    }
+    cout.precision(precision);
+
+    std::remove(path.c_str());
+}
+
+/*
+The same readings as text and as a binary archive (reading_archive.h):
+    sizes               6-8 bytes of text per reading, 5 in the archive
+    per-hour stats      aggregateReadingsFile() parses the text; the archive is opened and its columns read in place
+    a query             readings above 55 degrees: the block stats rule out blocks without reading a temperature
+    round trip          archive -> text -> the same readings
+*/
+void readingArchiveBenchmark()
+{
+    MK_PROFILE_FUNCTION();
+    printTitle("Reading Archive Benchmark");
+
+    const std::size_t N = 16'000'000;
+    const string textPath = "readings_benchmark.txt";
+    const string archivePath = "readings_benchmark.mkr";
+    writeReadingsFile(textPath, N);
+
+    mk::Stopwatch sw;
+    std::size_t malformed = mk::convertTextToArchive(textPath, archivePath);
+    mk::printTiming("convertTextToArchive", sw.elapsedMs());
+
+    std::size_t textBytes = mk::MappedFile{textPath}.size();
+    std::size_t archiveBytes = mk::MappedFile{archivePath}.size();
+    cout << N << " readings (" << malformed << " malformed): text " << textBytes / 1'000'000 << " MB, archive "
+         << archiveBytes / 1'000'000 << " MB\n";
+
+    sw.restart();
+    mk::HourlyStats fromText = mk::aggregateReadingsFile(textPath, 1);
+    printThroughput("aggregateReadingsFile (text, 1 thread)", sw.elapsedMs(), textBytes);
+
+    sw.restart();
+    mk::ReadingArchive archive{archivePath};
+    double openMs = sw.elapsedMs();
+    mk::HourlyStats fromArchive = archive.aggregate();
+    double totalMs = sw.elapsedMs();
+    mk::printTiming("ReadingArchive: open", openMs);
+    printThroughput("ReadingArchive: open + aggregate", totalMs, archiveBytes);
+    cout << "    encoding: "
+         << (archive.encoding() == mk::TemperatureEncoding::FixedPoint
+                 ? "fixed point, " + std::to_string(archive.decimals()) + " decimals"
+                 : string{"float"})
+         << "\n";
+
+    bool same = fromText.readings == fromArchive.readings;
+    for (std::size_t h = 0; h < fromText.hours.size(); ++h)
+    {
+        const mk::HourStats &t = fromText.hours[h], &a = fromArchive.hours[h];
+        same = same && t.count == a.count && t.min == a.min && t.max == a.max;
+    }
+    cout << "    same counts, min and max as the text: " << std::boolalpha << same << std::noboolalpha << "\n";
+
+    // readings above 55 degrees (5 standard deviations): only the blocks whose max is above 55 are read
+    const double limit = 55.0;
+    sw.restart();
+    std::size_t hot = 0, blocksRead = 0;
+    std::span<const mk::ReadingBlockStats> blocks = archive.blockStats();
+    for (std::size_t b = 0; b < blocks.size(); ++b)
+    {
+        if (blocks[b].maxTemperature <= limit)
+            continue;
+        ++blocksRead;
+        std::size_t from = b * mk::ReadingArchive::BlockSize;
+        for (std::size_t i = from; i < from + blocks[b].count; ++i)
+            hot += archive.temperature(i) > limit;
+    }
+    mk::printTiming("readings above 55 degrees", sw.elapsedMs());
+    cout << "    " << hot << " readings, " << blocksRead << " of " << blocks.size() << " blocks read\n";
+
+    sw.restart();
+    mk::convertArchiveToText(archivePath, textPath);
+    mk::printTiming("convertArchiveToText", sw.elapsedMs());
+    mk::ReadingFile back = mk::loadReadings(textPath);
+    bool roundTrip = back.readings.size() == archive.size();
+    for (std::size_t i = 0; roundTrip && i < back.readings.size(); ++i)
+        roundTrip = back.readings[i].hour == archive[i].hour && back.readings[i].temperature == archive[i].temperature;
+    cout << "    same readings after the round trip: " << std::boolalpha << roundTrip << std::noboolalpha << endl;
+
+    // Crafted headers, whose sections end past 2^64 and so wrap around to offsets that look in place: the archive must
+    // refuse them, and not read past the end of the file.
+    auto openCorrupted = [&](const char *what, auto patchHeader) {
+        mk::ReadingArchiveHeader header;
+        {
+            std::fstream file{archivePath, std::ios::in | std::ios::out | std::ios::binary};
+            file.read(reinterpret_cast<char *>(&header), sizeof header);
+            const mk::ReadingArchiveHeader original = header;
+            patchHeader(header);
+            file.seekp(0);
+            file.write(reinterpret_cast<const char *>(&header), sizeof header);
+            header = original;
+        }
+        try
+        {
+            mk::ReadingArchive corrupted{archivePath};
+            cout << "    " << what << ": accepted, " << corrupted.size() << " readings\n";
+        }
+        catch (const std::runtime_error &e)
+        {
+            cout << "    " << what << ": " << e.what() << "\n";
+        }
+        std::fstream{archivePath, std::ios::in | std::ios::out | std::ios::binary}.write(
+            reinterpret_cast<const char *>(&header), sizeof header);
+    };
+    openCorrupted("2^62 readings", [](mk::ReadingArchiveHeader &h) {
+        h.readingCount = std::uint64_t{1} << 62;
+        h.blockCount = h.readingCount / mk::ReadingArchive::BlockSize;
+        h.temperaturesOffset = h.hoursOffset + h.readingCount;
+        h.blockStatsOffset = 0 - h.blockCount * sizeof(mk::ReadingBlockStats);
+    });
+    openCorrupted("block stats 64 bytes before 2^64", [](mk::ReadingArchiveHeader &h) { h.blockStatsOffset = 0 - 64; });
+    mk::ReadingArchive restored{archivePath};
+    cout << "    restored: " << restored.size() << " readings" << endl;
+
+    std::remove(textPath.c_str());
+    std::remove(archivePath.c_str());
+}
+
+static double nsPerReading(double ms, std::size_t count)
+{
+    return ms * 1e6 / static_cast<double>(count);
+}
+
+/*
+Appending readings to a file:
+    ofstream, std::endl         what saveTemperaturesToFile() did: a flush, i.e. a write() call, per reading
+    ofstream, '\n'              the stream's own buffer
+    ReadingWriter               to_chars into a 1 MB buffer, one write() per buffer; per reading, per vector, and
+                                from 4 threads
+and durable appends, where every producer waits for its reading to be on disk: one fdatasync per reading, or one per
+group of readings that arrived while the previous sync ran (SyncPolicy::GroupCommit).
+*/
+void readingWriterBenchmark()
+{
+    MK_PROFILE_FUNCTION();
+    printTitle("Reading Writer Benchmark");
+
+    const std::size_t N = 1'000'000;
+    const string path = "readings_writer.txt";
+    std::vector<Reading> readings;
+    readings.reserve(N);
+    std::mt19937 gen{2024};
+    std::normal_distribution<double> temperature{15.0, 8.0};
+    for (std::size_t i = 0; i < N; ++i)
+        readings.emplace_back(static_cast<int>(i % 24), std::round(temperature(gen) * 10) / 10);
+
+    auto report = [&](const string &label, double ms) {
+        mk::printTiming(label, ms);
+        cout << "    " << nsPerReading(ms, N) << " ns per reading\n";
+        std::remove(path.c_str());
+    };
+
+    mk::Stopwatch sw;
+    {
+        std::ofstream ofs{path, ios::app};
+        for (const auto &r : readings)
+            ofs << r.hour << " " << r.temperature << std::endl;
+    }
+    report("ofstream, std::endl", sw.elapsedMs());
+
+    sw.restart();
+    {
+        std::ofstream ofs{path, ios::app};
+        for (const auto &r : readings)
+            ofs << r;
+    }
+    report("ofstream, '\\n'", sw.elapsedMs());
+
+    sw.restart();
+    mk::ReadingWriterStats stats;
+    {
+        mk::ReadingWriter writer{path};
+        for (const auto &r : readings)
+            writer.append(r);
+        writer.flush();
+        stats = writer.stats();
+    }
+    double ms = sw.elapsedMs();
+    mk::ReadingFile back = mk::loadReadings(path);
+    bool same = back.readings.size() == N && std::equal(readings.begin(), readings.end(), back.readings.begin(),
+                                                       [](const Reading &a, const Reading &b) {
+                                                           return a.hour == b.hour && a.temperature == b.temperature;
+                                                       });
+    report("ReadingWriter, 1 thread", ms);
+    cout << "    " << stats.writes << " write() calls for " << stats.bytes << " bytes; same readings read back: "
+         << std::boolalpha << same << std::noboolalpha << "\n";
+
+    sw.restart();
+    {
+        mk::ReadingWriter writer{path};
+        writer.append(readings); // formatted in chunks: one lock per 64 readings
+        writer.flush();
+    }
+    report("ReadingWriter, 1 thread, append(span)", sw.elapsedMs());
+
+    const unsigned producers = 4;
+    sw.restart();
+    {
+        mk::ReadingWriter writer{path};
+        std::vector<std::thread> threads;
+        for (unsigned t = 0; t < producers; ++t)
+            threads.emplace_back([&, t] {
+                for (std::size_t i = t; i < N; i += producers)
+                    writer.append(readings[i]);
+            });
+        for (auto &t : threads)
+            t.join();
+        writer.flush();
+    }
+    report("ReadingWriter, 4 threads", sw.elapsedMs());
+
+    // durable: append, then wait until the reading is on disk
+    const std::size_t durable = 400;
+    for (unsigned threads : {1u, 8u})
+    {
+        mk::ReadingWriterOptions options;
+        options.sync = mk::SyncPolicy::GroupCommit;
+        sw.restart();
+        {
+            mk::ReadingWriter writer{path, options};
+            std::vector<std::thread> workers;
+            for (unsigned t = 0; t < threads; ++t)
+                workers.emplace_back([&, t] {
+                    for (std::size_t i = t; i < durable; i += threads)
+                    {
+                        writer.append(readings[i]);
+                        writer.flush();
+                    }
+                });
+            for (auto &t : workers)
+                t.join();
+            stats = writer.stats();
+        }
+        mk::printTiming("durable appends, " + std::to_string(threads) + " thread(s)", sw.elapsedMs());
+        cout << "    " << stats.syncs << " fdatasync() calls for " << stats.readings << " readings\n";
+        std::remove(path.c_str());
+    }
+}
+
+/*
+Following a readings file while it is appended to (reading_tail.h):
+    catch-up            the tail takes in the 1M readings that are already there
+    latency             another thread appends one reading at a time; how long until the tail's statistics have it
+    partial line, truncation, rotation
+*/
+void readingTailBenchmark()
+{
+    MK_PROFILE_FUNCTION();
+    printTitle("Reading Tail Benchmark");
+
+    const string path = "readings_tail.txt";
+    const std::size_t N = 1'000'000;
+    writeReadingsFile(path, N);
+
+    mk::Stopwatch sw;
+    mk::ReadingTail tail{path};
+    mk::printTiming("catch-up", sw.elapsedMs());
+    cout << "    " << tail.stats().readings << " readings\n";
+
+    // one append per millisecond; the next one only after the tail has seen the last
+    using clock = std::chrono::steady_clock;
+    const std::size_t appends = 200;
+    std::atomic<clock::rep> appendedAt{0};
+    std::atomic<std::size_t> seen{tail.stats().readings};
+    std::thread writer{[&] {
+        std::ofstream ofs{path, ios::app};
+        for (std::size_t i = 0; i < appends; ++i)
+        {
+            while (seen.load() < N + i)
+                std::this_thread::yield();
+            std::this_thread::sleep_for(std::chrono::milliseconds{1});
+            appendedAt.store(clock::now().time_since_epoch().count());
+            ofs << Reading{static_cast<int>(i % 24), 20.5} << std::flush; // one write()
+        }
+    }};
+    std::vector<double> latencies;
+    while (tail.stats().readings < N + appends)
+    {
+        if (tail.wait(std::chrono::milliseconds{100}) > 0)
+        {
+            clock::duration since = clock::now().time_since_epoch() - clock::duration{appendedAt.load()};
+            latencies.push_back(std::chrono::duration<double, std::micro>(since).count());
+            seen.store(tail.stats().readings);
+        }
+    }
+    writer.join();
+    std::sort(latencies.begin(), latencies.end());
+    cout << "append -> stats, " << latencies.size() << " appends: median " << latencies[latencies.size() / 2]
+         << " us, 99th percentile " << latencies[latencies.size() * 99 / 100] << " us, max " << latencies.back()
+         << " us\n";
+
+    // a line written in two pieces is taken in when its newline arrives
+    std::ofstream{path, ios::app} << "7 1" << std::flush;
+    tail.update();
+    cout << "after \"7 1\":  " << tail.stats().hours[7].count << " readings at 7h, " << tail.pendingBytes()
+         << " bytes pending\n";
+    std::ofstream{path, ios::app} << "2.5\n" << std::flush;
+    tail.update();
+    cout << "after \"2.5\\n\": " << tail.stats().hours[7].count << " readings at 7h, " << tail.pendingBytes()
+         << " bytes pending\n";
+
+    // truncated, then appended to; then rotated
+    std::ofstream{path, ios::trunc} << "1 10\n2 20\n";
+    tail.update();
+    std::rename(path.c_str(), (path + ".1").c_str());
+    std::ofstream{path} << "3 30\n";
+    tail.update();
+    cout << tail.stats().readings << " readings (" << N + appends + 1 + 3 << " expected), " << tail.truncations()
+         << " truncation, " << tail.rotations() << " rotation\n";
+
+    std::remove(path.c_str());
+    std::remove((path + ".1").c_str());
+}
+
+/*
+Compressed reading streams (reading_codec.h), for two kinds of readings:
+    independent     every temperature drawn anew: the worst case for deltas
+    drifting        temperatures that follow the time of day and change by tenths: what sensors send
+Sizes against the text and the archive (5 bytes per reading), and decoding speed into columns.
+*/
+void readingCodecBenchmark()
+{
+    MK_PROFILE_FUNCTION();
+    printTitle("Reading Codec Benchmark");
+
+    const std::size_t N = 8'000'000;
+    for (bool drifting : {false, true})
+    {
+        const string text = readingsText(N, drifting);
+        const mk::ReadingFile file = mk::parseReadings(text);
+        const std::vector<std::uint8_t> encoded = mk::encodeReadings(file.readings);
+        const std::string_view bytes{reinterpret_cast<const char *>(encoded.data()), encoded.size()};
+
+        cout << (drifting ? "drifting" : "independent") << " temperatures, " << N << " readings: text "
+             << text.size() / 1'000'000 << " MB, archive " << N * 5 / 1'000'000 << " MB, encoded "
+             << encoded.size() / 1'000'000 << " MB = " << static_cast<double>(encoded.size()) * 8 / N
+             << " bits per reading (" << static_cast<double>(text.size()) / static_cast<double>(encoded.size())
+             << "x smaller than the text)\n";
+
+        std::vector<std::uint8_t> hours;
+        std::vector<double> temperatures;
+        double best = 1e300;
+        for (int run = 0; run < 5; ++run)
+        {
+            mk::Stopwatch sw;
+            mk::decodeReadingColumns(bytes, hours, temperatures);
+            best = std::min(best, sw.elapsedMs());
+        }
+        mk::printTiming("    decodeReadingColumns", best);
+        cout << "    " << static_cast<double>(N) / best / 1e3 << " M readings/s ("
+             << 2 * static_cast<double>(N) / best / 1e3 << " M values/s)\n";
+
+        bool same = hours.size() == N;
+        for (std::size_t i = 0; same && i < N; ++i)
+            same = hours[i] == file.readings[i].hour && temperatures[i] == file.readings[i].temperature;
+        cout << "    same readings: " << std::boolalpha << same << std::noboolalpha << "\n";
+    }
+
+    // loadReadings() takes an encoded file like a text file
+    const string path = "readings_codec.mkz";
+    writeReadingsFile("readings_codec.txt", 100'000);
+    mk::convertTextToEncoded("readings_codec.txt", path);
+    mk::ReadingFile fromText = mk::loadReadings("readings_codec.txt");
+    mk::ReadingFile fromEncoded = mk::loadReadings(path);
+    bool same = fromText.readings.size() == fromEncoded.readings.size() &&
+                std::equal(fromText.readings.begin(), fromText.readings.end(), fromEncoded.readings.begin(),
+                           [](const Reading &a, const Reading &b) {
+                               return a.hour == b.hour && a.temperature == b.temperature;
+                           });
+    cout << "loadReadings of the encoded file: " << fromEncoded.readings.size() << " readings, the same as the text: "
+         << std::boolalpha << same << std::noboolalpha << endl;
+    std::remove(path.c_str());
+    std::remove("readings_codec.txt");
+}
+
+/*
+Count, min, max and mean of the last 1000 readings, after every reading:
+    rescan                  loop over the window every time: O(window) per reading
+    SlidingReadingStats     monotonic deques for min and max, two stacks for the sum: O(1) amortized
+    slidingMax              the batch form, over a whole array
+and a time-based window: the readings of the last hour, with a reading every minute or so.
+*/
+void slidingWindowBenchmark()
+{
+    MK_PROFILE_FUNCTION();
+    printTitle("Sliding Window Benchmark");
+
+    const std::size_t N = 1'000'000, W = 1000;
+    const std::vector<Reading> readings = mk::parseReadings(readingsText(N, true)).readings;
+
+    mk::Stopwatch sw;
+    std::vector<mk::HourStats> rescanned(N);
+    for (std::size_t i = 0; i < N; ++i)
+    {
+        mk::HourStats &s = rescanned[i];
+        for (std::size_t j = i + 1 > W ? i + 1 - W : 0; j <= i; ++j)
+            s.add(readings[j].temperature);
+    }
+    mk::printTiming("rescan", sw.elapsedMs());
+
+    sw.restart();
+    std::vector<mk::HourStats> sliding(N);
+    mk::slidingReadingStats(readings, W, sliding);
+    mk::printTiming("SlidingReadingStats", sw.elapsedMs());
+
+    bool same = true;
+    double meanDifference = 0;
+    for (std::size_t i = 0; i < N; ++i)
+    {
+        same = same && rescanned[i].count == sliding[i].count && rescanned[i].min == sliding[i].min &&
+               rescanned[i].max == sliding[i].max;
+        meanDifference = std::max(meanDifference, std::abs(rescanned[i].mean() - sliding[i].mean()));
+    }
+    cout << "    same count, min, max: " << std::boolalpha << same << std::noboolalpha
+         << "; means differ by at most " << meanDifference << " (summed in another order)\n";
+
+    std::vector<double> temperatures(N), maxima(N);
+    for (std::size_t i = 0; i < N; ++i)
+        temperatures[i] = readings[i].temperature;
+    sw.restart();
+    mk::slidingMax(temperatures, W, maxima);
+    mk::printTiming("slidingMax (batch)", sw.elapsedMs());
+    same = true;
+    for (std::size_t i = 0; i < N; ++i)
+        same = same && maxima[i] == sliding[i].max;
+    cout << "    same as SlidingReadingStats: " << std::boolalpha << same << std::noboolalpha << "\n";
+
+    // a reading every 30 to 90 seconds; the window is the last hour
+    std::mt19937 gen{7};
+    std::uniform_int_distribution<std::int64_t> gap{30, 90};
+    std::vector<std::int64_t> times(N);
+    for (std::size_t i = 1; i < N; ++i)
+        times[i] = times[i - 1] + gap(gen);
+    sw.restart();
+    mk::slidingReadingStats(readings, times, 3600, sliding);
+    mk::printTiming("SlidingReadingStats, last hour", sw.elapsedMs());
+    auto [fewest, most] =
+        std::minmax_element(sliding.begin() + 1000, sliding.end(),
+                            [](const mk::HourStats &a, const mk::HourStats &b) { return a.count < b.count; });
+    cout << "    " << fewest->count << " to " << most->count << " readings per hour\n";
+}
+
+// drops the file's pages from the page cache, so that the next read comes from the device
+static void evictFromPageCache(const string &path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+    ::fdatasync(fd);
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(fd);
+}
+
+/*
+A readings file, read four ways, counting its lines and then parsing it:
+    ifstream getline        one blocking read of the stream's small buffer at a time
+    MappedFile              mmap: page faults, and the kernel's read-ahead
+    AsyncFileReader         8 reads of 1 MB in flight: with io_uring, or with a pool of pread() threads
+"cold" drops the file from the page cache first, so the reads reach the device; "warm" reads it from memory, where the
+reader can only save system calls and copies.
+*/
+void asyncReaderBenchmark()
+{
+    MK_PROFILE_FUNCTION();
+    printTitle("Async Reader Benchmark");
+
+    const std::size_t N = 16'000'000;
+    const string path = "readings_async.txt";
+    writeReadingsFile(path, N);
+    const std::size_t bytes = static_cast<std::size_t>(std::ifstream{path, ios::binary | ios::ate}.tellg());
+    cout << N << " readings, " << bytes / 1'000'000 << " MB\n";
+
+    mk::AsyncReaderOptions uring, pool;
+    uring.backend = mk::AsyncBackend::Auto;
+    pool.backend = mk::AsyncBackend::ThreadPool;
+    cout << "io_uring: "
+         << (mk::AsyncFileReader{path, uring}.backend() == mk::AsyncBackend::IoUring ? "available"
+                                                                                     : "not available, thread pool")
+         << "\n";
+
+    std::size_t expectedLines = 0;
+    auto countLines = [&](const string &label, auto &&count) {
+        for (bool cold : {true, false})
+        {
+            if (cold)
+                evictFromPageCache(path);
+            mk::Stopwatch sw;
+            std::size_t lines = count();
+            printThroughput(label + (cold ? ", cold" : ", warm"), sw.elapsedMs(), bytes);
+            if (expectedLines == 0)
+                expectedLines = lines;
+            else if (lines != expectedLines)
+                cout << "    " << lines << " lines instead of " << expectedLines << "!\n";
+        }
+    };
+
+    countLines("ifstream getline", [&] {
+        std::size_t lines = 0;
+        std::ifstream in{path};
+        for (string line; getline(in, line);)
+            ++lines;
+        return lines;
+    });
+    countLines("MappedFile", [&] {
+        mk::MappedFile file{path};
+        std::string_view text = file.text();
+        return static_cast<std::size_t>(std::count(text.begin(), text.end(), '\n'));
+    });
+    for (const auto &options : {uring, pool})
+    {
+        mk::AsyncFileReader reader{path, options};
+        countLines(string{"AsyncFileReader, "} + mk::toString(reader.backend()), [&] {
+            std::size_t lines = 0;
+            reader.read([&](std::string_view block) { lines += std::count(block.begin(), block.end(), '\n'); });
+            return lines;
+        });
+    }
+    cout << "    " << expectedLines << " lines each\n";
+
+    evictFromPageCache(path);
+    mk::Stopwatch sw;
+    mk::ReadingFile mapped = mk::loadReadings(path);
+    printThroughput("loadReadings (mmap), cold", sw.elapsedMs(), bytes);
+    evictFromPageCache(path);
+    sw.restart();
+    mk::AsyncFileReader reader{path, uring};
+    mk::ReadingFile async = mk::readReadings(reader);
+    printThroughput(string{"readReadings ("} + mk::toString(reader.backend()) + "), cold", sw.elapsedMs(), bytes);
+    bool same = mapped.lines == async.lines && mapped.readings.size() == async.readings.size() &&
+                std::equal(mapped.readings.begin(), mapped.readings.end(), async.readings.begin(),
+                           [](const Reading &a, const Reading &b) {
+                               return a.hour == b.hour && a.temperature == b.temperature;
+                           });
+    cout << "    identical readings: " << std::boolalpha << same << std::noboolalpha << "\n";
+    std::remove(path.c_str());
+}
+
+// a server log: mostly INFO lines, an ERROR now and then
+static string logText(std::size_t lines)
+{
+    std::mt19937 gen{99};
+    std::uniform_int_distribution<int> level{0, 199}, user{1, 99999}, ms{1, 2000};
+    string text;
+    text.reserve(lines * 80);
+    char line[160];
+    for (std::size_t i = 0; i < lines; ++i)
+    {
+        const int l = level(gen);
+        const char *severity = l == 0 ? "ERROR" : l < 10 ? "WARN " : "INFO ";
+        const int n = std::snprintf(line, sizeof line,
+                                    "2024-03-%02zu %02zu:%02zu:%02zu %s request %zu user=%d took %d ms\n",
+                                    1 + i / 86400 % 28, i / 3600 % 24, i / 60 % 60, i % 60, severity, i, user(gen),
+                                    ms(gen));
+        text.append(line, static_cast<std::size_t>(n));
+    }
+    return text;
+}
+
+/*
+Counting lines, finding the lines with "ERROR", and jumping to a line near the end of a log file:
+    getline             reading line after line, the way readFile() does
+    findNewlines        16 bytes per step, on every hardware thread
+    LineIndex           the newline offsets, built once, then saved and mapped
+*/
+void lineIndexBenchmark()
+{
+    MK_PROFILE_FUNCTION();
+    printTitle("Line Index Benchmark");
+
+    const string path = "line_index_benchmark.log";
+    {
+        std::ofstream out{path, ios::binary};
+        out << logText(3'000'000);
+    }
+    std::remove((path + ".lines").c_str());
+    mk::MappedFile file{path};
+    const std::string_view text = file.text();
+    cout << text.size() / 1'000'000 << " MB, " << std::thread::hardware_concurrency() << " hardware threads\n";
+    // fault the mapping in first, so that the scans below only compare scanning
+    mk::doNotOptimize(std::count(text.begin(), text.end(), '\n'));
+
+    mk::Stopwatch sw;
+    std::size_t lines = 0;
+    {
+        std::ifstream in{path};
+        for (string line; getline(in, line);)
+            ++lines;
+    }
+    printThroughput("count lines: getline", sw.elapsedMs(), text.size());
+    sw.restart();
+    std::size_t counted = static_cast<std::size_t>(std::count(text.begin(), text.end(), '\n'));
+    printThroughput("count lines: std::count", sw.elapsedMs(), text.size());
+    for (unsigned threads : {1u, 0u})
+    {
+        sw.restart();
+        std::size_t found = mk::findNewlines(text, threads).size();
+        printThroughput(threads == 1 ? "findNewlines, 1 thread" : "findNewlines, all threads", sw.elapsedMs(),
+                        text.size());
+        if (found != lines || counted != lines)
+            cout << "    " << found << " / " << counted << " lines instead of " << lines << "!\n";
+    }
+
+    sw.restart();
+    std::vector<std::size_t> expected;
+    {
+        std::ifstream in{path};
+        std::size_t n = 0;
+        for (string line; getline(in, line);)
+            if (++n, line.find("ERROR") != string::npos)
+                expected.push_back(n);
+    }
+    printThroughput("grep ERROR: getline + find", sw.elapsedMs(), text.size());
+
+    sw.restart();
+    mk::IndexedTextFile log{path};
+    mk::printTiming("IndexedTextFile, building the index", sw.elapsedMs());
+    sw.restart();
+    mk::IndexedTextFile again{path};
+    mk::printTiming(again.indexLoaded() ? "IndexedTextFile, loading the index" : "IndexedTextFile, built again!",
+                    sw.elapsedMs());
+
+    sw.restart();
+    std::vector<mk::LineMatch> matches = log.find("ERROR");
+    printThroughput("grep ERROR: findLines", sw.elapsedMs(), text.size());
+    bool same = matches.size() == expected.size() &&
+                std::equal(matches.begin(), matches.end(), expected.begin(),
+                           [](const mk::LineMatch &m, std::size_t line) { return m.line == line; });
+    cout << "    " << matches.size() << " lines, the same: " << std::boolalpha << same << std::noboolalpha << "\n";
+    if (!matches.empty())
+        cout << "    line " << matches.front().line << ": " << log.line(matches.front().line) << "\n";
+
+    const std::size_t target = lines - 10;
+    sw.restart();
+    string skipped;
+    {
+        std::ifstream in{path};
+        for (std::size_t n = 0; n < target && getline(in, skipped);)
+            ++n;
+    }
+    mk::printTiming("line " + std::to_string(target) + ": getline", sw.elapsedMs());
+    sw.restart();
+    std::string_view jumped = again.line(target);
+    mk::doNotOptimize(jumped);
+    mk::printTiming("line " + std::to_string(target) + ": LineIndex", sw.elapsedMs());
+    cout << "    the same: " << std::boolalpha << (jumped == skipped) << std::noboolalpha << "\n";
+
+    std::remove(path.c_str());
+    std::remove((path + ".lines").c_str());
+}
+
+/*
+Timestamped lines, appended to a log:
+    open + ctime + close    what writeFile() does for every line
+    ofstream + ctime        the file kept open, ctime() for every line
+    LogWriter               the file kept open, the timestamp cached per second, a background thread writing
+*/
+void logWriterBenchmark()
+{
+    MK_PROFILE_FUNCTION();
+    printTitle("Log Writer Benchmark");
+
+    const string path = "log_writer_benchmark.txt";
+    const string message = "request served, user=12345 took 17 ms";
+    auto report = [&](const string &label, double ms, std::size_t lines) {
+        mk::printTiming(label, ms);
+        cout << "    " << nsPerReading(ms, lines) << " ns per line\n";
+    };
+
+    const std::size_t Slow = 20'000, N = 2'000'000;
+    mk::Stopwatch sw;
+    for (std::size_t i = 0; i < Slow; ++i)
+    {
+        std::ofstream ofstr{path, ios::out | ios::app};
+        auto timenow = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+        ofstr << std::strtok(ctime(&timenow), "\n") << ' ' << message << '\n';
+    }
+    report("open + ctime + close", sw.elapsedMs(), Slow);
+    std::remove(path.c_str());
+
+    sw.restart();
+    {
+        std::ofstream ofstr{path, ios::out | ios::app};
+        for (std::size_t i = 0; i < N / 10; ++i)
+        {
+            auto timenow = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+            ofstr << std::strtok(ctime(&timenow), "\n") << ' ' << message << '\n';
+        }
+    }
+    report("ofstream + ctime", sw.elapsedMs(), N / 10);
+    std::string ctimeLine;
+    std::getline(std::ifstream{path}, ctimeLine);
+    std::remove(path.c_str());
+
+    for (unsigned digits : {0u, 6u})
+    {
+        mk::LogWriterOptions options;
+        options.subsecondDigits = digits;
+        sw.restart();
+        mk::LogWriterStats stats;
+        {
+            mk::LogWriter log{path, options};
+            for (std::size_t i = 0; i < N; ++i)
+                log.write(message);
+            log.flush();
+            stats = log.stats();
+        }
+        report(digits ? "LogWriter, microseconds" : "LogWriter", sw.elapsedMs(), N);
+        std::string line;
+        std::getline(std::ifstream{path}, line);
+        cout << "    " << stats.writes << " write() calls; \"" << line << "\"\n";
+        if (digits == 0 && line.size() != ctimeLine.size())
+            cout << "    not the length of ctime()'s \"" << ctimeLine << "\"!\n";
+        std::remove(path.c_str());
+    }
+
+    const unsigned threads = 4;
+    sw.restart();
+    {
+        mk::LogWriter log{path};
+        std::vector<std::thread> writers;
+        for (unsigned t = 0; t < threads; ++t)
+            writers.emplace_back([&] {
+                for (std::size_t i = 0; i < N / threads; ++i)
+                    log.write(message);
+            });
+        for (auto &w : writers)
+            w.join();
+        log.flush();
+    }
+    report("LogWriter, 4 threads", sw.elapsedMs(), N);
+    std::remove(path.c_str());
+
+    // rotation: 10 MB files, the last 3 kept
+    mk::LogWriterOptions rotating;
+    rotating.maxFileBytes = 10'000'000;
+    rotating.keepFiles = 3;
+    {
+        mk::LogWriter log{path, rotating};
+        for (std::size_t i = 0; i < N; ++i)
+            log.write(message);
+        log.flush();
+        cout << "rotated " << log.stats().rotations << " times:";
+    }
+    for (const string &file : {path, path + ".1", path + ".2", path + ".3", path + ".4"})
+    {
+        std::ifstream in{file, ios::binary | ios::ate};
+        if (in)
+            cout << " " << file << " " << in.tellg() / 1'000'000 << " MB";
+        std::remove(file.c_str());
+    }
+    cout << "\n";
+}
+
+/*
+A log of ctime() lines, a reading every 3 seconds for a month, parsed three ways:
+    std::get_time       through an istringstream, with the format "%a %b %d %H:%M:%S %Y"
+    strptime            the C library's parser, with the same format
+    parseCtime          the fixed layout checked 16 bytes at a time, names by perfect hash
+and then the lines of one hour found with a CtimeIndex, against parsing every line.
+The timestamps are written in UTC (asctime of gmtime), so that timegm() gives the seconds parseCtime() gives.
+*/
+void ctimeParserBenchmark()
+{
+    MK_PROFILE_FUNCTION();
+    printTitle("Ctime Parser Benchmark");
+
+    const std::size_t N = 1'000'000;
+    const std::time_t start = 1'700'000'000;
+    string text;
+    text.reserve(N * 40);
+    std::vector<std::size_t> offsets;
+    offsets.reserve(N);
+    for (std::size_t i = 0; i < N; ++i)
+    {
+        std::time_t t = start + static_cast<std::time_t>(3 * i);
+        std::tm utc{};
+        char line[32];
+        gmtime_r(&t, &utc);
+        asctime_r(&utc, line); // "Www Mmm dd hh:mm:ss yyyy\n"
+        offsets.push_back(text.size());
+        text.append(line, 24);
+        text += i % 50 == 0 ? " ERROR disk full\n" : " ok\n";
+    }
+    auto timestamp = [&](std::size_t i) { return std::string_view{text}.substr(offsets[i], 24); };
+    auto report = [&](const string &label, double ms, std::int64_t sum) {
+        mk::printTiming(label, ms);
+        cout << "    " << nsPerReading(ms, N) << " ns per timestamp, checksum " << sum << "\n";
+    };
+
+    mk::Stopwatch sw;
+    std::int64_t sum = 0;
+    {
+        std::istringstream in;
+        for (std::size_t i = 0; i < N; ++i)
+        {
+            in.clear();
+            in.str(string{timestamp(i)});
+            std::tm tm{};
+            in >> std::get_time(&tm, "%a %b %d %H:%M:%S %Y");
+            sum += in ? timegm(&tm) : 0;
+        }
+    }
+    report("std::get_time + timegm", sw.elapsedMs(), sum);
+
+    sw.restart();
+    sum = 0;
+    for (std::size_t i = 0; i < N; ++i)
+    {
+        std::tm tm{};
+        sum += strptime(text.c_str() + offsets[i], "%a %b %d %H:%M:%S %Y", &tm) ? timegm(&tm) : 0;
+    }
+    report("strptime + timegm", sw.elapsedMs(), sum);
+
+    sw.restart();
+    sum = 0;
+    for (std::size_t i = 0; i < N; ++i)
+        if (auto t = mk::parseCtime(timestamp(i)))
+            sum += t->time_since_epoch().count();
+    report("parseCtime", sw.elapsedMs(), sum);
+
+    // the lines of one hour, a week in
+    using namespace std::chrono;
+    const sys_seconds from = sys_seconds{seconds{start}} + days{7};
+    const sys_seconds to = from + hours{1};
+
+    sw.restart();
+    std::size_t scanned = 0, scannedErrors = 0;
+    for (std::size_t at = 0; at < text.size();)
+    {
+        std::size_t end = text.find('\n', at) + 1;
+        auto t = mk::parseCtime(std::string_view{text}.substr(at, end - at));
+        if (t && *t >= from && *t < to)
+        {
+            ++scanned;
+            scannedErrors += text.compare(at + 25, 5, "ERROR") == 0;
+        }
+        at = end;
+    }
+    mk::printTiming("one hour: parse every line", sw.elapsedMs());
+
+    sw.restart();
+    mk::CtimeIndex index = mk::CtimeIndex::build(text);
+    mk::printTiming("CtimeIndex::build", sw.elapsedMs());
+    sw.restart();
+    auto [begin, end] = index.byteRange(from, to);
+    const std::string_view hour = std::string_view{text}.substr(begin, end - begin);
+    std::size_t found = index.between(from, to).size();
+    mk::printTiming("one hour: CtimeIndex", sw.elapsedMs());
+    std::size_t errors = 0;
+    for (std::size_t at = hour.find("ERROR"); at != std::string_view::npos; at = hour.find("ERROR", at + 1))
+        ++errors;
+    cout << "    " << found << " lines (" << scanned << " by parsing), " << errors << " errors (" << scannedErrors
+         << "), from \"" << hour.substr(0, 24) << "\"\n";
+}
+
+// words of 1 to 12 letters, separated by blanks, some punctuation and newlines
+static string wordsText(std::size_t bytes)
+{
+    std::mt19937 gen{47};
+    std::uniform_int_distribution<int> length{1, 12}, letter{'a', 'z'}, gap{0, 19};
+    string text;
+    text.reserve(bytes + 16);
+    while (text.size() < bytes)
+    {
+        for (int n = length(gen); n > 0; --n)
+            text += static_cast<char>(letter(gen));
+        const int g = gap(gen);
+        text += g == 0 ? "\n" : g == 1 ? ", " : g == 2 ? ".  " : " ";
+    }
+    return text;
+}
+
+/*
+The words of 64 MB of text:
+    istringstream >> string     what words_of_sentence() does: a string per word
+    tokens()                    string_views, one at a time, 32 bytes classified per step
+    tokenize()                  the same into a batch of 1024
+    tokens(",. \n")             a delimiter set of our own
+With -DMK_ALLOC_PROFILER, the allocations of each are counted as well.
+*/
+void tokenizerBenchmark()
+{
+    MK_PROFILE_FUNCTION();
+    printTitle("Tokenizer Benchmark");
+
+    const string text = wordsText(64'000'000);
+    auto report = [&](const string &label, double ms, std::size_t words, std::size_t letters,
+                      std::uint64_t allocations) {
+        printThroughput(label, ms, text.size());
+        cout << "    " << words << " words, " << letters << " letters";
+        if (mk::allocProfilerEnabled())
+            cout << ", " << allocations << " allocations";
+        cout << "\n";
+    };
+
+    std::uint64_t before = mk::allocTotals().allocations;
+    mk::Stopwatch sw;
+    std::size_t words = 0, letters = 0;
+    {
+        std::vector<string> strings;
+        std::istringstream ss{text};
+        for (string word; ss >> word;)
+            strings.push_back(word);
+        words = strings.size();
+        for (const auto &w : strings)
+            letters += w.size();
+    }
+    report("istringstream >> string", sw.elapsedMs(), words, letters, mk::allocTotals().allocations - before);
+
+    for (int run = 0; run < 2; ++run)
+    {
+        before = mk::allocTotals().allocations;
+        sw.restart();
+        words = letters = 0;
+        for (std::string_view word : mk::tokens(text))
+        {
+            ++words;
+            letters += word.size();
+        }
+        report(run == 0 ? "tokens()" : "tokens(), again", sw.elapsedMs(), words, letters,
+               mk::allocTotals().allocations - before);
+    }
+
+    before = mk::allocTotals().allocations;
+    sw.restart();
+    words = letters = 0;
+    {
+        std::array<std::string_view, 1024> batch;
+        std::string_view rest = text;
+        for (std::size_t n; (n = mk::tokenize(rest, batch)) > 0;)
+        {
+            words += n;
+            for (std::size_t i = 0; i < n; ++i)
+                letters += batch[i].size();
+        }
+    }
+    report("tokenize(), batches of 1024", sw.elapsedMs(), words, letters, mk::allocTotals().allocations - before);
+
+    const mk::Delimiters punctuation{",. \n"};
+    sw.restart();
+    words = letters = 0;
+    for (std::string_view word : mk::tokens(text, punctuation))
+    {
+        ++words;
+        letters += word.size();
+    }
+    report("tokens(\",. \\n\")", sw.elapsedMs(), words, letters, 0);
+}
+
+// words of a vocabulary, drawn with Zipf's law (the k-th most frequent word about 1/k as often as the first), as in
+// natural language
+static string corpusText(std::size_t bytes, std::size_t vocabulary)
+{
+    std::mt19937 gen{48};
+    std::uniform_int_distribution<int> length{1, 12}, letter{'a', 'z'}, gap{0, 9};
+    std::vector<string> words(vocabulary);
+    std::vector<double> weights(vocabulary);
+    for (std::size_t k = 0; k < vocabulary; ++k)
+    {
+        for (int n = length(gen); n > 0; --n)
+            words[k] += static_cast<char>(letter(gen));
+        weights[k] = 1.0 / static_cast<double>(k + 1);
+    }
+    std::discrete_distribution<std::size_t> rank{weights.begin(), weights.end()};
+
+    string text;
+    text.reserve(bytes + 16);
+    while (text.size() < bytes)
+    {
+        text += words[rank(gen)];
+        text += gap(gen) == 0 ? '\n' : ' ';
+    }
+    return text;
+}
+
+/*
+The word counts of 64 MB of text, with a vocabulary of 100000 words:
+    std::map, >>                mapBasics()'s map<string, size_t>, filled from an istringstream
+    std::map, tokens()          the same map, with the tokenizer's string_views (a string per lookup still)
+    std::unordered_map          string_view keys: a node per word, a hash and a pointer chase per lookup
+    countWords()                flat tables of string_views, on one thread, then on all of them
+The top words of all of them must be the same.
+*/
+void wordCountBenchmark()
+{
+    MK_PROFILE_FUNCTION();
+    printTitle("Word Count Benchmark");
+
+    const string text = corpusText(64'000'000, 100'000);
+    cout << text.size() / 1'000'000 << " MB, " << std::thread::hardware_concurrency() << " hardware threads\n";
+
+    std::vector<std::pair<string, std::size_t>> expected;
+    auto topOf = [](const auto &counts) {
+        std::vector<std::pair<string, std::size_t>> top(counts.begin(), counts.end());
+        std::partial_sort(top.begin(), top.begin() + 5, top.end(), [](const auto &a, const auto &b) {
+            return a.second != b.second ? a.second > b.second : a.first < b.first;
+        });
+        top.resize(5);
+        return top;
+    };
+
+    mk::Stopwatch sw;
+    {
+        std::map<string, std::size_t> counts;
+        std::istringstream ss{text};
+        for (string word; ss >> word;)
+            ++counts[word];
+        printThroughput("std::map, >>", sw.elapsedMs(), text.size());
+        expected = topOf(counts);
+    }
+
+    // the fastest of 3 runs, here and for countWords(): a run slowed down by something else does not make the ratio
+    double mapMs = 1e300;
+    std::size_t distinct = 0;
+    for (int run = 0; run < 3; ++run)
+    {
+        sw.restart();
+        std::map<string, std::size_t> counts;
+        for (std::string_view word : mk::tokens(text))
+            ++counts[string{word}];
+        mapMs = std::min(mapMs, sw.elapsedMs());
+        distinct = counts.size();
+    }
+    printThroughput("std::map, tokens()", mapMs, text.size());
+    cout << "    " << distinct << " distinct words\n";
+
+    sw.restart();
+    {
+        std::unordered_map<std::string_view, std::size_t> counts;
+        for (std::string_view word : mk::tokens(text))
+            ++counts[word];
+        printThroughput("std::unordered_map, tokens()", sw.elapsedMs(), text.size());
+        cout << "    the same top 5: " << std::boolalpha << (topOf(counts) == expected) << std::noboolalpha << "\n";
+    }
+
+    for (unsigned threads : {1u, 0u})
+    {
+        double ms = 1e300;
+        std::vector<mk::WordCount> top;
+        for (int run = 0; run < 3; ++run)
+        {
+            sw.restart();
+            mk::WordFrequencies counts = mk::countWords(text, threads);
+            top = counts.top(5);
+            ms = std::min(ms, sw.elapsedMs());
+        }
+        printThroughput(threads == 1 ? "countWords, 1 thread" : "countWords, all threads", ms, text.size());
+        bool same = top.size() == expected.size() &&
+                    std::equal(top.begin(), top.end(), expected.begin(), [](const mk::WordCount &w, const auto &e) {
+                        return w.word == e.first && w.count == e.second;
+                    });
+        cout << "    " << mapMs / ms << "x std::map, the same top 5: " << std::boolalpha << same << std::noboolalpha
+             << "\n";
+    }
+
+    cout << "top 5:";
+    for (const auto &[word, count] : expected)
+        cout << " " << word << " (" << count << ")";
+    cout << "\n";
+}
+
+/*
+The same 64 MB of words, counted in fixed memory:
+    SpaceSaving             1000 counters: the top words, each count with its error
+    CountMinSketch          epsilon 0.0001, delta 0.001: an estimate for any word
+    4 parts, merged         each sketch on a quarter of the text, serialized, sent, deserialized and merged - as the
+                            threads, or machines, of a stream would
+against the exact counts of countWords(). The true count is between count - error and count; the Count-Min estimates
+are never too low, and too high by at most the error bound, but for about delta of them.
+*/
+void heavyHittersBenchmark()
+{
+    MK_PROFILE_FUNCTION();
+    printTitle("Heavy Hitters Benchmark");
+
+    const string text = corpusText(64'000'000, 100'000);
+    const mk::WordFrequencies exact = mk::countWords(text);
+    cout << exact.total() << " words, " << exact.distinct() << " different ones\n";
+
+    mk::Stopwatch sw;
+    mk::SpaceSaving top{1000};
+    for (std::string_view word : mk::tokens(text))
+        top.add(word);
+    printThroughput("SpaceSaving, 1000 counters", sw.elapsedMs(), text.size());
+
+    sw.restart();
+    mk::CountMinSketch sketch = mk::CountMinSketch::withError(0.0001, 0.001);
+    for (std::string_view word : mk::tokens(text))
+        sketch.add(word);
+    printThroughput("CountMinSketch, conservative update", sw.elapsedMs(), text.size());
+
+    // four parts, cut after a blank
+    sw.restart();
+    std::vector<std::vector<std::uint8_t>> sentTop, sentSketch;
+    std::size_t sentBytes = 0;
+    for (std::size_t part = 0, begin = 0; part < 4; ++part)
+    {
+        const std::size_t end = part == 3 ? text.size() : text.find(' ', text.size() * (part + 1) / 4) + 1;
+        mk::SpaceSaving partTop{1000};
+        mk::CountMinSketch partSketch = mk::CountMinSketch::withError(0.0001, 0.001);
+        for (std::string_view word : mk::tokens(std::string_view{text}.substr(begin, end - begin)))
+        {
+            partTop.add(word);
+            partSketch.add(word);
+        }
+        sentTop.push_back(partTop.serialize());
+        sentSketch.push_back(partSketch.serialize());
+        sentBytes += sentTop.back().size() + sentSketch.back().size();
+        begin = end;
+    }
+    auto received = [](const std::vector<std::uint8_t> &bytes) {
+        return std::string_view{reinterpret_cast<const char *>(bytes.data()), bytes.size()};
+    };
+    mk::SpaceSaving mergedTop = mk::SpaceSaving::deserialize(received(sentTop[0]));
+    mk::CountMinSketch mergedSketch = mk::CountMinSketch::deserialize(received(sentSketch[0]));
+    for (std::size_t part = 1; part < 4; ++part)
+    {
+        mergedTop.merge(mk::SpaceSaving::deserialize(received(sentTop[part])));
+        mergedSketch.merge(mk::CountMinSketch::deserialize(received(sentSketch[part])));
+    }
+    printThroughput("4 parts: both, serialize, merge", sw.elapsedMs(), text.size());
+
+    cout << "memory: exact tables about " << exact.distinct() * 64 / 1000 << " KB and the text; CountMinSketch "
+         << sketch.bytes() / 1000 << " KB; sent: " << sentBytes / 1000 << " KB for 4 parts\n";
+    cout << "SpaceSaving: every count at most " << top.maxError() << " too high (total / 1000 = " << top.total() / 1000
+         << "); merged: " << mergedTop.maxError() << "\n";
+    cout << "CountMinSketch: at most " << sketch.errorBound() << " too high, with probability " << 1 - sketch.delta()
+         << "; merged: " << mergedSketch.errorBound() << "\n\n";
+
+    cout << std::left << std::setw(14) << "word" << std::right << std::setw(10) << "exact" << std::setw(20)
+         << "SpaceSaving (error)" << std::setw(20) << "merged (error)" << std::setw(12) << "Count-Min" << std::setw(12) << "merged"
+         << "\n";
+    const std::vector<mk::HeavyHitter> mergedList = mergedTop.top(1000);
+    for (const mk::HeavyHitter &h : top.top(10))
+    {
+        auto other = std::find_if(mergedList.begin(), mergedList.end(),
+                                  [&](const mk::HeavyHitter &m) { return m.word == h.word; });
+        auto withError = [](std::uint64_t count, std::uint64_t error) {
+            return std::to_string(count) + " (" + std::to_string(error) + ")";
+        };
+        cout << std::left << std::setw(14) << h.word << std::right << std::setw(10) << exact.count(h.word)
+             << std::setw(20) << withError(h.count, h.error) << std::setw(20)
+             << (other == mergedList.end() ? string{"-"} : withError(other->count, other->error)) << std::setw(12)
+             << sketch.estimate(h.word) << std::setw(12) << mergedSketch.estimate(h.word) << "\n";
+    }
+
+    // the rare words are where the Count-Min error shows
+    std::size_t checked = 0, tooHigh = 0, beyondBound = 0;
+    for (std::string_view word : mk::tokens(std::string_view{text}.substr(0, 1'000'000)))
+    {
+        const std::uint64_t estimate = sketch.estimate(word), count = exact.count(word);
+        ++checked;
+        tooHigh += estimate > count;
+        beyondBound += estimate > count + sketch.errorBound();
+    }
+    cout << "\nCount-Min, the words of the first MB: " << checked << " estimates, " << tooHigh << " too high, "
+         << beyondBound << " beyond the bound\n";
 }
@@ -0,0 +1,326 @@
+/* lifetime_probe.h */
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+/*
+mk::X (domain.h) prints a line for every construction, copy and destruction: good for reading, useless for checking.
+LifetimeProbe<T> wraps a T and counts the same events instead, in atomic counters (so probes may live in several
+threads), and a ProbeScope takes the difference of the counters around a piece of code:
+
+    auto s = mk::probe_scope<std::string>();
+    std::vector<mk::LifetimeProbe<std::string>> v;
+    for (int i = 0; i < 100; ++i)
+        v.emplace_back("some text");
+    assert(s.counts().copies() == 0); // vector growth moved the elements
+    s.report();
+
+probe_scope<T>() counts the events of LifetimeProbe<T> only; probe_scope() counts the events of all probes.
+
+Heap bytes are the bytes of probes allocated one by one with new (make_unique, ...), and the bytes that containers
+allocate through a ProbeAllocator.
+
+Compiling with -DMK_NO_LIFETIME_PROBE turns the counting off: LifetimeProbe<T> is then a plain struct around a T with
+defaulted special member functions (as cheap as the T itself), and every scope reports zeros. The second template
+parameter overrides the flag for one probe type: LifetimeProbe<T, false> never counts, LifetimeProbe<T, true> always
+does.
+*/
+namespace mk
+{
+
+#ifdef MK_NO_LIFETIME_PROBE
+inline constexpr bool lifetimeProbeEnabled = false;
+#else
+inline constexpr bool lifetimeProbeEnabled = true;
+#endif
+
+// a snapshot of the counters (or the difference of two snapshots)
+struct ProbeCounts
+{
+    long long defaultConstructions = 0;
+    long long valueConstructions = 0; // from constructor arguments
+    long long copyConstructions = 0;
+    long long moveConstructions = 0;
+    long long copyAssignments = 0;
+    long long moveAssignments = 0;
+    long long destructions = 0;
+    long long heapBytesAllocated = 0;
+    long long heapBytesFreed = 0;
+
+    long long constructions() const
+    {
+        return defaultConstructions + valueConstructions + copyConstructions + moveConstructions;
+    }
+
+    long long copies() const
+    {
+        return copyConstructions + copyAssignments;
+    }
+
+    long long moves() const
+    {
+        return moveConstructions + moveAssignments;
+    }
+
+    // objects constructed but not yet destroyed
+    long long live() const
+    {
+        return constructions() - destructions;
+    }
+
+    friend ProbeCounts operator-(const ProbeCounts &lhs, const ProbeCounts &rhs)
+    {
+        return {lhs.defaultConstructions - rhs.defaultConstructions,
+                lhs.valueConstructions - rhs.valueConstructions,
+                lhs.copyConstructions - rhs.copyConstructions,
+                lhs.moveConstructions - rhs.moveConstructions,
+                lhs.copyAssignments - rhs.copyAssignments,
+                lhs.moveAssignments - rhs.moveAssignments,
+                lhs.destructions - rhs.destructions,
+                lhs.heapBytesAllocated - rhs.heapBytesAllocated,
+                lhs.heapBytesFreed - rhs.heapBytesFreed};
+    }
+};
+
+inline std::ostream &operator<<(std::ostream &os, const ProbeCounts &c)
+{
+    return os << "{default:" << c.defaultConstructions << ", value:" << c.valueConstructions
+              << ", copy:" << c.copyConstructions << ", move:" << c.moveConstructions
+              << ", copy=:" << c.copyAssignments << ", move=:" << c.moveAssignments << ", destroy:" << c.destructions
+              << ", heap bytes:" << c.heapBytesAllocated << "/-" << c.heapBytesFreed << "}";
+}
+
+namespace detail
+{
+
+struct ProbeCounters
+{
+    std::atomic<long long> defaultConstructions{0};
+    std::atomic<long long> valueConstructions{0};
+    std::atomic<long long> copyConstructions{0};
+    std::atomic<long long> moveConstructions{0};
+    std::atomic<long long> copyAssignments{0};
+    std::atomic<long long> moveAssignments{0};
+    std::atomic<long long> destructions{0};
+    std::atomic<long long> heapBytesAllocated{0};
+    std::atomic<long long> heapBytesFreed{0};
+
+    ProbeCounts load() const
+    {
+        auto get = [](const std::atomic<long long> &a) { return a.load(std::memory_order_relaxed); };
+        return {get(defaultConstructions), get(valueConstructions), get(copyConstructions),
+                get(moveConstructions),    get(copyAssignments),    get(moveAssignments),
+                get(destructions),         get(heapBytesAllocated), get(heapBytesFreed)};
+    }
+};
+
+// one set of counters per probed type T, and one for all probes (T = void)
+template <typename T> ProbeCounters &countersFor()
+{
+    static ProbeCounters counters;
+    return counters;
+}
+
+// Count an event for T, and for all probes (once, if T is void). The counters are only statistics: relaxed ordering is
+// enough.
+template <typename T, bool Enabled = lifetimeProbeEnabled>
+void record(std::atomic<long long> ProbeCounters::*counter, long long n = 1)
+{
+    if constexpr (Enabled)
+    {
+        if constexpr (!std::is_void_v<T>)
+            (countersFor<T>().*counter).fetch_add(n, std::memory_order_relaxed);
+        (countersFor<void>().*counter).fetch_add(n, std::memory_order_relaxed);
+    }
+}
+
+} // namespace detail
+
+template <typename T, bool Enabled = lifetimeProbeEnabled> class LifetimeProbe
+{
+    using Counters = detail::ProbeCounters;
+
+  public:
+    T value;
+
+    LifetimeProbe() : value()
+    {
+        detail::record<T, Enabled>(&Counters::defaultConstructions);
+    }
+
+    // construct the T from any arguments (but not from another probe: that is a copy or a move)
+    template <typename... Args>
+        requires(sizeof...(Args) > 0 && std::is_constructible_v<T, Args...> &&
+                 !(sizeof...(Args) == 1 && (std::is_same_v<std::remove_cvref_t<Args>, LifetimeProbe> && ...)))
+    LifetimeProbe(Args &&...args) : value(std::forward<Args>(args)...)
+    {
+        detail::record<T, Enabled>(&Counters::valueConstructions);
+    }
+
+    LifetimeProbe(const LifetimeProbe &other) : value(other.value)
+    {
+        detail::record<T, Enabled>(&Counters::copyConstructions);
+    }
+
+    // noexcept whenever T's move is: otherwise vector would copy on growth, which is what we want to catch.
+    LifetimeProbe(LifetimeProbe &&other) noexcept(std::is_nothrow_move_constructible_v<T>)
+        : value(std::move(other.value))
+    {
+        detail::record<T, Enabled>(&Counters::moveConstructions);
+    }
+
+    LifetimeProbe &operator=(const LifetimeProbe &other)
+    {
+        value = other.value;
+        detail::record<T, Enabled>(&Counters::copyAssignments);
+        return *this;
+    }
+
+    LifetimeProbe &operator=(LifetimeProbe &&other) noexcept(std::is_nothrow_move_assignable_v<T>)
+    {
+        value = std::move(other.value);
+        detail::record<T, Enabled>(&Counters::moveAssignments);
+        return *this;
+    }
+
+    ~LifetimeProbe()
+    {
+        detail::record<T, Enabled>(&Counters::destructions);
+    }
+
+    // class-specific allocation functions: new LifetimeProbe<T> (and make_unique) end up here.
+    static void *operator new(std::size_t size)
+    {
+        detail::record<T, Enabled>(&Counters::heapBytesAllocated, size);
+        return ::operator new(size);
+    }
+
+    static void operator delete(void *p, std::size_t size)
+    {
+        detail::record<T, Enabled>(&Counters::heapBytesFreed, size);
+        ::operator delete(p);
+    }
+
+    static void *operator new[](std::size_t size)
+    {
+        detail::record<T, Enabled>(&Counters::heapBytesAllocated, size);
+        return ::operator new[](size);
+    }
+
+    static void operator delete[](void *p, std::size_t size)
+    {
+        detail::record<T, Enabled>(&Counters::heapBytesFreed, size);
+        ::operator delete[](p);
+    }
+
+    T &operator*()
+    {
+        return value;
+    }
+    const T &operator*() const
+    {
+        return value;
+    }
+    T *operator->()
+    {
+        return &value;
+    }
+    const T *operator->() const
+    {
+        return &value;
+    }
+};
+
+// Disabled: the same interface, nothing counted, every special member function is the one of T.
+template <typename T> class LifetimeProbe<T, false>
+{
+  public:
+    T value{};
+
+    LifetimeProbe() = default;
+
+    template <typename... Args>
+        requires(sizeof...(Args) > 0 && std::is_constructible_v<T, Args...> &&
+                 !(sizeof...(Args) == 1 && (std::is_same_v<std::remove_cvref_t<Args>, LifetimeProbe> && ...)))
+    LifetimeProbe(Args &&...args) : value(std::forward<Args>(args)...)
+    {
+    }
+
+    T &operator*()
+    {
+        return value;
+    }
+    const T &operator*() const
+    {
+        return value;
+    }
+    T *operator->()
+    {
+        return &value;
+    }
+    const T *operator->() const
+    {
+        return &value;
+    }
+};
+
+// A std::allocator that adds the bytes of the container's buffers to the heap bytes of all probes.
+template <typename U> struct ProbeAllocator
+{
+    using value_type = U;
+
+    ProbeAllocator() = default;
+    template <typename V> ProbeAllocator(const ProbeAllocator<V> &)
+    {
+    }
+
+    U *allocate(std::size_t n)
+    {
+        detail::record<void>(&detail::ProbeCounters::heapBytesAllocated, n * sizeof(U));
+        return std::allocator<U>{}.allocate(n);
+    }
+
+    void deallocate(U *p, std::size_t n)
+    {
+        detail::record<void>(&detail::ProbeCounters::heapBytesFreed, n * sizeof(U));
+        std::allocator<U>{}.deallocate(p, n);
+    }
+
+    friend bool operator==(const ProbeAllocator &, const ProbeAllocator &)
+    {
+        return true;
+    }
+};
+
+// Remembers the counters at its construction; counts() is what happened since.
+template <typename T = void> class ProbeScope
+{
+    ProbeCounts start = detail::countersFor<T>().load();
+
+  public:
+    ProbeCounts counts() const
+    {
+        return detail::countersFor<T>().load() - start;
+    }
+
+    void report(const std::string &label = "probe scope", std::ostream &os = std::cout) const
+    {
+        if constexpr (lifetimeProbeEnabled)
+            os << label << ": " << counts() << "\n";
+        else
+            os << label << ": (lifetime probes disabled)\n";
+    }
+};
+
+template <typename T = void> ProbeScope<T> probe_scope()
+{
+    return ProbeScope<T>{};
+}
+
+} // namespace mk
@@ -0,0 +1,341 @@
+/* line_index.cpp */
+#include "line_index.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#include <sys/stat.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace mk
+{
+
+namespace
+{
+
+struct LineIndexHeader
+{
+    char magic[8]; // "MKLINES1"
+    std::uint64_t textSize;
+    std::int64_t modified;
+    std::uint64_t newlineCount;
+};
+static_assert(sizeof(LineIndexHeader) == 32);
+
+constexpr char Magic[8] = {'M', 'K', 'L', 'I', 'N', 'E', 'S', '1'};
+
+std::size_t chunkCount(std::string_view text)
+{
+    return (text.size() + LineScanChunkSize - 1) / LineScanChunkSize;
+}
+
+// work(c) for every chunk c, by threads threads that take the next chunk from a shared counter
+template <typename Work> void forEachChunk(std::size_t chunks, unsigned threads, Work work)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<std::size_t>(threads, chunks));
+
+    std::atomic<std::size_t> nextChunk{0};
+    auto run = [&] {
+        for (std::size_t c; (c = nextChunk.fetch_add(1, std::memory_order_relaxed)) < chunks;)
+            work(c);
+    };
+    if (threads <= 1)
+        run();
+    else
+    {
+        std::vector<std::thread> workers;
+        workers.reserve(threads);
+        for (unsigned t = 0; t < threads; ++t)
+            workers.emplace_back(run);
+        for (auto &w : workers)
+            w.join();
+    }
+}
+
+// appends the offsets of the newlines in text[begin, end)
+void scanNewlines(std::string_view text, std::size_t begin, std::size_t end, std::vector<std::uint64_t> &out)
+{
+    const char *p = text.data();
+    std::size_t i = begin;
+#ifdef __SSE2__
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; i + 16 <= end; i += 16)
+    {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+        for (unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline))); mask;
+             mask &= mask - 1)
+            out.push_back(i + static_cast<unsigned>(__builtin_ctz(mask)));
+    }
+#endif
+    while (i < end)
+    {
+        const void *found = std::memchr(p + i, '\n', end - i);
+        if (!found)
+            break;
+        i = static_cast<std::size_t>(static_cast<const char *>(found) - p);
+        out.push_back(i++);
+    }
+}
+
+// calls onMatch(pos) for the first match of needle that starts in text[begin, end), and, after each, for the first one
+// after the end of its line
+template <typename OnMatch>
+void scanMatches(std::string_view text, std::size_t begin, std::size_t end, std::string_view needle, OnMatch onMatch)
+{
+    const char *p = text.data();
+    const std::size_t k = needle.size();
+    if (k > text.size())
+        return;
+    end = std::min(end, text.size() - k + 1); // where a match can start
+
+    // the position after the end of the line pos is in
+    auto nextLine = [&](std::size_t pos) {
+        const void *newline = std::memchr(p + pos, '\n', text.size() - pos);
+        return newline ? static_cast<std::size_t>(static_cast<const char *>(newline) - p) + 1 : text.size();
+    };
+    auto rest = [&](std::size_t pos) { return std::memcmp(p + pos + 1, needle.data() + 1, k - 1) == 0; };
+
+    std::size_t i = begin;
+#ifdef __SSE2__
+    // candidates: the first byte and the last byte of needle where they belong
+    const __m128i first = _mm_set1_epi8(needle.front());
+    const __m128i last = _mm_set1_epi8(needle.back());
+    while (i + 16 <= end)
+    {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i + k - 1));
+        const __m128i candidates = _mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(candidates));
+        std::size_t next = i + 16;
+        for (; mask; mask &= mask - 1)
+        {
+            const std::size_t pos = i + static_cast<unsigned>(__builtin_ctz(mask));
+            if (rest(pos))
+            {
+                onMatch(pos);
+                next = nextLine(pos);
+                break;
+            }
+        }
+        i = next;
+    }
+#endif
+    while (i < end)
+    {
+        const void *found = std::memchr(p + i, needle.front(), end - i);
+        if (!found)
+            return;
+        const std::size_t pos = static_cast<std::size_t>(static_cast<const char *>(found) - p);
+        if (rest(pos))
+        {
+            onMatch(pos);
+            i = nextLine(pos);
+        }
+        else
+            i = pos + 1;
+    }
+}
+
+bool stampOf(const std::string &path, LineIndex::Stamp &stamp)
+{
+    struct stat st{};
+    if (::stat(path.c_str(), &st) != 0)
+        return false;
+    stamp.size = static_cast<std::uint64_t>(st.st_size);
+    stamp.modified = static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1'000'000'000 + st.st_mtim.tv_nsec;
+    return true;
+}
+
+} // namespace
+
+std::vector<std::uint64_t> findNewlines(std::string_view text, unsigned threads)
+{
+    const std::size_t chunks = chunkCount(text);
+    std::vector<std::vector<std::uint64_t>> perChunk(chunks);
+    forEachChunk(chunks, threads, [&](std::size_t c) {
+        const std::size_t begin = c * LineScanChunkSize;
+        scanNewlines(text, begin, std::min(text.size(), begin + LineScanChunkSize), perChunk[c]);
+    });
+
+    // the chunks' newlines, one after the other; copied in parallel too, each chunk to where it belongs
+    std::vector<std::size_t> start(chunks + 1, 0);
+    for (std::size_t c = 0; c < chunks; ++c)
+        start[c + 1] = start[c] + perChunk[c].size();
+    std::vector<std::uint64_t> newlines(start[chunks]);
+    forEachChunk(chunks, threads, [&](std::size_t c) {
+        std::copy(perChunk[c].begin(), perChunk[c].end(), newlines.begin() + static_cast<std::ptrdiff_t>(start[c]));
+        perChunk[c] = {};
+    });
+    return newlines;
+}
+
+LineIndex::LineIndex(LineIndex &&other) noexcept
+    : built{std::move(other.built)}, saved{std::move(other.saved)}, textSize{other.textSize}, present{other.present}
+{
+    bind();
+    other.bind();
+}
+
+LineIndex &LineIndex::operator=(LineIndex &&other) noexcept
+{
+    built = std::move(other.built);
+    saved = std::move(other.saved);
+    textSize = other.textSize;
+    present = other.present;
+    bind();
+    other.bind();
+    return *this;
+}
+
+void LineIndex::bind()
+{
+    if (saved.size() > sizeof(LineIndexHeader))
+        newlines = {reinterpret_cast<const std::uint64_t *>(saved.data() + sizeof(LineIndexHeader)),
+                    (saved.size() - sizeof(LineIndexHeader)) / sizeof(std::uint64_t)};
+    else
+        newlines = built;
+}
+
+LineIndex LineIndex::build(std::string_view text, unsigned threads)
+{
+    LineIndex index;
+    index.built = findNewlines(text, threads);
+    index.textSize = text.size();
+    index.present = true;
+    index.bind();
+    return index;
+}
+
+std::size_t LineIndex::lineAt(std::uint64_t offset) const
+{
+    // the newlines before offset end the lines before its line
+    return static_cast<std::size_t>(std::lower_bound(newlines.begin(), newlines.end(), offset) - newlines.begin()) + 1;
+}
+
+/*
+Written next to its final name and renamed over it, so that a reader never maps half an index.
+*/
+void LineIndex::save(const std::string &indexPath, Stamp stamp) const
+{
+    LineIndexHeader header{};
+    std::memcpy(header.magic, Magic, sizeof Magic);
+    header.textSize = stamp.size;
+    header.modified = stamp.modified;
+    header.newlineCount = newlines.size();
+
+    const std::string temporary = indexPath + ".tmp";
+    {
+        std::ofstream out{temporary, std::ios::binary | std::ios::trunc};
+        out.write(reinterpret_cast<const char *>(&header), sizeof header);
+        out.write(reinterpret_cast<const char *>(newlines.data()),
+                  static_cast<std::streamsize>(newlines.size_bytes()));
+        out.close();
+        if (!out)
+        {
+            std::remove(temporary.c_str());
+            throw std::runtime_error("cannot write " + indexPath);
+        }
+    }
+    if (std::rename(temporary.c_str(), indexPath.c_str()) != 0)
+    {
+        std::remove(temporary.c_str());
+        throw std::runtime_error("cannot write " + indexPath);
+    }
+}
+
+LineIndex LineIndex::load(const std::string &indexPath, Stamp stamp)
+{
+    LineIndex index;
+    try
+    {
+        index.saved = MappedFile{indexPath};
+    }
+    catch (const std::system_error &)
+    {
+        return {};
+    }
+
+    LineIndexHeader header;
+    if (index.saved.size() < sizeof header)
+        return {};
+    std::memcpy(&header, index.saved.data(), sizeof header);
+    if (std::memcmp(header.magic, Magic, sizeof Magic) != 0 || header.textSize != stamp.size ||
+        header.modified != stamp.modified ||
+        index.saved.size() != sizeof header + header.newlineCount * sizeof(std::uint64_t))
+        return {};
+
+    index.textSize = header.textSize;
+    index.present = true;
+    index.bind();
+    if (!index.newlines.empty() && index.newlines.back() >= index.textSize)
+        return {};
+    return index;
+}
+
+/*
+Every chunk reports the lines with a match that starts in it. A line that crosses into the next chunk can be reported by
+both; the later report is dropped.
+*/
+std::vector<LineMatch> findLines(std::string_view text, const LineIndex &index, std::string_view needle,
+                                 unsigned threads)
+{
+    if (needle.empty() || needle.find('\n') != std::string_view::npos)
+        throw std::invalid_argument("findLines: the needle must be a non-empty string without newlines");
+
+    const std::size_t chunks = chunkCount(text);
+    std::vector<std::vector<LineMatch>> perChunk(chunks);
+    forEachChunk(chunks, threads, [&](std::size_t c) {
+        const std::size_t begin = c * LineScanChunkSize;
+        scanMatches(text, begin, std::min(text.size(), begin + LineScanChunkSize), needle,
+                    [&](std::size_t pos) { perChunk[c].push_back({index.lineAt(pos), pos}); });
+    });
+
+    std::vector<LineMatch> matches;
+    for (const auto &chunk : perChunk)
+        for (const LineMatch &m : chunk)
+            if (matches.empty() || matches.back().line != m.line)
+                matches.push_back(m);
+    return matches;
+}
+
+IndexedTextFile::IndexedTextFile(const std::string &path, const IndexedTextFileOptions &options)
+    : file{path}, threads{options.threads}
+{
+    LineIndex::Stamp stamp;
+    const std::string indexPath = path + ".lines";
+    const bool persist = options.saveIndex && stampOf(path, stamp) && stamp.size == file.size();
+
+    if (persist)
+    {
+        index = LineIndex::load(indexPath, stamp);
+        loaded = index.valid();
+    }
+    if (!loaded)
+    {
+        index = LineIndex::build(file.text(), threads);
+        if (persist)
+        {
+            try
+            {
+                index.save(indexPath, stamp);
+            }
+            catch (const std::runtime_error &)
+            {
+                // a read-only directory: the index is built again the next time
+            }
+        }
+    }
+}
+
+} // namespace mk
@@ -0,0 +1,158 @@
+/* line_index.h */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mapped_file.h"
+
+/*
+Line-oriented work on large text files: count the lines, find the lines that contain a string, jump to line N.
+
+getline() finds a line by reading every byte before it, one line at a time. Here the text is mapped (MappedFile), cut
+into chunks of 1 MB, and the chunks are scanned by several threads at once, 16 bytes per step (SSE2 compares 16 bytes
+with '\n' in one instruction, and movemask turns the result into a bit per byte; elsewhere memchr(), which the C
+library vectorizes the same way). The chunks' results are put together in file order.
+
+LineIndex: the offsets of all newlines, 8 bytes per line. With it, line N is found in O(1), and the line an offset falls
+into in O(log n). Building it is one parallel scan; saved next to the file, it is loaded (mapped) instead of rebuilt
+the next time, as long as the file keeps its size and modification time.
+
+findLines: the lines that contain a string, in file order, one match per line (like grep). Most positions are ruled out
+16 at a time by comparing the needle's first and last byte at once; only where both match is the rest compared.
+
+    mk::IndexedTextFile log{"server.log"}; // maps the file; loads server.log.lines, or builds and saves it
+    std::size_t n = log.lineCount();
+    std::string_view line = log.line(123456); // 1-based
+    for (const mk::LineMatch &m : log.find("ERROR"))
+        std::cout << m.line << ": " << log.line(m.line) << "\n";
+
+Lines end with '\n'; a '\r' before it stays part of the line. A last line without a newline is a line.
+*/
+namespace mk
+{
+
+inline constexpr std::size_t LineScanChunkSize = std::size_t{1} << 20;
+
+// the offsets of the newlines in text, in order; threads == 0: one per hardware thread
+std::vector<std::uint64_t> findNewlines(std::string_view text, unsigned threads = 0);
+
+class LineIndex
+{
+    std::vector<std::uint64_t> built;
+    MappedFile saved;                        // a loaded index
+    std::span<const std::uint64_t> newlines; // into built or saved
+    std::uint64_t textSize = 0;
+    bool present = false;
+
+    void bind(); // points newlines at built or saved
+
+  public:
+    struct Stamp // of the indexed file: the index is stale when it changes
+    {
+        std::uint64_t size;
+        std::int64_t modified; // ns since the epoch
+    };
+
+    LineIndex() = default;
+    LineIndex(LineIndex &&) noexcept;
+    LineIndex &operator=(LineIndex &&) noexcept;
+
+    static LineIndex build(std::string_view text, unsigned threads = 0);
+
+    // Throws std::runtime_error if the index file cannot be written.
+    void save(const std::string &indexPath, Stamp stamp) const;
+
+    // The index saved for a file with this stamp; empty (valid() false) if there is none, it is stale or damaged.
+    static LineIndex load(const std::string &indexPath, Stamp stamp);
+
+    bool valid() const
+    {
+        return present;
+    }
+
+    std::size_t lineCount() const
+    {
+        const std::uint64_t afterLast = newlines.empty() ? 0 : newlines.back() + 1;
+        return newlines.size() + (textSize > afterLast ? 1 : 0);
+    }
+
+    // the offset of line n (1-based) and of its end (its newline, or the end of the text); n <= lineCount()
+    std::uint64_t lineBegin(std::size_t n) const
+    {
+        return n == 1 ? 0 : newlines[n - 2] + 1;
+    }
+    std::uint64_t lineEnd(std::size_t n) const
+    {
+        return n <= newlines.size() ? newlines[n - 1] : textSize;
+    }
+
+    // the line (1-based) the byte at offset belongs to
+    std::size_t lineAt(std::uint64_t offset) const;
+};
+
+struct LineMatch
+{
+    std::size_t line;     // 1-based
+    std::uint64_t offset; // of the first match in the line
+};
+
+// The lines of text that contain needle, in file order.
+// Throws std::invalid_argument if needle is empty or contains '\n'.
+std::vector<LineMatch> findLines(std::string_view text, const LineIndex &index, std::string_view needle,
+                                 unsigned threads = 0);
+
+struct IndexedTextFileOptions
+{
+    unsigned threads = 0;
+    bool saveIndex = true; // build it once, and keep it next to the file (path + ".lines") for the next time
+};
+
+class IndexedTextFile
+{
+    MappedFile file;
+    LineIndex index;
+    unsigned threads;
+    bool loaded = false;
+
+  public:
+    // Throws std::system_error if the file cannot be opened. A saved index that cannot be written is not an error.
+    explicit IndexedTextFile(const std::string &path, const IndexedTextFileOptions &options = {});
+
+    std::string_view text() const
+    {
+        return file.text();
+    }
+
+    std::size_t lineCount() const
+    {
+        return index.lineCount();
+    }
+
+    // line n (1-based, n <= lineCount()), without its newline
+    std::string_view line(std::size_t n) const
+    {
+        return text().substr(index.lineBegin(n), index.lineEnd(n) - index.lineBegin(n));
+    }
+
+    std::vector<LineMatch> find(std::string_view needle) const
+    {
+        return findLines(text(), index, needle, threads);
+    }
+
+    const LineIndex &lines() const
+    {
+        return index;
+    }
+
+    // was the index loaded from the saved one (rather than built)?
+    bool indexLoaded() const
+    {
+        return loaded;
+    }
+};
+
+} // namespace mk
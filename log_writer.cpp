@@ -0,0 +1,327 @@
+/* log_writer.cpp */
+#include "log_writer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+#if __has_include(<fcntl.h>) && __has_include(<unistd.h>)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MK_HAVE_POSIX_IO 1
+#endif
+
+namespace mk
+{
+
+namespace
+{
+
+constexpr const char *DayNames[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+constexpr const char *MonthNames[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                      "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+// a buffer with less room than this is written without waiting for maxDelay
+constexpr std::size_t NearlyFull = 256;
+
+// value as width digits with leading zeros (or leading blanks, padded)
+char *writeDigits(char *out, unsigned value, unsigned width, char pad = '0')
+{
+    for (unsigned i = width; i-- > 0; value /= 10)
+        out[i] = value == 0 && i + 1 < width && pad != '0' ? pad : static_cast<char>('0' + value % 10);
+    return out + width;
+}
+
+} // namespace
+
+/*
+ctime() is "%.3s %.3s%3d %.2d:%.2d:%.2d %d\n": the day of the month padded with a blank, not a zero. The 24 characters
+are rebuilt when the second changes; within a second, the cached text is copied and only the fraction is formatted.
+*/
+char *CtimeFormatter::format(char *out, std::chrono::system_clock::time_point t, unsigned digits)
+{
+    using namespace std::chrono;
+    const auto sinceEpoch = t.time_since_epoch();
+    const auto whole = floor<seconds>(sinceEpoch);
+    if (whole.count() != second)
+    {
+        const std::time_t calendarTime = static_cast<std::time_t>(whole.count());
+        std::tm local{};
+#ifdef _WIN32
+        localtime_s(&local, &calendarTime);
+#else
+        localtime_r(&calendarTime, &local);
+#endif
+        char *p = text;
+        std::memcpy(p, DayNames[local.tm_wday], 3);
+        p[3] = ' ';
+        std::memcpy(p + 4, MonthNames[local.tm_mon], 3);
+        p[7] = ' ';
+        writeDigits(p + 8, static_cast<unsigned>(local.tm_mday), 2, ' ');
+        p[10] = ' ';
+        writeDigits(p + 11, static_cast<unsigned>(local.tm_hour), 2);
+        p[13] = ':';
+        writeDigits(p + 14, static_cast<unsigned>(local.tm_min), 2);
+        p[16] = ':';
+        writeDigits(p + 17, static_cast<unsigned>(local.tm_sec), 2);
+        p[19] = ' ';
+        writeDigits(p + 20, static_cast<unsigned>(local.tm_year + 1900) % 10000, 4);
+        second = whole.count();
+    }
+
+    std::memcpy(out, text, 19); // up to the seconds
+    out += 19;
+    if (digits > 0)
+    {
+        digits = std::min(digits, 9u);
+        unsigned fraction = static_cast<unsigned>(duration_cast<nanoseconds>(sinceEpoch - whole).count());
+        for (unsigned d = digits; d < 9; ++d)
+            fraction /= 10;
+        *out++ = '.';
+        out = writeDigits(out, fraction, digits);
+    }
+    std::memcpy(out, text + 19, 5); // " yyyy"
+    return out + 5;
+}
+
+LogWriter::LogWriter(const std::string &path, const LogWriterOptions &options) : path{path}, options{options}
+{
+    // a buffer must hold a timestamp and some of the message
+    this->options.bufferBytes = std::max<std::size_t>(this->options.bufferBytes, 4096);
+    open(false);
+    filling.reserve(this->options.bufferBytes);
+    writing.reserve(this->options.bufferBytes);
+    writer = std::thread{[this] { run(); }};
+}
+
+LogWriter::~LogWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        stopping = true;
+    }
+    wakeWriter.notify_one();
+    writer.join(); // the writer writes what is left before it stops
+    close();
+}
+
+void LogWriter::open(bool truncate)
+{
+#ifdef MK_HAVE_POSIX_IO
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC | (truncate ? O_TRUNC : 0), 0644);
+    if (fd < 0)
+        throw std::system_error(errno, std::generic_category(), "cannot open " + path);
+    struct stat st{};
+    fileBytes = ::fstat(fd, &st) == 0 ? static_cast<std::uint64_t>(st.st_size) : 0;
+#else
+    stream = std::fopen(path.c_str(), truncate ? "wb" : "ab");
+    if (stream == nullptr)
+        throw std::system_error(errno, std::generic_category(), "cannot open " + path);
+    std::fseek(stream, 0, SEEK_END);
+    long size = std::ftell(stream);
+    fileBytes = size > 0 ? static_cast<std::uint64_t>(size) : 0;
+#endif
+}
+
+void LogWriter::close()
+{
+#ifdef MK_HAVE_POSIX_IO
+    if (fd >= 0)
+        ::close(fd);
+    fd = -1;
+#else
+    if (stream != nullptr)
+        std::fclose(stream);
+    stream = nullptr;
+#endif
+}
+
+// path.(k-1) -> path.k, ..., path -> path.1, and a new, empty path
+void LogWriter::rotate()
+{
+    close();
+    if (options.keepFiles == 0)
+    {
+        open(true);
+        return;
+    }
+    for (unsigned k = options.keepFiles; k > 1; --k)
+        std::rename((path + "." + std::to_string(k - 1)).c_str(), (path + "." + std::to_string(k)).c_str());
+    if (std::rename(path.c_str(), (path + ".1").c_str()) != 0)
+        throw std::system_error(errno, std::generic_category(), "cannot rotate " + path);
+    open(false);
+}
+
+void LogWriter::write(std::string_view message)
+{
+    // timestamp, blank, message, newline: all of it must fit into an empty buffer
+    const std::size_t room = options.bufferBytes - CtimeFormatter::MaxText - 2;
+    message = message.substr(0, room);
+    const std::size_t most = CtimeFormatter::MaxText + 2 + message.size();
+
+    std::unique_lock<std::mutex> lock{mutex};
+    throwIfFailed();
+    while (filling.size() + most > options.bufferBytes)
+    {
+        // full: have what is in it written, and wait until the writer takes it
+        flushRequested = std::max(flushRequested, appended);
+        wakeWriter.notify_one();
+        written.wait(lock);
+        throwIfFailed();
+    }
+
+    const bool first = filling.empty();
+    if (first)
+        oldest = std::chrono::steady_clock::now();
+    // the capacity is reserved: no allocation, and the clock is read under the lock, so times go up in file order
+    const std::size_t start = filling.size();
+    filling.resize(start + most);
+    char *out = timestamps.format(filling.data() + start, std::chrono::system_clock::now(), options.subsecondDigits);
+    if (!message.empty())
+    {
+        *out++ = ' ';
+        std::memcpy(out, message.data(), message.size());
+        out += message.size();
+    }
+    *out++ = '\n';
+    filling.resize(static_cast<std::size_t>(out - filling.data()));
+    appended += filling.size() - start;
+    counts.lines += 1;
+    if (first || filling.size() + NearlyFull >= options.bufferBytes)
+        wakeWriter.notify_one(); // start the clock of maxDelay, or write a full buffer
+}
+
+void LogWriter::flush()
+{
+    std::unique_lock<std::mutex> lock{mutex};
+    throwIfFailed();
+    const std::uint64_t target = appended;
+    if (done >= target)
+        return;
+    flushRequested = std::max(flushRequested, target);
+    wakeWriter.notify_one();
+    written.wait(lock, [&] { return done >= target || error; });
+    throwIfFailed();
+}
+
+LogWriterStats LogWriter::stats()
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    return counts;
+}
+
+void LogWriter::throwIfFailed()
+{
+    if (error)
+        throw std::system_error(error, "cannot write " + path);
+}
+
+void LogWriter::run()
+{
+    using clock = std::chrono::steady_clock;
+    std::unique_lock<std::mutex> lock{mutex};
+    for (;;)
+    {
+        if (filling.empty())
+        {
+            if (stopping)
+                return;
+            wakeWriter.wait(lock);
+            continue;
+        }
+
+        bool due = stopping || flushRequested > done || filling.size() + NearlyFull >= options.bufferBytes;
+        if (!due && options.maxDelay.count() > 0)
+        {
+            clock::time_point deadline = oldest + options.maxDelay;
+            due = clock::now() >= deadline;
+            if (!due)
+            {
+                wakeWriter.wait_until(lock, deadline);
+                continue;
+            }
+        }
+        if (!due)
+        {
+            wakeWriter.wait(lock);
+            continue;
+        }
+
+        // take the full buffer, and give the writers the empty one
+        std::swap(filling, writing);
+        const std::uint64_t end = appended;
+        written.notify_all();
+
+        lock.unlock();
+        std::error_code result;
+        std::uint64_t writes = 0, rotations = 0;
+        try
+        {
+            // with rotation, the buffer goes out in pieces that end after a line and fit into the current file
+            std::string_view rest{writing.data(), writing.size()};
+            while (!rest.empty())
+            {
+                std::size_t piece = rest.size();
+                if (options.maxFileBytes > 0 && fileBytes + piece > options.maxFileBytes)
+                {
+                    const std::uint64_t space = options.maxFileBytes > fileBytes ? options.maxFileBytes - fileBytes : 0;
+                    const std::size_t lastNewline = rest.substr(0, static_cast<std::size_t>(space)).rfind('\n');
+                    if (lastNewline != std::string_view::npos)
+                        piece = lastNewline + 1;
+                    else if (fileBytes > 0)
+                    {
+                        rotate();
+                        ++rotations;
+                        continue;
+                    }
+                    else // a line longer than a whole file: it gets a file of its own
+                        piece = std::min(rest.size(), rest.find('\n')) + 1;
+                }
+                writeAll(rest.data(), piece);
+                ++writes;
+                rest.remove_prefix(piece);
+            }
+        }
+        catch (const std::system_error &e)
+        {
+            result = e.code();
+        }
+        lock.lock();
+
+        if (result)
+            error = result; // the lines in this buffer are lost; write() and flush() report it from now on
+        counts.bytes += writing.size();
+        counts.writes += writes;
+        counts.rotations += rotations;
+        writing.clear();
+        done = end;
+        written.notify_all();
+    }
+}
+
+// one write() per piece; a loop only for the rare short write
+void LogWriter::writeAll(const char *data, std::size_t size)
+{
+    fileBytes += size;
+#ifdef MK_HAVE_POSIX_IO
+    while (size > 0)
+    {
+        ssize_t n = ::write(fd, data, size);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            throw std::system_error(errno, std::generic_category());
+        }
+        data += n;
+        size -= static_cast<std::size_t>(n);
+    }
+#else
+    if (std::fwrite(data, 1, size, stream) != size || std::fflush(stream) != 0)
+        throw std::system_error(std::make_error_code(std::errc::io_error));
+#endif
+}
+
+} // namespace mk
@@ -0,0 +1,123 @@
+/* log_writer.h */
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+/*
+LogWriter: timestamped lines, appended to a log file at a few tens of nanoseconds per line.
+
+    std::ofstream ofstr{"out.txt", ios::app};
+    auto timenow = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    ofstr << ctime(&timenow);
+
+opens and closes the file for every line, and ctime() converts the time to a calendar date every time - time zone
+rules included - although the date only changes once a second. LogWriter keeps the file open, keeps the formatted
+timestamp of the current second (CtimeFormatter), and appends into a preallocated buffer that a background thread
+writes, as ReadingWriter does for readings:
+
+    mk::LogWriter log{"out.txt"};   // throws std::system_error if it cannot be opened
+    log.write("server started");    // "Thu Mar 14 09:26:53 2024 server started\n", from any number of threads
+    log.flush();                    // everything written so far is in the file
+
+The timestamp is ctime()'s, without its newline: "Www Mmm dd hh:mm:ss yyyy", local time. With subsecondDigits, the
+fraction of the second follows the seconds ("09:26:53.123456 2024"); only those digits are formatted per line.
+
+Rotation: when the next buffer would take the file past maxFileBytes, the file is renamed to path.1 (path.1 to path.2,
+and so on, keeping keepFiles of them) and a new one is started. Files only ever end after a whole line.
+
+A write error is kept, and thrown (std::system_error) by the next write() or flush().
+*/
+namespace mk
+{
+
+// ctime() text, with the calendar part cached for the current second
+class CtimeFormatter
+{
+    std::int64_t second = INT64_MIN; // of the cached text
+    char text[24];                   // "Www Mmm dd hh:mm:ss yyyy"
+
+  public:
+    // Longest text: 24 characters, a '.' and 9 digits.
+    static constexpr std::size_t MaxText = 34;
+
+    // Writes the timestamp of t with digits (0-9) decimals of the second; returns the end.
+    char *format(char *out, std::chrono::system_clock::time_point t, unsigned digits = 0);
+};
+
+struct LogWriterOptions
+{
+    std::size_t bufferBytes = std::size_t{1} << 20; // written when it is full
+    std::chrono::milliseconds maxDelay{100};        // or when its oldest line has waited this long (0: no limit)
+    unsigned subsecondDigits = 0;                   // 0: exactly ctime()'s format; 3: milliseconds, 6: microseconds
+    std::uint64_t maxFileBytes = 0;                 // rotate when the file would grow past this (0: never)
+    unsigned keepFiles = 5;                         // path.1 ... path.keepFiles; 0: start the file over instead
+};
+
+struct LogWriterStats
+{
+    std::uint64_t lines = 0;
+    std::uint64_t bytes = 0;
+    std::uint64_t writes = 0; // write() calls
+    std::uint64_t rotations = 0;
+};
+
+class LogWriter
+{
+    std::string path;
+    LogWriterOptions options;
+    int fd = -1;                 // where there is POSIX write()
+    std::FILE *stream = nullptr; // elsewhere
+    std::uint64_t fileBytes = 0; // the size of the current file
+
+    std::mutex mutex;
+    std::condition_variable wakeWriter; // data to write, a flush request, or stop
+    std::condition_variable written;    // a buffer was written: space for writers, progress for flush()
+    std::vector<char> filling;          // write() appends here
+    std::vector<char> writing;          // the background thread writes this one
+    std::chrono::steady_clock::time_point oldest; // when the first line in filling was appended
+    std::uint64_t appended = 0;                   // bytes, since the start
+    std::uint64_t done = 0;                       // bytes written
+    std::uint64_t flushRequested = 0;             // write up to here now, even if the buffer is not full
+    CtimeFormatter timestamps;
+    std::error_code error;
+    bool stopping = false;
+    LogWriterStats counts;
+    std::thread writer;
+
+    void open(bool truncate);
+    void close();
+    void rotate();
+    void run();
+    void writeAll(const char *data, std::size_t size);
+    void throwIfFailed();
+
+  public:
+    // Opens (or creates) path for appending. Throws std::system_error.
+    explicit LogWriter(const std::string &path, const LogWriterOptions &options = {});
+
+    LogWriter(const LogWriter &) = delete;
+    LogWriter &operator=(const LogWriter &) = delete;
+
+    // Writes what is left and closes the file. Errors cannot be reported from here: call flush() first to see them.
+    ~LogWriter();
+
+    // One line: the current time, a blank and message (just the time if message is empty), and a newline. A message
+    // longer than the buffer is cut to fit. Lines of several threads never mix, and their times go up in file order.
+    void write(std::string_view message);
+
+    // Returns when everything written before the call is in the file.
+    void flush();
+
+    LogWriterStats stats();
+};
+
+} // namespace mk
@@ -55,12 +55,14 @@ Tokens
 
 */
 
+#include "alloc_profiler.h"
 #include "domain.h" // no semicolon after any include directive.
 #include "enums.h"
 #include "exercises.h"
 #include "functions.h"
 #include "mk_datastructures.h"
 #include "patterns.h"
+#include "small_vector.h"
 #include <iostream>
 #include <math.h>
 #include <vector>
@@ -217,23 +219,21 @@ class B
 class ResourceOnHeap
 {
   private:
-    int *array; // pointer to an array
+    // Was: int *array = new int[10] in the constructor, and delete[] array in the destructor. 10 ints fit in the
+    // SmallVector itself, so there is no heap allocation at all, and the member frees whatever it owns by itself.
+    mk::SmallVector<int, 10> array;
 
   public:
-    ResourceOnHeap()
+    ResourceOnHeap() : array(10)
     {
-        // allocate the array on the heap
-        array = new int[10];
         std::cout << "Construct a ResourceOnHeap object\n";
     }
 
     // Destructors are used to release any resources allocated by the object.
     // The most common example is when the constructor uses new, and the
-    // destructor uses delete.
+    // destructor uses delete. Here the destructor of the member array runs after this one, and does that job.
     ~ResourceOnHeap()
     {
-        // free the resources by deleting the array
-        delete[] array;
         std::cout << "Destruct a ResourceOnHeap object\n";
     }
 };
@@ -338,6 +338,7 @@ int main()
 
     // heapBasics();
     // stackBasics();
+    // runningQuantileBenchmark();
 
     // exceptionBasics();
 
@@ -348,6 +349,33 @@ int main()
 
     // memento();
 
+    // arenaBasics();
+    // arenaBenchmark();
+    // objectPoolBasics();
+    // lifetimeProbeBasics();
+    // allocProfilerBasics();
+    // alignedBufferBenchmark();
+    // numArrayBasics();
+    // numArrayBenchmark();
+    // smallVectorBenchmark();
+    // flatMapBenchmark();
+    // readingsLoaderBenchmark();
+    // readingsAggregationBenchmark();
+    // readingArchiveBenchmark();
+    // readingWriterBenchmark();
+    // readingTailBenchmark();
+    // readingCodecBenchmark();
+    // slidingWindowBenchmark();
+    // asyncReaderBenchmark();
+    // lineIndexBenchmark();
+    // logWriterBenchmark();
+    // ctimeParserBenchmark();
+    // tokenizerBenchmark();
+    // wordCountBenchmark();
+    // heavyHittersBenchmark();
+    // shapeBatchBenchmark();
+    // shapeDispatchBenchmark();
+
     // ====== exercises =========
     // try
     // {
@@ -383,6 +411,10 @@ int main()
     // assert(totalPrice(50, 10) == 475);
     // assert(totalPrice(100, 10) == 900);
 
+    // built with -DMK_ALLOC_PROFILER: where did the heap allocations come from?
+    if (mk::allocProfilerEnabled())
+        mk::writeAllocReport("alloc_profile.json");
+
     return EXIT_SUCCESS; // #define	EXIT_SUCCESS 0
 }
 
@@ -530,7 +562,11 @@ void inheritanceBasics()
     Circle c1(10);
     c1.info();
     c1.draw();
-    c1.area();
+    cout << "Area: " << c1.area() << ", Perimeter: " << c1.perimeter() << endl;
+
+    Rectangle r1(3, 4);
+    r1.info();
+    cout << "Area: " << r1.area() << ", Perimeter: " << r1.perimeter() << endl;
 
     // Runtime polymorphism is achieved only through a pointer (or reference) of
     // base class type. A base class pointer can point to the objects of base
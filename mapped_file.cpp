@@ -0,0 +1,102 @@
+/* mapped_file.cpp */
+#include "mapped_file.h"
+
+#include <cerrno>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+#include <utility>
+
+#if __has_include(<sys/mman.h>) && __has_include(<sys/stat.h>) && __has_include(<fcntl.h>) && __has_include(<unistd.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MK_HAVE_MMAP 1
+#endif
+
+namespace mk
+{
+
+MappedFile::MappedFile(const std::string &path)
+{
+#ifdef MK_HAVE_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::system_error(errno, std::generic_category(), "cannot open " + path);
+
+    struct stat st{};
+    if (::fstat(fd, &st) != 0)
+    {
+        int error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), "cannot stat " + path);
+    }
+
+    length = static_cast<std::size_t>(st.st_size);
+    if (length > 0)
+    {
+        void *p = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED)
+        {
+            int error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), "cannot map " + path);
+        }
+        // we read front to back: the kernel may read ahead aggressively, and drop pages behind us
+        ::madvise(p, length, MADV_SEQUENTIAL);
+        first = static_cast<const char *>(p);
+        mapped = true;
+    }
+    ::close(fd); // the mapping keeps the file open
+#else
+    std::ifstream in{path, std::ios::binary};
+    if (!in)
+        throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory), "cannot open " + path);
+    copy.assign(std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{});
+    first = copy.data();
+    length = copy.size();
+#endif
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : first{std::exchange(other.first, nullptr)}, length{std::exchange(other.length, 0)},
+      mapped{std::exchange(other.mapped, false)}, copy{std::move(other.copy)}
+{
+    if (!mapped && length > 0)
+        first = copy.data(); // the string moved, and maybe its characters with it
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        first = std::exchange(other.first, nullptr);
+        length = std::exchange(other.length, 0);
+        mapped = std::exchange(other.mapped, false);
+        copy = std::move(other.copy);
+        if (!mapped && length > 0)
+            first = copy.data();
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile()
+{
+    release();
+}
+
+void MappedFile::release() noexcept
+{
+#ifdef MK_HAVE_MMAP
+    if (mapped)
+        ::munmap(const_cast<char *>(first), length);
+#endif
+    first = nullptr;
+    length = 0;
+    mapped = false;
+    copy.clear();
+}
+
+} // namespace mk
@@ -0,0 +1,56 @@
+/* mapped_file.h */
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/*
+MappedFile: a whole file as one read-only block of memory.
+
+An ifstream copies the file into its buffer, and from there into our variables, a few KB at a time. mmap maps the file
+into the address space instead: the pages of the file in the OS page cache become our memory, with no copy and no
+read() call per block, and the whole file is one string_view to parse.
+
+    mk::MappedFile file{"temperatures.txt"}; // throws std::system_error if it cannot be opened
+    std::string_view text = file.text();
+
+The file must not be truncated while it is mapped (reading past its new end raises SIGBUS). Where mmap does not exist,
+the file is read into memory instead; the interface stays the same.
+*/
+namespace mk
+{
+
+class MappedFile
+{
+    const char *first = nullptr;
+    std::size_t length = 0;
+    bool mapped = false;
+    std::string copy; // the contents, when the file could not be mapped
+
+    void release() noexcept;
+
+  public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string &path);
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+    ~MappedFile();
+
+    const char *data() const
+    {
+        return first;
+    }
+    std::size_t size() const
+    {
+        return length;
+    }
+    std::string_view text() const
+    {
+        return {first, length};
+    }
+};
+
+} // namespace mk
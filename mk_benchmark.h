@@ -0,0 +1,57 @@
+/* mk_benchmark.h */
+#pragma once
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+/*
+Tiny helpers for the *Benchmark() demos.
+
+A benchmark measures wall time with a monotonic clock (std::chrono::steady_clock; system_clock may jump when the
+clock is adjusted). The optimizer is allowed to delete any computation whose result is never used, so every result is
+passed through doNotOptimize(), which tells the compiler "this value escapes, you have to compute it".
+
+Build with optimizations when you run them, e.g.
+
+    $ clang++ -std=c++20 -O2 -DNDEBUG *.cpp -o main && ./main
+*/
+namespace mk
+{
+
+class Stopwatch
+{
+    using clock = std::chrono::steady_clock;
+    clock::time_point start = clock::now();
+
+  public:
+    void restart()
+    {
+        start = clock::now();
+    }
+
+    double elapsedMs() const
+    {
+        return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+    }
+
+    double elapsedNs() const
+    {
+        return std::chrono::duration<double, std::nano>(clock::now() - start).count();
+    }
+};
+
+// Force the compiler to materialize value (an empty asm statement that claims to read it and clobber memory).
+template <typename T> inline void doNotOptimize(const T &value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// one aligned result line: "label ...... 12.345 ms"
+inline void printTiming(const std::string &label, double ms)
+{
+    std::cout << std::left << std::setw(40) << label << std::right << std::setw(12) << std::fixed
+              << std::setprecision(3) << ms << " ms" << std::defaultfloat << std::endl;
+}
+
+} // namespace mk
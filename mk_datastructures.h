@@ -1,7 +1,11 @@
 #pragma once
+#include <climits> // INT_MIN
+#include <cstddef>
+#include <functional> // std::less
 #include <iostream>
 #include <sstream>
 #include <utility> //std::swap
+#include <vector>
 class MaxHeap
 {
   private:
@@ -124,3 +128,95 @@ class MaxHeap
         return 2 * nodeIndex + 2;
     }
 };
+
+namespace mk
+{
+
+/*
+The MaxHeap above, generalized: any element type, any order, and a vector that grows instead of a fixed capacity.
+
+Compare is the order of the elements, like for std::priority_queue: with std::less the largest element is on top (a
+max-heap), with std::greater the smallest (a min-heap). push and pop are O(log n), top is O(1).
+*/
+template <typename T, typename Compare = std::less<T>> class Heap
+{
+    std::vector<T> items;
+    Compare compare;
+
+    // move items[i] up while it is above its parent
+    void siftUp(std::size_t i)
+    {
+        while (i != 0)
+        {
+            std::size_t parent = (i - 1) / 2;
+            if (!compare(items[parent], items[i]))
+                break;
+            std::swap(items[i], items[parent]);
+            i = parent;
+        }
+    }
+
+    // move items[i] down while a child is above it: the iterative form of MaxHeap::maxHeapify
+    void siftDown(std::size_t i)
+    {
+        const std::size_t size = items.size();
+        for (;;)
+        {
+            std::size_t left = 2 * i + 1, right = left + 1, top = i;
+            if (left < size && compare(items[top], items[left]))
+                top = left;
+            if (right < size && compare(items[top], items[right]))
+                top = right;
+            if (top == i)
+                return;
+            std::swap(items[i], items[top]);
+            i = top;
+        }
+    }
+
+  public:
+    Heap() = default;
+    explicit Heap(Compare compare) : compare(std::move(compare))
+    {
+    }
+
+    bool empty() const
+    {
+        return items.empty();
+    }
+
+    std::size_t size() const
+    {
+        return items.size();
+    }
+
+    void reserve(std::size_t n)
+    {
+        items.reserve(n);
+    }
+
+    // the root element; the heap must not be empty
+    const T &top() const
+    {
+        return items.front();
+    }
+
+    void push(T value)
+    {
+        items.push_back(std::move(value));
+        siftUp(items.size() - 1);
+    }
+
+    // removes and returns the root element; the heap must not be empty
+    T pop()
+    {
+        T root = std::move(items.front());
+        items.front() = std::move(items.back());
+        items.pop_back();
+        if (!items.empty())
+            siftDown(0);
+        return root;
+    }
+};
+
+} // namespace mk
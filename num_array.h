@@ -0,0 +1,471 @@
+/* num_array.h */
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <limits>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+/*
+NumArray: SimpleContainer (pointers_references.cpp) grown up.
+
+SimpleContainer owns a new double[s] and knows its size, and that is all it does. A NumArray<T> also owns a block of
+numbers, but
+
+    * the block starts on a 64-byte boundary (a cache line, and the width of the widest SIMD registers)
+    * it is move-only: a copy of a million doubles should be visible in the code, so it is spelled clone()
+    * it has element-wise arithmetic, and reductions (sum, min, max, dot)
+
+The naive way to write element-wise operators is
+
+    NumArray operator+(const NumArray &a, const NumArray &b); // returns a new array
+
+Then a = b * c + d makes a temporary for b * c, a second one for (b * c) + d, and runs over the memory three times.
+
+Expression templates avoid that: b * c does not compute anything, it returns a small object, NumBinary<multiplies, ...>,
+that remembers its operands and can compute any element on demand. (b * c) + d wraps that into another NumBinary. Only
+the assignment a = ... runs a loop, one loop over all the elements, computing each one through the whole expression
+tree. The tree is a type known at compile time, so the compiler inlines it completely: the loop is the hand-written one.
+
+The loop processes a "packet" of 16 bytes (2 doubles, 4 floats or ints) per step: the packet type is a GCC/Clang vector
+extension, as in shapes.cpp, and the operators +, -, *, / work on packets like on numbers.
+
+An expression refers to its arrays, it does not copy them: do not keep one (auto e = b * c;) beyond their lifetime.
+*/
+namespace mk
+{
+
+template <typename T> class NumArray;
+
+namespace detail
+{
+
+// 16 bytes of T: one SSE2 / NEON register
+template <typename T> struct PacketType
+{
+    typedef T type __attribute__((vector_size(16)));
+};
+
+template <typename T> using Packet = typename PacketType<T>::type;
+
+template <typename T> inline constexpr std::size_t packetSize = 16 / sizeof(T);
+
+template <typename T> inline Packet<T> loadPacket(const T *p)
+{
+    Packet<T> v;
+    std::memcpy(&v, p, sizeof v);
+    return v;
+}
+
+template <typename T> inline void storePacket(T *p, Packet<T> v)
+{
+    std::memcpy(p, &v, sizeof v);
+}
+
+template <typename T> inline Packet<T> broadcast(T x)
+{
+    return Packet<T>{} + x;
+}
+
+// element-wise minimum and maximum, for numbers and packets alike
+struct Min
+{
+    template <typename U> U operator()(U a, U b) const
+    {
+        return b < a ? b : a;
+    }
+};
+
+struct Max
+{
+    template <typename U> U operator()(U a, U b) const
+    {
+        return a < b ? b : a;
+    }
+};
+
+} // namespace detail
+
+// Every expression E derives from NumExpr<E> (CRTP, as StaticShape2D in domain.h) and has
+//     size()        the number of elements
+//     value(i)      element i
+//     packet(i)     elements i .. i + packetSize - 1
+template <typename E> struct NumExpr
+{
+    const E &self() const
+    {
+        return static_cast<const E &>(*this);
+    }
+};
+
+template <typename E> concept NumExpression = std::is_base_of_v<NumExpr<E>, E>;
+
+template <typename T> class NumScalar : public NumExpr<NumScalar<T>>
+{
+    T x;
+
+  public:
+    using value_type = T;
+
+    explicit NumScalar(T x) : x{x}
+    {
+    }
+
+    // a scalar fits any size: the other operand decides
+    static constexpr std::size_t size()
+    {
+        return std::numeric_limits<std::size_t>::max();
+    }
+
+    T value(std::size_t) const
+    {
+        return x;
+    }
+
+    detail::Packet<T> packet(std::size_t) const
+    {
+        return detail::broadcast(x);
+    }
+};
+
+namespace detail
+{
+
+// arrays are held by reference, the (small) expression objects by value
+template <typename E> struct OperandStorage
+{
+    using type = E;
+};
+
+template <typename T> struct OperandStorage<NumArray<T>>
+{
+    using type = const NumArray<T> &;
+};
+
+} // namespace detail
+
+template <typename Op, typename L, typename R> class NumBinary : public NumExpr<NumBinary<Op, L, R>>
+{
+    typename detail::OperandStorage<L>::type lhs;
+    typename detail::OperandStorage<R>::type rhs;
+
+  public:
+    using value_type = typename L::value_type;
+
+    NumBinary(const L &lhs, const R &rhs) : lhs{lhs}, rhs{rhs}
+    {
+        assert(lhs.size() == rhs.size() || lhs.size() == NumScalar<value_type>::size() ||
+               rhs.size() == NumScalar<value_type>::size());
+    }
+
+    std::size_t size() const
+    {
+        return std::min(lhs.size(), rhs.size());
+    }
+
+    value_type value(std::size_t i) const
+    {
+        return Op{}(lhs.value(i), rhs.value(i));
+    }
+
+    detail::Packet<value_type> packet(std::size_t i) const
+    {
+        return Op{}(lhs.packet(i), rhs.packet(i));
+    }
+};
+
+template <typename T> class NumArray : public NumExpr<NumArray<T>>
+{
+    static_assert(std::is_arithmetic_v<T> && !std::is_same_v<T, bool>, "NumArray holds numbers");
+
+    static constexpr std::align_val_t alignment{64};
+
+    T *elements = nullptr;
+    std::size_t count = 0;
+
+    static T *allocate(std::size_t n)
+    {
+        return n == 0 ? nullptr : static_cast<T *>(::operator new(n * sizeof(T), alignment));
+    }
+
+  public:
+    using value_type = T;
+
+    NumArray() = default;
+
+    // n elements, all equal to init
+    explicit NumArray(std::size_t n, T init = T{}) : elements{allocate(n)}, count{n}
+    {
+        std::fill_n(elements, n, init);
+    }
+
+    NumArray(std::initializer_list<T> values) : elements{allocate(values.size())}, count{values.size()}
+    {
+        std::copy(values.begin(), values.end(), elements);
+    }
+
+    // evaluate an expression into a new array
+    template <NumExpression E> NumArray(const E &e) : elements{allocate(e.size())}, count{e.size()}
+    {
+        assign(e);
+    }
+
+    NumArray(const NumArray &) = delete;
+    NumArray &operator=(const NumArray &) = delete;
+
+    NumArray(NumArray &&other) noexcept
+        : elements{std::exchange(other.elements, nullptr)}, count{std::exchange(other.count, 0)}
+    {
+    }
+
+    NumArray &operator=(NumArray &&other) noexcept
+    {
+        if (this != &other)
+        {
+            ::operator delete(elements, alignment);
+            elements = std::exchange(other.elements, nullptr);
+            count = std::exchange(other.count, 0);
+        }
+        return *this;
+    }
+
+    ~NumArray()
+    {
+        ::operator delete(elements, alignment);
+    }
+
+    // the explicit deep copy
+    NumArray clone() const
+    {
+        NumArray copy;
+        copy.elements = allocate(count);
+        copy.count = count;
+        std::copy_n(elements, count, copy.elements);
+        return copy;
+    }
+
+    // a = expression: one loop, no temporaries. The sizes must match.
+    template <NumExpression E> NumArray &operator=(const E &e)
+    {
+        assert(e.size() == count);
+        assign(e);
+        return *this;
+    }
+
+    template <NumExpression E> NumArray &operator+=(const E &e)
+    {
+        return *this = *this + e;
+    }
+    NumArray &operator+=(T x)
+    {
+        return *this = *this + x;
+    }
+    template <NumExpression E> NumArray &operator-=(const E &e)
+    {
+        return *this = *this - e;
+    }
+    NumArray &operator-=(T x)
+    {
+        return *this = *this - x;
+    }
+    template <NumExpression E> NumArray &operator*=(const E &e)
+    {
+        return *this = *this * e;
+    }
+    NumArray &operator*=(T x)
+    {
+        return *this = *this * x;
+    }
+    template <NumExpression E> NumArray &operator/=(const E &e)
+    {
+        return *this = *this / e;
+    }
+    NumArray &operator/=(T x)
+    {
+        return *this = *this / x;
+    }
+
+    std::size_t size() const
+    {
+        return count;
+    }
+    bool empty() const
+    {
+        return count == 0;
+    }
+
+    T *data()
+    {
+        return elements;
+    }
+    const T *data() const
+    {
+        return elements;
+    }
+
+    T &operator[](std::size_t i)
+    {
+        assert(i < count);
+        return elements[i];
+    }
+    const T &operator[](std::size_t i) const
+    {
+        assert(i < count);
+        return elements[i];
+    }
+
+    T *begin()
+    {
+        return elements;
+    }
+    T *end()
+    {
+        return elements + count;
+    }
+    const T *begin() const
+    {
+        return elements;
+    }
+    const T *end() const
+    {
+        return elements + count;
+    }
+
+    operator std::span<T>()
+    {
+        return {elements, count};
+    }
+    operator std::span<const T>() const
+    {
+        return {elements, count};
+    }
+
+    // the expression interface
+    T value(std::size_t i) const
+    {
+        return elements[i];
+    }
+
+    detail::Packet<T> packet(std::size_t i) const
+    {
+        return detail::loadPacket(elements + i);
+    }
+
+  private:
+    // Element i of the result only depends on element i of the operands, so a = a * b + c is safe: every element is
+    // read before it is overwritten.
+    template <typename E> void assign(const E &e)
+    {
+        constexpr std::size_t P = detail::packetSize<T>;
+        std::size_t i = 0;
+        for (; i + P <= count; i += P)
+            detail::storePacket(elements + i, e.packet(i));
+        for (; i < count; ++i)
+            elements[i] = e.value(i);
+    }
+};
+
+// The operators. An operand that is a number (a * 2.0) becomes a NumScalar.
+
+template <typename T> using NumValue = typename T::value_type;
+
+#define MK_NUM_OPERATOR(op, Functor)                                                                                   \
+    template <NumExpression L, NumExpression R> NumBinary<Functor, L, R> operator op(const L &lhs, const R &rhs)        \
+    {                                                                                                                  \
+        static_assert(std::is_same_v<NumValue<L>, NumValue<R>>, "operands of different element types");             \
+        return {lhs, rhs};                                                                                             \
+    }                                                                                                                  \
+    template <NumExpression L>                                                                                         \
+    NumBinary<Functor, L, NumScalar<NumValue<L>>> operator op(const L &lhs, std::type_identity_t<NumValue<L>> rhs)     \
+    {                                                                                                                  \
+        return {lhs, NumScalar<NumValue<L>>{rhs}};                                                                     \
+    }                                                                                                                  \
+    template <NumExpression R>                                                                                         \
+    NumBinary<Functor, NumScalar<NumValue<R>>, R> operator op(std::type_identity_t<NumValue<R>> lhs, const R &rhs)     \
+    {                                                                                                                  \
+        return {NumScalar<NumValue<R>>{lhs}, rhs};                                                                     \
+    }
+
+MK_NUM_OPERATOR(+, std::plus<>)
+MK_NUM_OPERATOR(-, std::minus<>)
+MK_NUM_OPERATOR(*, std::multiplies<>)
+MK_NUM_OPERATOR(/, std::divides<>)
+
+#undef MK_NUM_OPERATOR
+
+// element-wise minimum and maximum of two expressions
+template <NumExpression L, NumExpression R> NumBinary<detail::Min, L, R> min(const L &lhs, const R &rhs)
+{
+    return {lhs, rhs};
+}
+
+template <NumExpression L, NumExpression R> NumBinary<detail::Max, L, R> max(const L &lhs, const R &rhs)
+{
+    return {lhs, rhs};
+}
+
+namespace detail
+{
+
+// Fold all elements of e with op, starting from init. Like the reductions in shapes.cpp, 4 independent packet
+// accumulators keep the additions from waiting for each other; the order of the operations is not the one of a
+// sequential loop, so a floating-point sum may differ from it in the last digits.
+template <typename Op, typename E> NumValue<E> reduce(const E &e, NumValue<E> init)
+{
+    using T = NumValue<E>;
+    constexpr std::size_t P = packetSize<T>;
+    Op op;
+    const std::size_t n = e.size();
+
+    Packet<T> acc0 = broadcast(init), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+    std::size_t i = 0;
+    for (; i + 4 * P <= n; i += 4 * P)
+    {
+        acc0 = op(acc0, e.packet(i));
+        acc1 = op(acc1, e.packet(i + P));
+        acc2 = op(acc2, e.packet(i + 2 * P));
+        acc3 = op(acc3, e.packet(i + 3 * P));
+    }
+    Packet<T> acc = op(op(acc0, acc1), op(acc2, acc3));
+    T result = init;
+    for (std::size_t k = 0; k < P; ++k)
+        result = op(result, acc[k]);
+    for (; i < n; ++i)
+        result = op(result, e.value(i));
+    return result;
+}
+
+} // namespace detail
+
+// Reductions take any expression, so sum(a * b) is computed without an array for a * b.
+
+template <NumExpression E> NumValue<E> sum(const E &e)
+{
+    return detail::reduce<std::plus<>>(e.self(), NumValue<E>{});
+}
+
+// the smallest / largest element; the array must not be empty
+template <NumExpression E> NumValue<E> min(const E &e)
+{
+    assert(e.size() > 0);
+    return detail::reduce<detail::Min>(e.self(), e.self().value(0));
+}
+
+template <NumExpression E> NumValue<E> max(const E &e)
+{
+    assert(e.size() > 0);
+    return detail::reduce<detail::Max>(e.self(), e.self().value(0));
+}
+
+template <NumExpression L, NumExpression R> NumValue<L> dot(const L &lhs, const R &rhs)
+{
+    return sum(lhs * rhs);
+}
+
+} // namespace mk
@@ -0,0 +1,234 @@
+/* object_pool.h */
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/*
+An object pool owns the storage for many objects of the same type, and hands out handles instead of pointers.
+
+    mk::ObjectPool<mk::Entity> pool;
+    mk::PoolHandle h = pool.create("E1", 1);
+    pool.get(h).getName();
+    pool.destroy(h);
+    pool.tryGet(h); // nullptr: h is stale
+
+Storage
+Objects live in fixed-size slabs of SlabSize slots. A slab is never moved or freed while the pool lives, so an object
+stays at the same address for its whole lifetime, and growing the pool never copies anything. Freed slots are kept in
+a free list (a stack threaded through the free slots themselves), so create() and destroy() are O(1), and once the
+pool has grown to its working size (or after reserve()) it never touches the global heap again.
+
+Handles
+A handle is 32 bits: the slot index (low IndexBits) and the slot's generation (high GenerationBits). Every create()
+and every destroy() bumps the generation of the slot: an odd generation means "alive". A handle only matches while the
+generation it was issued with is still the slot's generation, so a handle kept after destroy() - a dangling pointer,
+in pointer terms - is detected instead of silently reaching the next object created in the same slot. (The generation
+wraps after 2^GenerationBits / 2 reuses of one slot.)
+
+get() checks the handle with an assert, so debug builds catch use-after-free and release builds (-DNDEBUG) pay
+nothing; tryGet() always checks.
+
+Iteration
+forEach() walks the slabs from the first slot to the last, so live objects are visited in address order, one
+contiguous block after the other.
+*/
+namespace mk
+{
+
+struct PoolHandle
+{
+    static constexpr unsigned IndexBits = 20; // up to 2^20 (~1M) objects per pool
+    static constexpr unsigned GenerationBits = 32 - IndexBits;
+    static constexpr std::uint32_t IndexMask = (1u << IndexBits) - 1;
+    static constexpr std::uint32_t GenerationMask = (1u << GenerationBits) - 1;
+
+    // a live handle always has an odd generation, so 0 is never a valid handle.
+    std::uint32_t value = 0;
+
+    std::uint32_t index() const
+    {
+        return value & IndexMask;
+    }
+
+    std::uint32_t generation() const
+    {
+        return value >> IndexBits;
+    }
+
+    explicit operator bool() const
+    {
+        return value != 0;
+    }
+
+    friend bool operator==(PoolHandle lhs, PoolHandle rhs)
+    {
+        return lhs.value == rhs.value;
+    }
+};
+
+template <typename T, std::size_t SlabSize = 1024> class ObjectPool
+{
+    // raw storage for one object; while the slot is free, it holds the index of the next free slot instead.
+    union Slot
+    {
+        alignas(T) unsigned char object[sizeof(T)];
+        std::uint32_t nextFree;
+    };
+
+    struct Slab
+    {
+        Slot slots[SlabSize];
+        std::uint32_t generation[SlabSize]{};
+    };
+
+    static constexpr std::uint32_t NoFreeSlot = PoolHandle::IndexMask; // never a valid index, see create()
+
+    std::vector<std::unique_ptr<Slab>> slabs;
+    std::uint32_t freeHead = NoFreeSlot; // the most recently freed slot
+    std::uint32_t used = 0;              // slots [0, used) have been handed out at least once
+    std::size_t live = 0;
+
+    Slot &slotAt(std::uint32_t index)
+    {
+        return slabs[index / SlabSize]->slots[index % SlabSize];
+    }
+
+    std::uint32_t &generationAt(std::uint32_t index)
+    {
+        return slabs[index / SlabSize]->generation[index % SlabSize];
+    }
+
+    T *objectAt(std::uint32_t index)
+    {
+        return std::launder(reinterpret_cast<T *>(slotAt(index).object));
+    }
+
+    static bool isAliveGeneration(std::uint32_t generation)
+    {
+        return generation & 1u;
+    }
+
+    // find a slot for a new object: reuse the last freed one, or take the next fresh one (maybe in a new slab).
+    std::uint32_t acquireSlot()
+    {
+        if (freeHead != NoFreeSlot)
+        {
+            std::uint32_t index = freeHead;
+            freeHead = slotAt(index).nextFree;
+            return index;
+        }
+        if (used == NoFreeSlot)
+            throw std::length_error("ObjectPool: out of handles");
+        if (used == capacity())
+            slabs.push_back(std::make_unique<Slab>());
+        return used++;
+    }
+
+  public:
+    ObjectPool() = default;
+
+    // the pool owns its objects, and handles refer to this very pool: no copying.
+    ObjectPool(const ObjectPool &) = delete;
+    ObjectPool &operator=(const ObjectPool &) = delete;
+
+    ~ObjectPool()
+    {
+        forEach([](T &obj) { obj.~T(); });
+    }
+
+    // Construct a T from args in a free slot, and return its handle.
+    template <typename... Args> PoolHandle create(Args &&...args)
+    {
+        std::uint32_t index = acquireSlot();
+        try
+        {
+            ::new (static_cast<void *>(slotAt(index).object)) T(std::forward<Args>(args)...);
+        }
+        catch (...)
+        {
+            slotAt(index).nextFree = freeHead; // the slot stays free
+            freeHead = index;
+            throw;
+        }
+
+        std::uint32_t &generation = generationAt(index);
+        generation = (generation + 1) & PoolHandle::GenerationMask; // even -> odd: alive
+        ++live;
+        return PoolHandle{(generation << PoolHandle::IndexBits) | index};
+    }
+
+    // Destroy the object of a live handle. Every copy of the handle becomes stale.
+    void destroy(PoolHandle h)
+    {
+        assert(isAlive(h) && "ObjectPool::destroy: stale handle (double free?)");
+
+        std::uint32_t index = h.index();
+        objectAt(index)->~T();
+
+        std::uint32_t &generation = generationAt(index);
+        generation = (generation + 1) & PoolHandle::GenerationMask; // odd -> even: free
+        slotAt(index).nextFree = freeHead;
+        freeHead = index;
+        --live;
+    }
+
+    bool isAlive(PoolHandle h) const
+    {
+        std::uint32_t index = h.index();
+        if (!h || index >= used)
+            return false;
+        return slabs[index / SlabSize]->generation[index % SlabSize] == h.generation();
+    }
+
+    // Access the object of a live handle. Stale handles are caught by the assert in debug builds.
+    T &get(PoolHandle h)
+    {
+        assert(isAlive(h) && "ObjectPool::get: stale handle (use after free?)");
+        return *objectAt(h.index());
+    }
+
+    // Access the object of a handle, or nullptr if the handle is stale.
+    T *tryGet(PoolHandle h)
+    {
+        return isAlive(h) ? objectAt(h.index()) : nullptr;
+    }
+
+    // Call f(T&) for every live object, in address order.
+    template <typename F> void forEach(F f)
+    {
+        for (std::uint32_t s = 0; s * SlabSize < used; ++s)
+        {
+            Slab &slab = *slabs[s];
+            std::uint32_t end = std::min<std::uint32_t>(SlabSize, used - s * SlabSize);
+            for (std::uint32_t i = 0; i < end; ++i)
+                if (isAliveGeneration(slab.generation[i]))
+                    f(*std::launder(reinterpret_cast<T *>(slab.slots[i].object)));
+        }
+    }
+
+    // Allocate the slabs for n objects up front, so that create() never allocates until n objects are alive.
+    void reserve(std::size_t n)
+    {
+        while (capacity() < n)
+            slabs.push_back(std::make_unique<Slab>());
+    }
+
+    std::size_t size() const
+    {
+        return live;
+    }
+
+    std::size_t capacity() const
+    {
+        return slabs.size() * SlabSize;
+    }
+};
+
+} // namespace mk
@@ -143,10 +143,16 @@ explicitly freed.
 
 #include <assert.h> /* assert */
 
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
+#include <numeric>
 #include <vector>
 
+#include "alloc_profiler.h"
 #include "functions.h"
+#include "mk_benchmark.h"
+#include "num_array.h"
 
 using namespace std;
 using namespace mk;
@@ -196,6 +202,8 @@ class SimpleContainer
       // . . .
 };
 
+// SimpleContainer grown up, with aligned storage, move-only ownership and arithmetic: mk::NumArray (num_array.h).
+
 void checkParams(Box *b)
 {
     if (!b)
@@ -373,6 +381,7 @@ void pointerBasics()
 
 void dynamicMemory()
 {
+    MK_PROFILE_FUNCTION();
 
     /*
     In C++, dynamic memory is managed through a pair of operators:
@@ -451,14 +460,14 @@ void dynamicMemory()
 
     // one of the major reasons for using the free store:
     // we can create objects in a function and pass them back to a caller.
-    double *r = createAndPassBack(5);
+    // A container returned by value does the same, with no delete[] for the caller to forget. A SmallVector of up to 8
+    // doubles does not even use the free store: the elements are moved back inside the object (small_vector.h).
+    SmallVector<double, 8> r = createAndPassBack(5);
 
     // use r
-    cout << "received address: " << r << endl;
+    cout << "received address: " << r.data() << endl;
     cout << "r[4] value: " << r[4] << endl;
-
-    // free memory r
-    delete[] r;
+    // r frees its memory (if any) when it goes out of scope
 }
 
 void smartPointers()
@@ -644,16 +653,17 @@ void print_refToNonConst(string &s)
     std::cout << endl;
 }
 
-double *createAndPassBack(int size)
+SmallVector<double, 8> createAndPassBack(int size)
 {
-    // the caller is responsible for the memory allocated for res
-    double *res = new double[size];
+    // Was: double *res = new double[size], and the caller was responsible for the memory allocated for res.
+    // res owns its elements; up to 8 of them live inside res itself, so returning it allocates nothing.
+    SmallVector<double, 8> res(size);
     for (int i = 0; i < size; i++)
     {
         res[i] = 10 * i;
     }
 
-    cout << "returning address: " << res << endl;
+    cout << "returning address: " << res.data() << endl;
 
     return res;
 }
@@ -903,4 +913,155 @@ void min_max(int &min, int &max, int x, int y)
         min = y;
         max = x;
     }
-}
\ No newline at end of file
+}
+
+void numArrayBasics()
+{
+    MK_PROFILE_FUNCTION();
+    printTitle("NumArray Basics");
+
+    NumArray<double> b{1, 2, 3, 4, 5};
+    NumArray<double> c(5, 2.0); // 5 elements, all 2.0
+    NumArray<double> d(5, 1.0);
+
+    cout << "aligned to 64 bytes: " << std::boolalpha << (reinterpret_cast<std::uintptr_t>(b.data()) % 64 == 0)
+         << std::noboolalpha << endl;
+
+    // b * c + d is an expression object; the assignment runs one loop over the 5 elements
+    NumArray<double> a(5);
+    a = b * c + d;
+    for (double x : a)
+        cout << x << " "; // 3 5 7 9 11
+    cout << endl;
+
+    // numbers mix with arrays, and the compound operators are expressions too
+    a = a * 0.5 - 1.0;
+    a += b;
+    NumArray<double> e = mk::min(a, c) / 2.0; // element-wise minimum, evaluated into a new array
+
+    cout << "sum(a): " << sum(a) << ", min(a): " << mk::min(a) << ", max(a): " << mk::max(a) << endl;
+    cout << "dot(b, c): " << dot(b, c) << ", sum(b * b): " << sum(b * b) << ", e[4]: " << e[4] << endl;
+
+    // move-only: NumArray<double> copy = a; does not compile
+    NumArray<double> copy = a.clone();
+    NumArray<double> moved = std::move(a); // takes the block, a is empty now
+    cout << "copy: " << copy.size() << " elements, moved: " << moved.size() << ", a: " << a.size() << endl;
+
+    NumArray<int> counts{3, 1, 4, 1, 5, 9, 2, 6};
+    cout << "ints: sum " << sum(counts * 10) << ", min " << mk::min(counts) << ", max " << mk::max(counts) << endl;
+}
+
+// The naive alternative: every operator returns a new vector.
+static vector<double> operator*(const vector<double> &x, const vector<double> &y)
+{
+    vector<double> result(x.size());
+    for (std::size_t i = 0; i < x.size(); ++i)
+        result[i] = x[i] * y[i];
+    return result;
+}
+
+static vector<double> operator+(const vector<double> &x, const vector<double> &y)
+{
+    vector<double> result(x.size());
+    for (std::size_t i = 0; i < x.size(); ++i)
+        result[i] = x[i] + y[i];
+    return result;
+}
+
+template <typename F> static double bestOf(int runs, F f)
+{
+    double best = 1e300;
+    for (int run = 0; run < runs; ++run)
+    {
+        Stopwatch sw;
+        f();
+        best = std::min(best, sw.elapsedMs());
+    }
+    return best;
+}
+
+/*
+a = b * c + d, and dot(b, c), three ways:
+    hand-written   a loop over vector<double>
+    naive          vector operators that return temporaries
+    NumArray       expression templates
+for arrays that fit in the caches (the same work repeated) and for arrays that do not (limited by memory bandwidth).
+*/
+static void numArrayRun(std::size_t n, int repeat, int runs)
+{
+    vector<double> vb(n), vc(n), vd(n), va(n);
+    NumArray<double> b(n), c(n), d(n), a(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        vb[i] = b[i] = 1.0 + i % 7;
+        vc[i] = c[i] = 0.5 * (i % 5);
+        vd[i] = d[i] = 0.25 * (i % 3);
+    }
+
+    cout << n << " doubles x " << repeat << ", best of " << runs << " runs\n";
+
+    double t = bestOf(runs, [&] {
+        for (int r = 0; r < repeat; ++r)
+        {
+            for (std::size_t i = 0; i < n; ++i)
+                va[i] = vb[i] * vc[i] + vd[i];
+            doNotOptimize(va.data());
+        }
+    });
+    printTiming("  a = b * c + d   hand-written", t);
+
+    t = bestOf(runs, [&] {
+        for (int r = 0; r < repeat; ++r)
+        {
+            va = vb * vc + vd;
+            doNotOptimize(va.data());
+        }
+    });
+    printTiming("  a = b * c + d   naive temporaries", t);
+
+    t = bestOf(runs, [&] {
+        for (int r = 0; r < repeat; ++r)
+        {
+            a = b * c + d;
+            doNotOptimize(a.data());
+        }
+    });
+    printTiming("  a = b * c + d   NumArray", t);
+
+    bool same = std::equal(va.begin(), va.end(), a.begin());
+
+    t = bestOf(runs, [&] {
+        for (int r = 0; r < repeat; ++r)
+        {
+            double s = 0;
+            for (std::size_t i = 0; i < n; ++i)
+                s += vb[i] * vc[i];
+            doNotOptimize(s);
+        }
+    });
+    printTiming("  dot(b, c)       hand-written", t);
+
+    t = bestOf(runs, [&] {
+        for (int r = 0; r < repeat; ++r)
+            doNotOptimize(std::inner_product(vb.begin(), vb.end(), vc.begin(), 0.0));
+    });
+    printTiming("  dot(b, c)       std::inner_product", t);
+
+    t = bestOf(runs, [&] {
+        for (int r = 0; r < repeat; ++r)
+            doNotOptimize(dot(b, c));
+    });
+    printTiming("  dot(b, c)       NumArray", t);
+
+    cout << "  identical a: " << std::boolalpha << same << std::noboolalpha
+         << ", dot: " << std::inner_product(vb.begin(), vb.end(), vc.begin(), 0.0) << " vs " << dot(b, c) << "\n";
+}
+
+void numArrayBenchmark()
+{
+    MK_PROFILE_FUNCTION();
+    printTitle("NumArray Benchmark");
+
+    numArrayRun(4096, 2000, 5);      // 4 arrays of 32 KB: in the L2 cache
+    numArrayRun(4'000'000, 2, 5);    // 4 arrays of 32 MB: from memory
+}
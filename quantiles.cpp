@@ -0,0 +1,139 @@
+/* quantiles.cpp */
+#include "quantiles.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numbers>
+
+namespace mk
+{
+
+void RunningQuantile::add(double x)
+{
+    if (lower.empty() || x <= lower.top())
+        lower.push(x);
+    else
+        upper.push(x);
+
+    // lower holds the ceil(q * n) smallest values (at least one): at most one value moves across
+    const std::size_t n = size();
+    const std::size_t rank = std::max<std::size_t>(1, static_cast<std::size_t>(std::ceil(q * static_cast<double>(n))));
+    while (lower.size() > rank)
+        upper.push(lower.pop());
+    while (lower.size() < rank)
+        lower.push(upper.pop());
+}
+
+TDigest::TDigest(double compression)
+    : compression(compression), bufferLimit(static_cast<std::size_t>(10 * compression) + 1),
+      minimum(std::numeric_limits<double>::infinity()), maximum(-std::numeric_limits<double>::infinity())
+{
+    // compress() sorts the buffer and the centroids together, in the buffer
+    centroids.reserve(static_cast<std::size_t>(2 * compression) + 8);
+    buffer.reserve(bufferLimit + centroids.capacity());
+}
+
+void TDigest::add(double x, double weight)
+{
+    if (buffer.size() >= bufferLimit)
+        compress();
+    buffer.push_back({x, weight});
+    totalWeight += weight;
+    minimum = std::min(minimum, x);
+    maximum = std::max(maximum, x);
+}
+
+void TDigest::merge(const TDigest &other)
+{
+    // first: a compress() below divides by totalWeight, which must not be 0 (into an empty digest)
+    totalWeight += other.totalWeight;
+    for (const Centroid &c : other.centroids)
+    {
+        if (buffer.size() >= bufferLimit)
+            compress();
+        buffer.push_back(c);
+    }
+    for (const Centroid &c : other.buffer)
+    {
+        if (buffer.size() >= bufferLimit)
+            compress();
+        buffer.push_back(c);
+    }
+    minimum = std::min(minimum, other.minimum);
+    maximum = std::max(maximum, other.maximum);
+}
+
+/*
+Sort the buffered values in with the centroids, and merge neighbours while the merged centroid stays within one unit of
+the scale function k(q) = delta / (2 pi) * asin(2q - 1), which is steep near q = 0 and q = 1: centroids there stay
+small, and the tails precise.
+*/
+void TDigest::compress()
+{
+    if (buffer.empty())
+        return;
+    buffer.insert(buffer.end(), centroids.begin(), centroids.end());
+    std::sort(buffer.begin(), buffer.end(), [](const Centroid &a, const Centroid &b) { return a.mean < b.mean; });
+
+    const double normalizer = compression / (2 * std::numbers::pi);
+    auto k = [&](double q) { return normalizer * std::asin(2 * q - 1); };
+    auto kInverse = [&](double kq) { return (std::sin(kq / normalizer) + 1) / 2; };
+
+    centroids.clear();
+    Centroid current = buffer.front();
+    double weightBefore = 0; // of the centroids finished so far
+    double qLimit = kInverse(k(0) + 1);
+    for (std::size_t i = 1; i < buffer.size(); ++i)
+    {
+        const Centroid &c = buffer[i];
+        if ((weightBefore + current.weight + c.weight) / totalWeight <= qLimit)
+        {
+            current.weight += c.weight;
+            current.mean += (c.mean - current.mean) * c.weight / current.weight;
+        }
+        else
+        {
+            weightBefore += current.weight;
+            centroids.push_back(current);
+            qLimit = kInverse(k(weightBefore / totalWeight) + 1);
+            current = c;
+        }
+    }
+    centroids.push_back(current);
+    buffer.clear();
+}
+
+/*
+Each centroid's weight is taken to be spread around its mean: the value at rank q * n is interpolated between the means
+of the two centroids whose centers enclose it, and between minimum / maximum and the outer centroids at the ends.
+*/
+double TDigest::quantile(double q)
+{
+    compress();
+    if (centroids.empty())
+        return std::numeric_limits<double>::quiet_NaN();
+    if (centroids.size() == 1)
+        return centroids.front().mean;
+
+    const double rank = std::clamp(q, 0.0, 1.0) * totalWeight;
+    const Centroid &first = centroids.front();
+    if (rank < first.weight / 2)
+        return minimum + (first.mean - minimum) * rank / (first.weight / 2);
+
+    double weightSoFar = first.weight / 2; // up to the center of centroid i
+    for (std::size_t i = 0; i + 1 < centroids.size(); ++i)
+    {
+        const Centroid &a = centroids[i], &b = centroids[i + 1];
+        const double between = (a.weight + b.weight) / 2;
+        if (weightSoFar + between > rank)
+            return a.mean + (b.mean - a.mean) * (rank - weightSoFar) / between;
+        weightSoFar += between;
+    }
+
+    const Centroid &last = centroids.back();
+    const double rest = last.weight / 2;
+    return last.mean + (maximum - last.mean) * std::min(1.0, (rank - weightSoFar) / rest);
+}
+
+} // namespace mk
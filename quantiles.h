@@ -0,0 +1,143 @@
+/* quantiles.h */
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "mk_datastructures.h"
+
+/*
+Medians and percentiles of a stream of numbers (temperatures), while it streams.
+
+Sorting all values seen so far for every query costs O(n log n) per query. Two structures do better:
+
+RunningQuantile: exact, O(log n) per value, O(n) memory. Two heaps split the values at the quantile: a max-heap holds
+the ceil(q * n) smallest values, a min-heap the rest. The q-quantile (by the nearest-rank definition) is the top of the
+max-heap; a new value goes to one of the heaps, and at most one value moves across to restore the split.
+
+    mk::RunningMedian median;          // RunningQuantile for q = 0.5, averaging the two middle values of an even count
+    for (const auto &r : readings)
+        median.add(r.temperature);
+    double m = median.median();
+
+TDigest: approximate, O(1) amortized per value (plus a sort per few thousand values), memory bounded by its compression
+parameter, however long the stream. It keeps the values as a sorted list of centroids (mean and weight); a centroid may
+only grow as large as the "scale function" allows at its quantile - small near 0 and 1, large near the median - so the
+tails, p95 and p99, stay accurate to a fraction of a percent of rank. (Dunning & Ertl, "Computing extremely accurate
+quantiles using t-digests", 2019.)
+
+Digests merge: each thread digests its part of the stream, and merging the digests gives a digest of the whole.
+
+    mk::TDigest digest;                // compression 200: at most about 200 centroids
+    digest.add(t);
+    double p99 = digest.quantile(0.99);
+*/
+namespace mk
+{
+
+class RunningQuantile
+{
+    double q;
+    Heap<double> lower;                       // the ceil(q * n) smallest values, the largest of them on top
+    Heap<double, std::greater<double>> upper; // the others, the smallest on top
+
+  public:
+    // q in [0, 1]
+    explicit RunningQuantile(double q) : q(q)
+    {
+    }
+
+    void add(double x);
+
+    std::size_t size() const
+    {
+        return lower.size() + upper.size();
+    }
+
+    // the value of rank ceil(q * n) (at least 1) among the n values; size() must not be 0
+    double value() const
+    {
+        return lower.top();
+    }
+
+    // the smallest value above value(); there must be one
+    double next() const
+    {
+        return upper.top();
+    }
+};
+
+class RunningMedian
+{
+    RunningQuantile half{0.5};
+
+  public:
+    void add(double x)
+    {
+        half.add(x);
+    }
+
+    std::size_t size() const
+    {
+        return half.size();
+    }
+
+    // the middle value, or the mean of the two middle values; size() must not be 0
+    double median() const
+    {
+        return half.size() % 2 ? half.value() : (half.value() + half.next()) / 2;
+    }
+};
+
+class TDigest
+{
+  public:
+    struct Centroid
+    {
+        double mean;
+        double weight;
+    };
+
+  private:
+    double compression;
+    std::vector<Centroid> centroids; // sorted by mean
+    std::vector<Centroid> buffer;    // values added since the last compress()
+    std::size_t bufferLimit;         // compress() when the buffer holds this many
+    double totalWeight = 0;          // of centroids and buffer
+    double minimum, maximum;
+
+    void compress();
+
+  public:
+    // compression (delta) bounds the number of centroids: about delta of them, and a rank error of about 1/delta near
+    // the median, much less at the tails
+    explicit TDigest(double compression = 200);
+
+    void add(double x, double weight = 1);
+
+    // other is not changed
+    void merge(const TDigest &other);
+
+    // the value at quantile q in [0, 1] (interpolated between centroids); NaN if empty. Not const: it compresses the
+    // values added since the last call first.
+    double quantile(double q);
+
+    double count() const
+    {
+        return totalWeight;
+    }
+
+    std::size_t centroidCount()
+    {
+        compress();
+        return centroids.size();
+    }
+
+    // the memory it holds, which does not grow with the number of values
+    std::size_t bytes() const
+    {
+        return (centroids.capacity() + buffer.capacity()) * sizeof(Centroid);
+    }
+};
+
+} // namespace mk
@@ -0,0 +1,343 @@
+/* reading_archive.cpp */
+#include "reading_archive.h"
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace mk
+{
+
+namespace
+{
+
+constexpr char Magic[8] = {'M', 'K', 'R', 'E', 'A', 'D', 'N', 'G'};
+constexpr std::size_t SectionAlignment = 64;
+
+void requireLittleEndian()
+{
+    if constexpr (std::endian::native != std::endian::little)
+        throw std::runtime_error("reading archives need a little-endian machine");
+}
+
+std::uint64_t alignUp(std::uint64_t offset)
+{
+    return (offset + SectionAlignment - 1) / SectionAlignment * SectionAlignment;
+}
+
+class SectionWriter
+{
+    std::ofstream out;
+    std::uint64_t offset = 0;
+
+  public:
+    explicit SectionWriter(const std::string &path) : out{path, std::ios::binary | std::ios::trunc}
+    {
+        if (!out)
+            throw std::runtime_error("cannot write " + path);
+    }
+
+    std::uint64_t position() const
+    {
+        return offset;
+    }
+
+    void write(const void *data, std::size_t bytes)
+    {
+        out.write(static_cast<const char *>(data), static_cast<std::streamsize>(bytes));
+        offset += bytes;
+    }
+
+    // zeros up to the next section boundary
+    void pad()
+    {
+        static const char zeros[SectionAlignment] = {};
+        write(zeros, alignUp(offset) - offset);
+    }
+
+    void finish(const std::string &path)
+    {
+        out.close();
+        if (!out)
+            throw std::runtime_error("cannot write " + path);
+    }
+};
+
+// the archive of two columns
+void writeColumns(const std::string &path, std::span<const std::uint8_t> hours, std::span<const double> temperatures,
+                  const ReadingArchiveOptions &options)
+{
+    requireLittleEndian();
+    const std::size_t n = hours.size();
+
+    ReadingArchiveHeader header{};
+    std::memcpy(header.magic, Magic, sizeof Magic);
+    header.version = ReadingArchive::Version;
+    int decimals = options.allowFixedPoint ? fixedPointDecimals(temperatures) : -1;
+    header.encoding = decimals >= 0 ? TemperatureEncoding::FixedPoint : TemperatureEncoding::Float;
+    header.decimals = decimals >= 0 ? static_cast<std::uint32_t>(decimals) : 0;
+    header.blockSize = ReadingArchive::BlockSize;
+    header.readingCount = n;
+    header.blockCount = (n + ReadingArchive::BlockSize - 1) / ReadingArchive::BlockSize;
+    header.hoursOffset = alignUp(sizeof header);
+    header.temperaturesOffset = alignUp(header.hoursOffset + n);
+    header.blockStatsOffset = alignUp(header.temperaturesOffset + n * 4);
+
+    SectionWriter out{path};
+    out.write(&header, sizeof header);
+    out.pad();
+    out.write(hours.data(), n);
+    out.pad();
+
+    // temperatures and block stats, one block at a time
+    std::vector<ReadingBlockStats> stats;
+    stats.reserve(header.blockCount);
+    std::vector<std::int32_t> fixedPoint;
+    std::vector<float> floats;
+    for (std::size_t from = 0; from < n; from += ReadingArchive::BlockSize)
+    {
+        std::span<const double> block = temperatures.subspan(from, std::min<std::size_t>(ReadingArchive::BlockSize, n - from));
+        auto [min, max] = std::minmax_element(block.begin(), block.end());
+        stats.push_back({*min, *max, block.size()});
+
+        if (header.encoding == TemperatureEncoding::FixedPoint)
+        {
+            fixedPoint.resize(block.size());
+            std::transform(block.begin(), block.end(), fixedPoint.begin(), [&](double t) {
+                return toFixedPoint(t, header.decimals);
+            });
+            out.write(fixedPoint.data(), fixedPoint.size() * sizeof(std::int32_t));
+        }
+        else
+        {
+            floats.assign(block.begin(), block.end());
+            out.write(floats.data(), floats.size() * sizeof(float));
+        }
+    }
+    out.pad();
+    out.write(stats.data(), stats.size() * sizeof(ReadingBlockStats));
+    out.finish(path);
+}
+
+// value / 10^decimals as text, with all its decimals: 150 with 1 decimal is "15.0", as a sensor writes it
+char *writeFixedPoint(char *p, char *end, std::int32_t value, std::uint32_t decimals)
+{
+    static constexpr std::uint32_t powersOf10[] = {1, 10, 100, 1000, 10000};
+    std::uint32_t magnitude = value < 0 ? 0u - static_cast<std::uint32_t>(value) : static_cast<std::uint32_t>(value);
+    if (value < 0)
+        *p++ = '-';
+    p = std::to_chars(p, end, magnitude / powersOf10[decimals]).ptr;
+    if (decimals > 0)
+    {
+        *p++ = '.';
+        std::uint32_t fraction = magnitude % powersOf10[decimals];
+        for (std::uint32_t d = decimals; d-- > 0; fraction /= 10)
+            p[d] = static_cast<char>('0' + fraction % 10);
+        p += decimals;
+    }
+    return p;
+}
+
+void corrupt(const std::string &path, const char *what)
+{
+    throw std::runtime_error(path + " is not a reading archive: " + what);
+}
+
+} // namespace
+
+std::int32_t toFixedPoint(double temperature, unsigned decimals)
+{
+    static constexpr double powersOf10[] = {1e0, 1e1, 1e2, 1e3, 1e4};
+    return static_cast<std::int32_t>(std::round(temperature * powersOf10[decimals]));
+}
+
+// Equal, not the same bits: "-0.0" is a common sensor reading, and must not cost us fixed point.
+int fixedPointDecimals(std::span<const double> temperatures)
+{
+    static constexpr double powersOf10[] = {1e0, 1e1, 1e2, 1e3, 1e4};
+    for (unsigned d = 0; d <= MaxFixedPointDecimals; ++d)
+    {
+        bool exact = std::all_of(temperatures.begin(), temperatures.end(), [d](double t) {
+            double scaled = std::round(t * powersOf10[d]);
+            return std::abs(scaled) <= std::numeric_limits<std::int32_t>::max() &&
+                   fromFixedPoint(static_cast<std::int32_t>(scaled), d) == t;
+        });
+        if (exact)
+            return static_cast<int>(d);
+    }
+    return -1;
+}
+
+ReadingArchive::ReadingArchive(const std::string &path) : file{path}
+{
+    requireLittleEndian();
+    if (file.size() < sizeof(ReadingArchiveHeader))
+        corrupt(path, "too short");
+    header = reinterpret_cast<const ReadingArchiveHeader *>(file.data());
+    if (std::memcmp(header->magic, Magic, sizeof Magic) != 0)
+        corrupt(path, "wrong magic");
+    if (header->version != Version)
+        corrupt(path, "unknown version");
+    if (header->encoding != TemperatureEncoding::FixedPoint && header->encoding != TemperatureEncoding::Float)
+        corrupt(path, "unknown encoding");
+    if (header->decimals > MaxFixedPointDecimals || header->blockSize != BlockSize)
+        corrupt(path, "bad encoding parameters");
+
+    // No sums of the header's numbers before they are known to be small: a crafted header could make them wrap. Every
+    // reading takes bytes of the file, so n is at most its size, and n * 4 cannot overflow.
+    const std::uint64_t n = header->readingCount;
+    const std::uint64_t size = file.size();
+    if (n > size || header->blockCount != (n + BlockSize - 1) / BlockSize)
+        corrupt(path, "reading count does not fit");
+    auto fits = [size](std::uint64_t offset, std::uint64_t bytes) {
+        return offset % SectionAlignment == 0 && offset <= size && bytes <= size - offset;
+    };
+    const std::uint64_t statsBytes = header->blockCount * sizeof(ReadingBlockStats);
+    if (!fits(header->hoursOffset, n) || !fits(header->temperaturesOffset, n * 4) ||
+        !fits(header->blockStatsOffset, statsBytes) || header->hoursOffset < sizeof(ReadingArchiveHeader) ||
+        header->hoursOffset + n > header->temperaturesOffset ||
+        header->temperaturesOffset + n * 4 > header->blockStatsOffset)
+        corrupt(path, "sections do not fit");
+
+    // the hours are trusted from here on: they index arrays
+    for (std::uint8_t h : hours())
+        if (h > 23)
+            corrupt(path, "hour out of range");
+}
+
+std::span<const std::uint8_t> ReadingArchive::hours() const
+{
+    return {reinterpret_cast<const std::uint8_t *>(file.data() + header->hoursOffset), size()};
+}
+
+std::span<const std::int32_t> ReadingArchive::fixedPointTemperatures() const
+{
+    if (header->encoding != TemperatureEncoding::FixedPoint)
+        return {};
+    return {reinterpret_cast<const std::int32_t *>(file.data() + header->temperaturesOffset), size()};
+}
+
+std::span<const float> ReadingArchive::floatTemperatures() const
+{
+    if (header->encoding != TemperatureEncoding::Float)
+        return {};
+    return {reinterpret_cast<const float *>(file.data() + header->temperaturesOffset), size()};
+}
+
+std::span<const ReadingBlockStats> ReadingArchive::blockStats() const
+{
+    return {reinterpret_cast<const ReadingBlockStats *>(file.data() + header->blockStatsOffset),
+            static_cast<std::size_t>(header->blockCount)};
+}
+
+double ReadingArchive::temperature(std::size_t i) const
+{
+    if (header->encoding == TemperatureEncoding::FixedPoint)
+        return fromFixedPoint(fixedPointTemperatures()[i], header->decimals);
+    return floatTemperatures()[i];
+}
+
+HourlyStats ReadingArchive::aggregate() const
+{
+    std::span<const std::uint8_t> h = hours();
+    std::span<const std::int32_t> fixedPoint = fixedPointTemperatures();
+    std::span<const float> floats = floatTemperatures();
+
+    HourlyStats total;
+    for (std::size_t from = 0; from < size(); from += BlockSize)
+    {
+        std::size_t to = std::min<std::size_t>(from + BlockSize, size());
+        HourlyStats block;
+        if (header->encoding == TemperatureEncoding::FixedPoint)
+            for (std::size_t i = from; i < to; ++i)
+                block.hours[h[i]].add(fromFixedPoint(fixedPoint[i], header->decimals));
+        else
+            for (std::size_t i = from; i < to; ++i)
+                block.hours[h[i]].add(floats[i]);
+        block.readings = block.lines = to - from;
+        total.merge(block);
+    }
+    return total;
+}
+
+void writeReadingArchive(const std::string &path, std::span<const Reading> readings,
+                         const ReadingArchiveOptions &options)
+{
+    std::vector<std::uint8_t> hours(readings.size());
+    std::vector<double> temperatures(readings.size());
+    for (std::size_t i = 0; i < readings.size(); ++i)
+    {
+        if (readings[i].hour < 0 || readings[i].hour > 23)
+            throw std::runtime_error("reading " + std::to_string(i) + ": hour out of range");
+        hours[i] = static_cast<std::uint8_t>(readings[i].hour);
+        temperatures[i] = readings[i].temperature;
+    }
+    writeColumns(path, hours, temperatures, options);
+}
+
+std::size_t convertTextToArchive(const std::string &textPath, const std::string &archivePath,
+                                 const ReadingArchiveOptions &options)
+{
+    MappedFile text{textPath};
+    std::size_t lines = static_cast<std::size_t>(std::count(text.data(), text.data() + text.size(), '\n')) + 1;
+    std::vector<std::uint8_t> hours;
+    std::vector<double> temperatures;
+    hours.reserve(lines);
+    temperatures.reserve(lines);
+
+    std::size_t malformed = 0;
+    forEachReading(
+        text.text(), 1,
+        [&](const Reading &r) {
+            hours.push_back(static_cast<std::uint8_t>(r.hour));
+            temperatures.push_back(r.temperature);
+        },
+        [&](std::size_t, const char *, std::string_view) { ++malformed; });
+
+    writeColumns(archivePath, hours, temperatures, options);
+    return malformed;
+}
+
+void convertArchiveToText(const std::string &archivePath, const std::string &textPath)
+{
+    ReadingArchive archive{archivePath};
+    std::ofstream out{textPath, std::ios::binary | std::ios::trunc};
+    if (!out)
+        throw std::runtime_error("cannot write " + textPath);
+
+    // "hour temperature\n" with to_chars, into a 1 MB buffer written in one piece
+    std::vector<char> buffer(1 << 20);
+    std::size_t used = 0;
+    std::span<const std::uint8_t> hours = archive.hours();
+    std::span<const std::int32_t> fixedPoint = archive.fixedPointTemperatures();
+    std::span<const float> floats = archive.floatTemperatures();
+    for (std::size_t i = 0; i < archive.size(); ++i)
+    {
+        if (buffer.size() - used < 64)
+        {
+            out.write(buffer.data(), static_cast<std::streamsize>(used));
+            used = 0;
+        }
+        char *p = buffer.data() + used;
+        char *end = buffer.data() + buffer.size();
+        p = std::to_chars(p, end, hours[i]).ptr;
+        *p++ = ' ';
+        if (archive.encoding() == TemperatureEncoding::Float)
+            p = std::to_chars(p, end, floats[i]).ptr; // the shortest text for the float
+        else
+            p = writeFixedPoint(p, end, fixedPoint[i], archive.decimals());
+        *p++ = '\n';
+        used = static_cast<std::size_t>(p - buffer.data());
+    }
+    out.write(buffer.data(), static_cast<std::streamsize>(used));
+    out.close();
+    if (!out)
+        throw std::runtime_error("cannot write " + textPath);
+}
+
+} // namespace mk
@@ -0,0 +1,143 @@
+/* reading_archive.h */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+#include "readings.h"
+
+/*
+A binary, columnar file format for readings.
+
+Text costs 6 to 8 bytes per reading, and every load parses it again. An archive stores the readings as columns:
+
+    header       64 bytes: magic "MKREADNG", schema version, encoding, counts, offsets
+    hours        one uint8 per reading
+    temperatures one int32 (fixed point) or one float per reading
+    block stats  per block of BlockSize readings: count, min and max temperature
+
+Each section starts at a multiple of 64 bytes, so that the columns can be used in place: ReadingArchive maps the file
+and hands out spans over the mapped bytes. Opening an archive reads the header and checks the hours (they index
+arrays); the pages of the temperatures are read when they are first touched.
+
+Temperatures are stored in fixed point when they allow it: t = value / 10^decimals, for the smallest decimals in
+[0, 4] that gives back every temperature exactly (the same double as the text parser produced; -0 comes back as 0).
+Otherwise they are stored as floats, which keep about 7 significant digits. 5 bytes per reading, either way.
+
+The block stats let a query skip whole blocks: readings above 40 degrees are only in the blocks whose max is above 40.
+
+The numbers are stored little-endian, as they are in memory on x86-64 and ARM64; the archive functions throw on a
+big-endian machine, as they do on any file that is not a valid archive (std::runtime_error).
+*/
+namespace mk
+{
+
+enum class TemperatureEncoding : std::uint32_t
+{
+    FixedPoint = 0, // int32: temperature * 10^decimals
+    Float = 1
+};
+
+// The fixed-point representation, shared with reading_codec.h. decimals is in [0, MaxFixedPointDecimals].
+inline constexpr unsigned MaxFixedPointDecimals = 4;
+
+// the same division the text parser makes, so the same double
+inline double fromFixedPoint(std::int32_t value, unsigned decimals)
+{
+    static constexpr double powersOf10[] = {1e0, 1e1, 1e2, 1e3, 1e4};
+    return static_cast<double>(value) / powersOf10[decimals];
+}
+
+std::int32_t toFixedPoint(double temperature, unsigned decimals);
+
+// the smallest number of decimals that stores every temperature exactly, or -1 if there is none
+int fixedPointDecimals(std::span<const double> temperatures);
+
+struct ReadingArchiveHeader
+{
+    char magic[8];         // "MKREADNG"
+    std::uint32_t version; // ReadingArchive::Version
+    TemperatureEncoding encoding;
+    std::uint32_t decimals;  // fixed point only
+    std::uint32_t blockSize; // readings per block
+    std::uint64_t readingCount;
+    std::uint64_t blockCount;
+    std::uint64_t hoursOffset; // byte offsets of the sections, from the start of the file
+    std::uint64_t temperaturesOffset;
+    std::uint64_t blockStatsOffset;
+};
+static_assert(sizeof(ReadingArchiveHeader) == 64);
+
+struct ReadingBlockStats
+{
+    double minTemperature;
+    double maxTemperature;
+    std::uint64_t count;
+};
+
+class ReadingArchive
+{
+    MappedFile file;
+    const ReadingArchiveHeader *header = nullptr;
+
+  public:
+    static constexpr std::uint32_t Version = 1;
+    static constexpr std::uint32_t BlockSize = 65536;
+
+    // Maps and checks the archive; throws std::system_error if it cannot be opened, std::runtime_error if it is not an
+    // archive (or not one of this version).
+    explicit ReadingArchive(const std::string &path);
+
+    std::size_t size() const
+    {
+        return header->readingCount;
+    }
+
+    TemperatureEncoding encoding() const
+    {
+        return header->encoding;
+    }
+
+    unsigned decimals() const
+    {
+        return header->decimals;
+    }
+
+    // the columns, in place
+    std::span<const std::uint8_t> hours() const;
+    std::span<const std::int32_t> fixedPointTemperatures() const; // empty unless encoding() is FixedPoint
+    std::span<const float> floatTemperatures() const;             // empty unless encoding() is Float
+    std::span<const ReadingBlockStats> blockStats() const;
+
+    double temperature(std::size_t i) const;
+
+    Reading operator[](std::size_t i) const
+    {
+        return {hours()[i], temperature(i)};
+    }
+
+    // Per-hour statistics of all readings. Like aggregateReadings() it sums block by block, but in blocks of BlockSize
+    // readings, not of text bytes: counts, min and max are the same as for the text, the means equal up to rounding.
+    HourlyStats aggregate() const;
+};
+
+struct ReadingArchiveOptions
+{
+    bool allowFixedPoint = true; // false: always floats
+};
+
+// Throws std::runtime_error if the file cannot be written, or a reading has an hour outside [0, 23].
+void writeReadingArchive(const std::string &path, std::span<const Reading> readings,
+                         const ReadingArchiveOptions &options = {});
+
+// text <-> archive. Malformed text lines are skipped; the number of them is returned. The text is parsed into columns
+// first (9 bytes per reading), then written. Fixed-point temperatures are written back with all their decimals ("15.0"),
+// floats as the shortest text that gives the same float ("21.3", not "21.299999237060547").
+std::size_t convertTextToArchive(const std::string &textPath, const std::string &archivePath,
+                                 const ReadingArchiveOptions &options = {});
+void convertArchiveToText(const std::string &archivePath, const std::string &textPath);
+
+} // namespace mk
@@ -0,0 +1,384 @@
+/* reading_codec.cpp */
+#include "reading_codec.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+#include "mapped_file.h"
+
+namespace mk
+{
+
+namespace
+{
+
+constexpr char Magic[8] = {'M', 'K', 'R', 'E', 'A', 'D', 'Z', '1'};
+constexpr std::size_t N = ReadingCodecBlockSize;
+
+typedef std::uint32_t U32x4 __attribute__((vector_size(16)));
+
+// Every block starts with this: the values the deltas start from, and the bit widths of its two columns.
+struct BlockHeader
+{
+    std::uint32_t firstTemperature; // fixed point, or the bits of the float
+    std::uint8_t firstHour;
+    std::uint8_t hourStep; // from the first hour to the second
+    std::uint8_t hourBits;
+    std::uint8_t temperatureBits;
+};
+static_assert(sizeof(BlockHeader) == 8);
+
+/*
+Binary packing of 128 numbers of B bits each into 16 * B bytes, as 4 lanes of 32-bit words: numbers 4j .. 4j+3 are one
+vector, and number j of a lane goes to bits [j * B, (j + 1) * B) of the lane. B is a template parameter, so that the
+loop over j unrolls into straight shifts and masks.
+*/
+template <unsigned B> void packBlock(const std::uint32_t *in, std::uint8_t *out)
+{
+    if constexpr (B > 0)
+    {
+        U32x4 words[B] = {};
+        for (unsigned j = 0; j < N / 4; ++j)
+        {
+            U32x4 v;
+            std::memcpy(&v, in + 4 * j, sizeof v);
+            const unsigned bit = j * B, k = bit / 32, shift = bit % 32;
+            words[k] |= v << shift;
+            if (shift + B > 32)
+                words[k + 1] |= v >> (32 - shift);
+        }
+        std::memcpy(out, words, sizeof words);
+    }
+}
+
+template <unsigned B> void unpackBlock(const std::uint8_t *in, std::uint32_t *out)
+{
+    if constexpr (B == 0)
+        std::fill_n(out, N, 0u);
+    else
+    {
+        constexpr std::uint32_t mask = B == 32 ? ~0u : (1u << B) - 1;
+        U32x4 words[B];
+        std::memcpy(words, in, sizeof words);
+        for (unsigned j = 0; j < N / 4; ++j)
+        {
+            const unsigned bit = j * B, k = bit / 32, shift = bit % 32;
+            U32x4 v = words[k] >> shift;
+            if (shift + B > 32)
+                v |= words[k + 1] << (32 - shift);
+            v &= mask;
+            std::memcpy(out + 4 * j, &v, sizeof v);
+        }
+    }
+}
+
+using PackFunction = void (*)(const std::uint32_t *, std::uint8_t *);
+using UnpackFunction = void (*)(const std::uint8_t *, std::uint32_t *);
+
+template <std::size_t... B> constexpr std::array<PackFunction, 33> packers(std::index_sequence<B...>)
+{
+    return {&packBlock<B>...};
+}
+
+template <std::size_t... B> constexpr std::array<UnpackFunction, 33> unpackers(std::index_sequence<B...>)
+{
+    return {&unpackBlock<B>...};
+}
+
+constexpr auto pack = packers(std::make_index_sequence<33>{});
+constexpr auto unpack = unpackers(std::make_index_sequence<33>{});
+
+std::uint32_t zigzag(std::uint32_t delta)
+{
+    return (delta << 1) ^ static_cast<std::uint32_t>(static_cast<std::int32_t>(delta) >> 31);
+}
+
+// The running sum (fixed point) or running XOR (float) of the changes, from first: 4 at a time, in two steps of a
+// shift and an add across the lanes (a parallel prefix sum), plus what came before the 4.
+template <bool Xor> void accumulate(std::uint32_t *values, std::size_t n, std::uint32_t first)
+{
+    U32x4 carry = {first, first, first, first};
+    for (std::size_t i = 0; i < n; i += 4)
+    {
+        U32x4 v;
+        std::memcpy(&v, values + i, sizeof v);
+        if constexpr (Xor)
+        {
+            v ^= U32x4{0, v[0], v[1], v[2]};
+            v ^= U32x4{0, 0, v[0], v[1]};
+            v ^= carry;
+        }
+        else
+        {
+            v = (v >> 1) ^ (0u - (v & 1u)); // unzigzag
+            v += U32x4{0, v[0], v[1], v[2]};
+            v += U32x4{0, 0, v[0], v[1]};
+            v += carry;
+        }
+        carry = U32x4{v[3], v[3], v[3], v[3]};
+        std::memcpy(values + i, &v, sizeof v);
+    }
+}
+
+unsigned bitsOf(const std::uint32_t *values)
+{
+    std::uint32_t any = 0;
+    for (std::size_t i = 0; i < N; ++i)
+        any |= values[i];
+    return static_cast<unsigned>(std::bit_width(any));
+}
+
+void append(std::vector<std::uint8_t> &out, const void *data, std::size_t size)
+{
+    const auto *bytes = static_cast<const std::uint8_t *>(data);
+    out.insert(out.end(), bytes, bytes + size);
+}
+
+// loadTemperatures(from, count, out) puts the 32-bit representation of temperatures [from, from + count) into out
+template <typename LoadTemperatures>
+std::vector<std::uint8_t> encode(std::span<const std::uint8_t> hours, TemperatureEncoding encoding, unsigned decimals,
+                                 LoadTemperatures loadTemperatures)
+{
+    if constexpr (std::endian::native != std::endian::little)
+        throw std::runtime_error("the reading codec needs a little-endian machine");
+
+    EncodedReadingsHeader header{};
+    std::memcpy(header.magic, Magic, sizeof Magic);
+    header.version = ReadingCodecVersion;
+    header.encoding = encoding;
+    header.decimals = decimals;
+    header.blockSize = static_cast<std::uint32_t>(N);
+    header.readingCount = hours.size();
+
+    std::vector<std::uint8_t> out;
+    out.reserve(sizeof header + hours.size() * 2);
+    append(out, &header, sizeof header);
+
+    std::uint32_t temperatures[N], changes[N], hourChanges[N];
+    std::uint8_t packed[16 * 32];
+    for (std::size_t from = 0; from < hours.size(); from += N)
+    {
+        const std::size_t n = std::min(N, hours.size() - from);
+        const std::uint8_t *h = hours.data() + from;
+        for (std::size_t i = 0; i < n; ++i)
+            if (h[i] > 23)
+                throw std::runtime_error("reading " + std::to_string(from + i) + ": hour out of range");
+
+        // the padding of the last block repeats its last reading: all changes 0
+        loadTemperatures(from, n, temperatures);
+        std::fill(temperatures + n, temperatures + N, temperatures[n - 1]);
+
+        BlockHeader block{};
+        block.firstTemperature = temperatures[0];
+        block.firstHour = h[0];
+        block.hourStep = n > 1 ? static_cast<std::uint8_t>((h[1] + 24 - h[0]) % 24) : 0;
+
+        changes[0] = 0;
+        for (std::size_t i = 1; i < N; ++i)
+            changes[i] = encoding == TemperatureEncoding::FixedPoint ? zigzag(temperatures[i] - temperatures[i - 1])
+                                                                     : temperatures[i] ^ temperatures[i - 1];
+        unsigned step = block.hourStep;
+        std::fill_n(hourChanges, N, 0u);
+        for (std::size_t i = 2; i < n; ++i)
+        {
+            unsigned next = static_cast<unsigned>(h[i] + 24 - h[i - 1]) % 24;
+            hourChanges[i] = (next + 24 - step) % 24;
+            step = next;
+        }
+
+        block.hourBits = static_cast<std::uint8_t>(bitsOf(hourChanges));
+        block.temperatureBits = static_cast<std::uint8_t>(bitsOf(changes));
+        append(out, &block, sizeof block);
+        pack[block.hourBits](hourChanges, packed);
+        append(out, packed, 16 * block.hourBits);
+        pack[block.temperatureBits](changes, packed);
+        append(out, packed, 16 * block.temperatureBits);
+    }
+    return out;
+}
+
+[[noreturn]] void corrupt(const char *what)
+{
+    throw std::runtime_error(std::string{"not a valid reading stream: "} + what);
+}
+
+} // namespace
+
+std::vector<std::uint8_t> encodeReadingColumns(std::span<const std::uint8_t> hours,
+                                               std::span<const double> temperatures,
+                                               const ReadingArchiveOptions &options)
+{
+    if (hours.size() != temperatures.size())
+        throw std::runtime_error("encodeReadingColumns: the columns differ in length");
+    int decimals = options.allowFixedPoint ? fixedPointDecimals(temperatures) : -1;
+    if (decimals >= 0)
+        return encode(hours, TemperatureEncoding::FixedPoint, static_cast<unsigned>(decimals),
+                      [&](std::size_t from, std::size_t n, std::uint32_t *out) {
+                          for (std::size_t i = 0; i < n; ++i)
+                              out[i] = static_cast<std::uint32_t>(toFixedPoint(temperatures[from + i],
+                                                                               static_cast<unsigned>(decimals)));
+                      });
+    return encode(hours, TemperatureEncoding::Float, 0, [&](std::size_t from, std::size_t n, std::uint32_t *out) {
+        for (std::size_t i = 0; i < n; ++i)
+            out[i] = std::bit_cast<std::uint32_t>(static_cast<float>(temperatures[from + i]));
+    });
+}
+
+std::vector<std::uint8_t> encodeReadings(std::span<const Reading> readings, const ReadingArchiveOptions &options)
+{
+    std::vector<std::uint8_t> hours(readings.size());
+    std::vector<double> temperatures(readings.size());
+    for (std::size_t i = 0; i < readings.size(); ++i)
+    {
+        if (readings[i].hour < 0 || readings[i].hour > 23)
+            throw std::runtime_error("reading " + std::to_string(i) + ": hour out of range");
+        hours[i] = static_cast<std::uint8_t>(readings[i].hour);
+        temperatures[i] = readings[i].temperature;
+    }
+    return encodeReadingColumns(hours, temperatures, options);
+}
+
+std::vector<std::uint8_t> encodeReadingArchive(const ReadingArchive &archive)
+{
+    // the columns are 32-bit already: copied block by block, straight from the mapping
+    const void *temperatures = archive.encoding() == TemperatureEncoding::FixedPoint
+                                   ? static_cast<const void *>(archive.fixedPointTemperatures().data())
+                                   : static_cast<const void *>(archive.floatTemperatures().data());
+    return encode(archive.hours(), archive.encoding(), archive.decimals(),
+                  [&](std::size_t from, std::size_t n, std::uint32_t *out) {
+                      std::memcpy(out, static_cast<const std::uint32_t *>(temperatures) + from, n * 4);
+                  });
+}
+
+bool isEncodedReadings(std::string_view bytes)
+{
+    return bytes.size() >= sizeof(EncodedReadingsHeader) && std::memcmp(bytes.data(), Magic, sizeof Magic) == 0;
+}
+
+void decodeReadingColumns(std::string_view encoded, std::vector<std::uint8_t> &hours,
+                          std::vector<double> &temperatures)
+{
+    if constexpr (std::endian::native != std::endian::little)
+        throw std::runtime_error("the reading codec needs a little-endian machine");
+    if (!isEncodedReadings(encoded))
+        corrupt("wrong magic");
+    EncodedReadingsHeader header;
+    std::memcpy(&header, encoded.data(), sizeof header);
+    if (header.version != ReadingCodecVersion || header.blockSize != N)
+        corrupt("unknown version");
+    if ((header.encoding != TemperatureEncoding::FixedPoint && header.encoding != TemperatureEncoding::Float) ||
+        header.decimals > MaxFixedPointDecimals)
+        corrupt("unknown encoding");
+    // a block takes at least 8 bytes: this also keeps a corrupt count from allocating terabytes
+    const std::size_t count = header.readingCount;
+    if ((count + N - 1) / N > (encoded.size() - sizeof header) / sizeof(BlockHeader))
+        corrupt("too short");
+
+    hours.resize(count);
+    temperatures.resize(count);
+    const bool fixedPoint = header.encoding == TemperatureEncoding::FixedPoint;
+    const char *p = encoded.data() + sizeof header;
+    const char *end = encoded.data() + encoded.size();
+    alignas(16) std::uint32_t changes[N], hourChanges[N];
+
+    for (std::size_t from = 0; from < count; from += N)
+    {
+        const std::size_t n = std::min(N, count - from);
+        BlockHeader block;
+        if (end - p < static_cast<std::ptrdiff_t>(sizeof block))
+            corrupt("too short");
+        std::memcpy(&block, p, sizeof block);
+        p += sizeof block;
+        if (block.firstHour > 23 || block.hourStep > 23 || block.hourBits > 5 || block.temperatureBits > 32)
+            corrupt("bad block header");
+        if (end - p < 16 * (block.hourBits + block.temperatureBits))
+            corrupt("too short");
+
+        // hours: all steps equal (no changes) is the common case, and then the hours repeat after 24 readings
+        std::uint8_t *h = hours.data() + from;
+        unsigned hour = block.firstHour, step = block.hourStep;
+        h[0] = static_cast<std::uint8_t>(hour);
+        if (block.hourBits == 0)
+        {
+            for (std::size_t i = 1; i < std::min<std::size_t>(n, 24); ++i)
+            {
+                hour += step;
+                hour = hour >= 24 ? hour - 24 : hour;
+                h[i] = static_cast<std::uint8_t>(hour);
+            }
+            for (std::size_t i = 24; i < n; ++i)
+                h[i] = h[i - 24];
+        }
+        else
+        {
+            unpack[block.hourBits](reinterpret_cast<const std::uint8_t *>(p), hourChanges);
+            for (std::size_t i = 1; i < n; ++i)
+            {
+                step = (step + hourChanges[i]) % 24;
+                hour = (hour + step) % 24;
+                h[i] = static_cast<std::uint8_t>(hour);
+            }
+        }
+        p += 16 * block.hourBits;
+
+        // temperatures: unpack, add up the changes, convert
+        unpack[block.temperatureBits](reinterpret_cast<const std::uint8_t *>(p), changes);
+        p += 16 * block.temperatureBits;
+        double *t = temperatures.data() + from;
+        if (fixedPoint)
+        {
+            accumulate<false>(changes, N, block.firstTemperature);
+            for (std::size_t i = 0; i < n; ++i)
+                t[i] = fromFixedPoint(static_cast<std::int32_t>(changes[i]), header.decimals);
+        }
+        else
+        {
+            accumulate<true>(changes, N, block.firstTemperature);
+            for (std::size_t i = 0; i < n; ++i)
+                t[i] = std::bit_cast<float>(changes[i]);
+        }
+    }
+}
+
+std::vector<Reading> decodeReadings(std::string_view encoded)
+{
+    std::vector<std::uint8_t> hours;
+    std::vector<double> temperatures;
+    decodeReadingColumns(encoded, hours, temperatures);
+    std::vector<Reading> readings;
+    readings.reserve(hours.size());
+    for (std::size_t i = 0; i < hours.size(); ++i)
+        readings.emplace_back(hours[i], temperatures[i]);
+    return readings;
+}
+
+std::size_t convertTextToEncoded(const std::string &textPath, const std::string &encodedPath,
+                                 const ReadingArchiveOptions &options)
+{
+    MappedFile text{textPath};
+    std::vector<std::uint8_t> hours;
+    std::vector<double> temperatures;
+    std::size_t malformed = 0;
+    forEachReading(
+        text.text(), 1,
+        [&](const Reading &r) {
+            hours.push_back(static_cast<std::uint8_t>(r.hour));
+            temperatures.push_back(r.temperature);
+        },
+        [&](std::size_t, const char *, std::string_view) { ++malformed; });
+
+    std::vector<std::uint8_t> encoded = encodeReadingColumns(hours, temperatures, options);
+    std::ofstream out{encodedPath, std::ios::binary | std::ios::trunc};
+    out.write(reinterpret_cast<const char *>(encoded.data()), static_cast<std::streamsize>(encoded.size()));
+    out.close();
+    if (!out)
+        throw std::runtime_error("cannot write " + encodedPath);
+    return malformed;
+}
+
+} // namespace mk
@@ -0,0 +1,82 @@
+/* reading_codec.h */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "reading_archive.h"
+#include "readings.h"
+
+/*
+A compressed form of a reading stream.
+
+Consecutive readings are alike: the hour goes up by the same step (0, 1, 2, ... 23, 0, 1, ...), and a temperature is
+close to the one before. So instead of the values we store how they change:
+
+    hours         delta of delta, modulo 24: the step from one hour to the next, and how much that step changed -
+                  0 as long as the readings come in at the same rate
+    temperatures  fixed point (reading_archive.h): the difference to the previous temperature, zigzag encoded (0, -1,
+                  1, -2, 2, ... -> 0, 1, 2, 3, 4, ...), so that small changes of either sign are small numbers
+                  float: the bits XOR the previous temperature's bits (Gorilla, Facebook's time-series store): equal
+                  sign, exponent and leading mantissa bits cancel out
+
+The numbers are cut into blocks of 128 readings, and a block stores each of its numbers in the bits the largest one
+needs ("binary packing"): a temperature that changes by at most 12.7 degrees per reading, in tenths, takes 8 bits
+instead of the 6-8 bytes of its text.
+
+Decoding is bit unpacking, and that is done for 4 numbers at a time: the 128 numbers of a block are laid out in 4
+interleaved lanes (number i in lane i % 4), so one shift and one mask of a 4 x 32-bit vector (GCC's vector_size,
+SSE2/NEON) unpack 4 numbers. The deltas are added up 4 at a time as well, with a parallel prefix sum.
+
+Every block starts from its own first values, so blocks can be decoded independently. The format is little-endian;
+decoding throws std::runtime_error on anything that is not a valid encoding.
+
+Where the streams show up:
+    loadReadings() recognizes an encoded file and decodes it, so a .mkz file loads like a text file
+    encodeReadingArchive() encodes the columns of a ReadingArchive as they are mapped, without a vector<Reading>
+*/
+namespace mk
+{
+
+struct EncodedReadingsHeader
+{
+    char magic[8];         // "MKREADZ1"
+    std::uint32_t version; // ReadingCodecVersion
+    TemperatureEncoding encoding;
+    std::uint32_t decimals;  // fixed point only
+    std::uint32_t blockSize; // ReadingCodecBlockSize
+    std::uint64_t readingCount;
+};
+static_assert(sizeof(EncodedReadingsHeader) == 32);
+
+inline constexpr std::uint32_t ReadingCodecVersion = 1;
+inline constexpr std::size_t ReadingCodecBlockSize = 128;
+
+std::vector<std::uint8_t> encodeReadings(std::span<const Reading> readings, const ReadingArchiveOptions &options = {});
+
+// Throws std::runtime_error if an hour is outside [0, 23].
+std::vector<std::uint8_t> encodeReadingColumns(std::span<const std::uint8_t> hours,
+                                               std::span<const double> temperatures,
+                                               const ReadingArchiveOptions &options = {});
+
+// the archive's columns as they are: fixed point stays fixed point, floats stay floats
+std::vector<std::uint8_t> encodeReadingArchive(const ReadingArchive &archive);
+
+// does bytes start like an encoded reading stream?
+bool isEncodedReadings(std::string_view bytes);
+
+// The columns. hours and temperatures are resized to the number of readings.
+void decodeReadingColumns(std::string_view encoded, std::vector<std::uint8_t> &hours,
+                          std::vector<double> &temperatures);
+
+std::vector<Reading> decodeReadings(std::string_view encoded);
+
+// Throws std::runtime_error (the file cannot be written) or std::system_error (the text cannot be read).
+// Returns the number of malformed text lines, which are skipped.
+std::size_t convertTextToEncoded(const std::string &textPath, const std::string &encodedPath,
+                                 const ReadingArchiveOptions &options = {});
+
+} // namespace mk
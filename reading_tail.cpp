@@ -0,0 +1,242 @@
+/* reading_tail.cpp */
+#include "reading_tail.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <system_error>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if __has_include(<sys/inotify.h>)
+#include <sys/inotify.h>
+#define MK_HAVE_INOTIFY 1
+#endif
+
+namespace mk
+{
+
+namespace
+{
+
+constexpr std::size_t ReadChunk = std::size_t{1} << 20;
+
+[[noreturn]] void throwErrno(const std::string &what)
+{
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+std::string directoryOf(const std::string &path)
+{
+    std::size_t slash = path.rfind('/');
+    if (slash == std::string::npos)
+        return ".";
+    return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+// Opens path and stats the open file; -1 (and errno) if either fails.
+int openForReading(const std::string &path, struct stat &st)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0 && ::fstat(fd, &st) != 0)
+    {
+        int error = errno;
+        ::close(fd);
+        errno = error;
+        return -1;
+    }
+    return fd;
+}
+
+// The offset just after the last newline before end (0 if there is none): where the line that ends at end starts.
+std::uint64_t lineStart(int fd, std::uint64_t end, const std::string &path)
+{
+    char block[4096];
+    while (end > 0)
+    {
+        const std::size_t n = static_cast<std::size_t>(std::min<std::uint64_t>(end, sizeof block));
+        ssize_t got = ::pread(fd, block, n, static_cast<off_t>(end - n));
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got < 0)
+            throwErrno("cannot read " + path);
+        if (got != static_cast<ssize_t>(n))
+            return 0; // truncated while we read: the first update() sees it
+        for (std::size_t i = n; i > 0; --i)
+            if (block[i - 1] == '\n')
+                return end - n + i;
+        end -= n;
+    }
+    return 0;
+}
+
+} // namespace
+
+ReadingTail::ReadingTail(const std::string &path, const ReadingTailOptions &options) : path{path}, options{options}
+{
+    struct stat st{};
+    int file = openForReading(path, st);
+    if (file < 0)
+        throwErrno("cannot open " + path);
+    follow(file, st);
+    // Not from the start: from the start of the last line, which the writer may be in the middle of - its first half
+    // alone would be a malformed reading. Line numbers then count from there.
+    if (!options.fromStart)
+        offset = lineStart(file, static_cast<std::uint64_t>(st.st_size), path);
+
+#ifdef MK_HAVE_INOTIFY
+    // The directory, not the file: a watch on the file would follow it when it is renamed away, and miss the new file.
+    // Appends show up as IN_MODIFY with the file's name, rotation as IN_CREATE / IN_MOVED_TO.
+    notifyFd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (notifyFd >= 0 &&
+        ::inotify_add_watch(notifyFd, directoryOf(path).c_str(), IN_MODIFY | IN_CREATE | IN_MOVED_TO) < 0)
+    {
+        ::close(notifyFd);
+        notifyFd = -1; // wait() falls back to looking every 10 ms
+    }
+#endif
+
+    if (options.fromStart)
+        update();
+}
+
+ReadingTail::~ReadingTail()
+{
+    closeFile();
+    if (notifyFd >= 0)
+        ::close(notifyFd);
+}
+
+void ReadingTail::follow(int file, const struct stat &st)
+{
+    fd = file;
+    device = static_cast<std::uint64_t>(st.st_dev);
+    inode = static_cast<std::uint64_t>(st.st_ino);
+    offset = 0;
+    nextLine = 1;
+    pending.clear();
+}
+
+void ReadingTail::closeFile()
+{
+    if (fd >= 0)
+        ::close(fd);
+    fd = -1;
+}
+
+// Does the name refer to another file than the one we have open? Not if it refers to nothing: between the "mv" and the
+// creation of the new file we keep following the old one.
+bool ReadingTail::rotated() const
+{
+    struct stat st{};
+    if (::stat(path.c_str(), &st) != 0)
+        return false;
+    return static_cast<std::uint64_t>(st.st_dev) != device || static_cast<std::uint64_t>(st.st_ino) != inode;
+}
+
+std::size_t ReadingTail::parse(std::string_view text)
+{
+    const std::size_t before = totals.readings;
+    const std::size_t lines = forEachReading(
+        text, nextLine, [&](const Reading &r) { totals.add(r); },
+        [&](std::size_t line, const char *message, std::string_view lineText) {
+            ++totals.malformedLines;
+            if (parseErrors.size() < options.maxReportedErrors)
+                parseErrors.push_back({line, message, std::string{lineText.substr(0, 80)}});
+        });
+    nextLine += lines;
+    totals.lines += lines;
+    return totals.readings - before;
+}
+
+// Reads from the offset to the current end of the file, and parses the complete lines.
+std::size_t ReadingTail::readToEnd()
+{
+    struct stat st{};
+    if (::fstat(fd, &st) != 0)
+        throwErrno("cannot stat " + path);
+    const std::uint64_t size = static_cast<std::uint64_t>(st.st_size);
+    if (size < offset)
+    {
+        // truncated: what we had of a partial line is gone with the rest
+        ++truncationCount;
+        offset = 0;
+        nextLine = 1;
+        pending.clear();
+    }
+
+    std::size_t added = 0;
+    while (offset < size)
+    {
+        const std::size_t chunk = static_cast<std::size_t>(std::min<std::uint64_t>(size - offset, ReadChunk));
+        const std::size_t kept = pending.size();
+        pending.resize(kept + chunk);
+        ssize_t n = ::pread(fd, pending.data() + kept, chunk, static_cast<off_t>(offset));
+        if (n < 0)
+        {
+            pending.resize(kept);
+            if (errno == EINTR)
+                continue;
+            throwErrno("cannot read " + path);
+        }
+        pending.resize(kept + static_cast<std::size_t>(n));
+        if (n == 0)
+            break; // truncated while we read: the next update sees it
+        offset += static_cast<std::uint64_t>(n);
+
+        // the complete lines; the partial last one waits for its newline
+        std::size_t newline = pending.rfind('\n');
+        if (newline != std::string::npos)
+        {
+            added += parse(std::string_view{pending}.substr(0, newline + 1));
+            pending.erase(0, newline + 1);
+        }
+    }
+    return added;
+}
+
+std::size_t ReadingTail::update()
+{
+    std::size_t added = readToEnd();
+    if (!rotated())
+        return added;
+
+    // Rotated: the old file is read to its end, so its last line is complete now, newline or not. If the new file
+    // cannot be opened yet, we stay with the old one and try again next time.
+    struct stat st{};
+    int newFd = openForReading(path, st);
+    if (newFd < 0)
+        return added;
+    if (!pending.empty())
+        added += parse(pending);
+    closeFile();
+    follow(newFd, st);
+    ++rotationCount;
+    return added + readToEnd();
+}
+
+std::size_t ReadingTail::wait(std::chrono::milliseconds timeout)
+{
+#ifdef MK_HAVE_INOTIFY
+    if (notifyFd >= 0)
+    {
+        pollfd p{notifyFd, POLLIN, 0};
+        if (::poll(&p, 1, static_cast<int>(timeout.count())) > 0)
+        {
+            // the events only wake us up: which file changed, and how, update() finds out itself
+            alignas(inotify_event) char events[4096];
+            while (::read(notifyFd, events, sizeof events) > 0)
+            {
+            }
+        }
+        return update();
+    }
+#endif
+    std::this_thread::sleep_for(std::min(timeout, std::chrono::milliseconds{10}));
+    return update();
+}
+
+} // namespace mk
@@ -0,0 +1,111 @@
+/* reading_tail.h */
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "readings.h"
+
+/*
+ReadingTail: follows a readings file while other processes append to it (saveTemperaturesToFile opens it with
+ios::app), and keeps per-hour statistics of everything appended - like "tail -F", with HourlyStats instead of a
+terminal.
+
+    mk::ReadingTail tail{"temperatures.txt"}; // takes in what is there, throws std::system_error if it cannot open it
+    for (;;)
+    {
+        tail.wait(std::chrono::seconds{1}); // returns as soon as the file changes
+        show(tail.stats());
+    }
+
+Re-reading and re-parsing the file on every change costs time in proportion to the file; a tail only reads the bytes
+after the offset it has reached (pread), and only parses those. inotify tells us when the file changed, so there is no
+polling interval to wait out: the statistics are updated within a system call or two of the append.
+
+The file may change under us in three ways:
+    a partial last line     the writer has written "13 3" of "13 33.5\n": it is kept until its newline arrives
+    truncation              the file is shorter than our offset: we start again from its beginning (a file that is
+                            truncated and then grows past our offset before we look is not noticed)
+    rotation                the name now refers to another file (mv temperatures.txt temperatures.1; a new one is
+                            created): the old file is read to its end, then the new one is followed from its start
+Truncation and rotation do not take readings out of the statistics: they count everything that was appended.
+
+Where there is no inotify (not Linux), wait() looks at the file every 10 ms instead.
+*/
+namespace mk
+{
+
+struct ReadingTailOptions
+{
+    bool fromStart = true; // false: only readings appended after the tail was opened, and the line being written then
+    std::size_t maxReportedErrors = 100;
+};
+
+class ReadingTail
+{
+    std::string path;
+    ReadingTailOptions options;
+    int fd = -1;                         // the file we follow
+    int notifyFd = -1;                   // inotify, watching the directory of the file
+    std::uint64_t device = 0, inode = 0; // of the file we follow: when the name refers to another, it was rotated
+    std::uint64_t offset = 0;            // bytes of the file taken in
+    std::string pending;                 // the partial last line
+    std::size_t nextLine = 1;
+
+    HourlyStats totals;
+    std::vector<ReadingParseError> parseErrors;
+    std::uint64_t truncationCount = 0, rotationCount = 0;
+
+    void follow(int file, const struct stat &st);
+    void closeFile();
+    std::size_t readToEnd();
+    std::size_t parse(std::string_view text);
+    bool rotated() const;
+
+  public:
+    explicit ReadingTail(const std::string &path, const ReadingTailOptions &options = {});
+
+    ReadingTail(const ReadingTail &) = delete;
+    ReadingTail &operator=(const ReadingTail &) = delete;
+    ~ReadingTail();
+
+    // Takes in what was appended since the last call, without waiting. Returns the number of new readings.
+    // Throws std::system_error on read errors.
+    std::size_t update();
+
+    // Waits until the file changes, at most timeout, then update()s.
+    std::size_t wait(std::chrono::milliseconds timeout);
+
+    const HourlyStats &stats() const
+    {
+        return totals;
+    }
+
+    // the first maxReportedErrors malformed lines (numbered from the start of the file they were in)
+    const std::vector<ReadingParseError> &errors() const
+    {
+        return parseErrors;
+    }
+
+    std::uint64_t truncations() const
+    {
+        return truncationCount;
+    }
+
+    std::uint64_t rotations() const
+    {
+        return rotationCount;
+    }
+
+    // bytes of a last line that has no newline yet
+    std::size_t pendingBytes() const
+    {
+        return pending.size();
+    }
+};
+
+} // namespace mk
@@ -0,0 +1,229 @@
+/* reading_writer.cpp */
+#include "reading_writer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+
+#if __has_include(<fcntl.h>) && __has_include(<unistd.h>)
+#include <fcntl.h>
+#include <unistd.h>
+#define MK_HAVE_POSIX_IO 1
+#endif
+
+namespace mk
+{
+
+char *formatReading(char *out, const Reading &r)
+{
+    char *end = out + MaxReadingText;
+    out = std::to_chars(out, end, r.hour).ptr;
+    *out++ = ' ';
+    out = std::to_chars(out, end, r.temperature).ptr;
+    *out++ = '\n';
+    return out;
+}
+
+ReadingWriter::ReadingWriter(const std::string &path, const ReadingWriterOptions &options) : options{options}
+{
+    // a buffer must hold at least one reading
+    this->options.bufferBytes = std::max(this->options.bufferBytes, MaxReadingText);
+#ifdef MK_HAVE_POSIX_IO
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0)
+        throw std::system_error(errno, std::generic_category(), "cannot open " + path);
+#else
+    stream = std::fopen(path.c_str(), "ab");
+    if (stream == nullptr)
+        throw std::system_error(errno, std::generic_category(), "cannot open " + path);
+#endif
+    filling.reserve(this->options.bufferBytes);
+    writing.reserve(this->options.bufferBytes);
+    writer = std::thread{[this] { run(); }};
+}
+
+ReadingWriter::~ReadingWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        stopping = true;
+    }
+    wakeWriter.notify_one();
+    writer.join(); // the writer writes what is left before it stops
+#ifdef MK_HAVE_POSIX_IO
+    ::close(fd);
+#else
+    std::fclose(stream);
+#endif
+}
+
+void ReadingWriter::append(const Reading &r)
+{
+    char text[MaxReadingText];
+    appendText(text, static_cast<std::size_t>(formatReading(text, r) - text), 1);
+}
+
+void ReadingWriter::append(std::span<const Reading> readings)
+{
+    // formatted outside the lock, a chunk at a time; a chunk fits into an empty buffer
+    char chunk[64 * MaxReadingText];
+    const std::size_t capacity = std::min(sizeof chunk, options.bufferBytes);
+    std::size_t used = 0, count = 0;
+    for (const Reading &r : readings)
+    {
+        if (capacity - used < MaxReadingText)
+        {
+            appendText(chunk, used, count);
+            used = count = 0;
+        }
+        used = static_cast<std::size_t>(formatReading(chunk + used, r) - chunk);
+        ++count;
+    }
+    if (count > 0)
+        appendText(chunk, used, count);
+}
+
+void ReadingWriter::appendText(const char *text, std::size_t size, std::size_t readings)
+{
+    std::unique_lock<std::mutex> lock{mutex};
+    throwIfFailed();
+    while (filling.size() + size > options.bufferBytes)
+    {
+        // full: have what is in it written, and wait until the writer takes it
+        flushRequested = std::max(flushRequested, appended);
+        wakeWriter.notify_one();
+        written.wait(lock);
+        throwIfFailed();
+    }
+
+    bool first = filling.empty();
+    if (first)
+        oldest = std::chrono::steady_clock::now();
+    filling.insert(filling.end(), text, text + size);
+    appended += size;
+    counts.readings += readings;
+    if (first || filling.size() == options.bufferBytes)
+        wakeWriter.notify_one(); // start the clock of maxDelay, or write a full buffer
+}
+
+void ReadingWriter::flush()
+{
+    std::unique_lock<std::mutex> lock{mutex};
+    throwIfFailed();
+    const std::uint64_t target = appended;
+    if (done >= target)
+        return;
+    flushRequested = std::max(flushRequested, target);
+    wakeWriter.notify_one();
+    written.wait(lock, [&] { return done >= target || error; });
+    throwIfFailed();
+}
+
+ReadingWriterStats ReadingWriter::stats()
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    return counts;
+}
+
+void ReadingWriter::throwIfFailed()
+{
+    if (error)
+        throw std::system_error(error, "cannot write readings");
+}
+
+void ReadingWriter::run()
+{
+    using clock = std::chrono::steady_clock;
+    std::unique_lock<std::mutex> lock{mutex};
+    for (;;)
+    {
+        if (filling.empty())
+        {
+            if (stopping)
+                return;
+            wakeWriter.wait(lock);
+            continue;
+        }
+
+        bool due = stopping || flushRequested > done || filling.size() >= options.bufferBytes;
+        if (!due && options.maxDelay.count() > 0)
+        {
+            clock::time_point deadline = oldest + options.maxDelay;
+            due = clock::now() >= deadline;
+            if (!due)
+            {
+                wakeWriter.wait_until(lock, deadline);
+                continue;
+            }
+        }
+        if (!due)
+        {
+            wakeWriter.wait(lock);
+            continue;
+        }
+
+        // take the full buffer, and give the producers the empty one
+        std::swap(filling, writing);
+        const std::uint64_t end = appended;
+        written.notify_all();
+
+        lock.unlock();
+        std::error_code result;
+        bool synced = false;
+        try
+        {
+            writeAll(writing.data(), writing.size());
+#ifdef MK_HAVE_POSIX_IO
+            if (options.sync == SyncPolicy::GroupCommit)
+            {
+#ifdef __APPLE__
+                int status = ::fsync(fd);
+#else
+                int status = ::fdatasync(fd);
+#endif
+                if (status != 0)
+                    throw std::system_error(errno, std::generic_category());
+                synced = true;
+            }
+#endif
+        }
+        catch (const std::system_error &e)
+        {
+            result = e.code();
+        }
+        lock.lock();
+
+        if (result)
+            error = result; // the readings in this buffer are lost; append() and flush() report it from now on
+        counts.bytes += writing.size();
+        counts.writes += 1;
+        counts.syncs += synced;
+        writing.clear();
+        done = end;
+        written.notify_all();
+    }
+}
+
+// one write() per buffer; a loop only for the rare short write
+void ReadingWriter::writeAll(const char *data, std::size_t size)
+{
+#ifdef MK_HAVE_POSIX_IO
+    while (size > 0)
+    {
+        ssize_t n = ::write(fd, data, size);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            throw std::system_error(errno, std::generic_category());
+        }
+        data += n;
+        size -= static_cast<std::size_t>(n);
+    }
+#else
+    if (std::fwrite(data, 1, size, stream) != size || std::fflush(stream) != 0)
+        throw std::system_error(std::make_error_code(std::errc::io_error));
+#endif
+}
+
+} // namespace mk
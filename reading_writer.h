@@ -0,0 +1,115 @@
+/* reading_writer.h */
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <span>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "readings.h"
+
+/*
+ReadingWriter: appends readings to a file, fast.
+
+    std::ofstream ofs{"temperatures.txt", ios::app};
+    for (const auto &r : temps)
+        ofs << r.hour << " " << r.temperature << std::endl;
+
+costs a formatting pass through the stream's locale machinery per number, and std::endl flushes the stream: one write()
+system call per reading. ReadingWriter formats with std::to_chars into a large buffer and hands the buffer to the
+kernel in one write() when it is full, or when the oldest reading in it has waited maxDelay:
+
+    mk::ReadingWriter writer{"temperatures.txt"}; // throws std::system_error if it cannot be opened
+    writer.append({13, 33.5});                    // from any number of threads
+    writer.flush();                               // everything appended so far is written (and synced, see below)
+
+The writes are done by a background thread, with two buffers: producers fill one while the other is written. A producer
+only waits when both are full, i.e. when the disk is slower than the readings arrive.
+
+Durability: a write() puts the bytes into the page cache; they reach the disk later. With SyncPolicy::GroupCommit every
+write is followed by fdatasync(), and flush() returns only after it: all readings appended by all threads since the
+last write share one sync (a "group commit"), instead of paying one sync - milliseconds on a real disk - per reading.
+
+A write error is kept, and thrown (std::system_error) by the next append() or flush().
+*/
+namespace mk
+{
+
+enum class SyncPolicy
+{
+    None,       // write() only: the data is safe when the process crashes, not when the machine does
+    GroupCommit // fdatasync() after every write()
+};
+
+struct ReadingWriterOptions
+{
+    std::size_t bufferBytes = std::size_t{1} << 20; // written when it is full
+    std::chrono::milliseconds maxDelay{100};        // or when its oldest reading has waited this long (0: no limit)
+    SyncPolicy sync = SyncPolicy::None;
+};
+
+struct ReadingWriterStats
+{
+    std::uint64_t readings = 0;
+    std::uint64_t bytes = 0;
+    std::uint64_t writes = 0; // write() calls
+    std::uint64_t syncs = 0;  // fdatasync() calls
+};
+
+class ReadingWriter
+{
+    ReadingWriterOptions options;
+    int fd = -1;                 // where there is POSIX write()
+    std::FILE *stream = nullptr; // elsewhere
+
+    std::mutex mutex;
+    std::condition_variable wakeWriter; // data to write, a flush request, or stop
+    std::condition_variable written;    // a buffer was written: space for producers, progress for flush()
+    std::vector<char> filling;          // producers append here
+    std::vector<char> writing;          // the background thread writes this one
+    std::chrono::steady_clock::time_point oldest; // when the first byte in filling was appended
+    std::uint64_t appended = 0;                   // bytes, since the start
+    std::uint64_t done = 0;                       // bytes written (and synced, if the policy says so)
+    std::uint64_t flushRequested = 0;             // write up to here now, even if the buffer is not full
+    std::error_code error;
+    bool stopping = false;
+    ReadingWriterStats counts;
+    std::thread writer;
+
+    void run();
+    void writeAll(const char *data, std::size_t size);
+    void appendText(const char *text, std::size_t size, std::size_t readings);
+    void throwIfFailed();
+
+  public:
+    // Opens (or creates) path for appending. Throws std::system_error.
+    explicit ReadingWriter(const std::string &path, const ReadingWriterOptions &options = {});
+
+    ReadingWriter(const ReadingWriter &) = delete;
+    ReadingWriter &operator=(const ReadingWriter &) = delete;
+
+    // Writes what is left and closes the file. Errors cannot be reported from here: call flush() first to see them.
+    ~ReadingWriter();
+
+    // "hour temperature\n"; the temperature in its shortest exact form ("21.3"). Safe to call from several threads: a
+    // line is never split, but the lines of two threads may interleave.
+    void append(const Reading &r);
+    void append(std::span<const Reading> readings);
+
+    // Returns when everything appended before the call is written, and synced if the policy says so.
+    void flush();
+
+    ReadingWriterStats stats();
+};
+
+// The text of one reading, as ReadingWriter writes it. out must have room for MaxReadingText characters.
+inline constexpr std::size_t MaxReadingText = 48;
+char *formatReading(char *out, const Reading &r);
+
+} // namespace mk
@@ -0,0 +1,153 @@
+/* readings.cpp */
+#include "readings.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "mapped_file.h"
+#include "reading_codec.h"
+
+namespace mk
+{
+
+// overloading '<<' operator. '\n', not std::endl: flushing after every record is up to the caller.
+std::ostream &operator<<(std::ostream &os, const Reading &r)
+{
+    return os << r.hour << " " << r.temperature << '\n';
+}
+
+// overloading '>>' operator.
+std::istream &operator>>(std::istream &is, Reading &r)
+{
+    return is >> r.hour >> r.temperature;
+}
+
+std::size_t detail::findLineEnds(const char *p, const char *end, const char **ends, std::size_t max)
+{
+    std::size_t n = 0;
+#ifdef __SSE2__
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; end - p >= 16 && n + 16 <= max; p += 16)
+    {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        for (unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline))); mask;
+             mask &= mask - 1)
+            ends[n++] = p + __builtin_ctz(mask);
+    }
+#endif
+    for (; n < max && p < end; ++n)
+    {
+        const void *found = std::memchr(p, '\n', static_cast<std::size_t>(end - p));
+        if (!found)
+            break;
+        ends[n] = static_cast<const char *>(found);
+        p = ends[n] + 1;
+    }
+    return n;
+}
+
+ReadingFile parseReadings(std::string_view text, std::size_t maxReportedErrors)
+{
+    ReadingFile result;
+
+    // One line per reading: counting the newlines first (a fast, vectorized loop) sizes the vector exactly, instead of
+    // letting push_back grow it 30 times on the way to a billion readings.
+    std::size_t newlines = static_cast<std::size_t>(std::count(text.begin(), text.end(), '\n'));
+    result.readings.reserve(newlines + 1);
+
+    result.lines = forEachReading(
+        text, 1, [&](const Reading &r) { result.readings.push_back(r); },
+        [&](std::size_t line, const char *message, std::string_view lineText) {
+            ++result.malformedLines;
+            if (result.errors.size() < maxReportedErrors)
+                result.errors.push_back({line, message, std::string{lineText.substr(0, 80)}});
+        });
+    return result;
+}
+
+ReadingFile loadReadings(const std::string &path, std::size_t maxReportedErrors)
+{
+    MappedFile file{path};
+    if (isEncodedReadings(file.text()))
+    {
+        ReadingFile result;
+        result.readings = decodeReadings(file.text());
+        result.lines = result.readings.size();
+        return result;
+    }
+    return parseReadings(file.text(), maxReportedErrors);
+}
+
+// Block i starts after the first newline at or after i * ReadingBlockSize - 1: where a line starts, found by looking at
+// the text only.
+static std::size_t blockStart(std::string_view text, std::size_t block)
+{
+    if (block == 0)
+        return 0;
+    std::size_t from = block * ReadingBlockSize - 1;
+    if (from >= text.size())
+        return text.size();
+    std::size_t newline = text.find('\n', from);
+    return newline == std::string_view::npos ? text.size() : newline + 1;
+}
+
+static HourlyStats aggregateBlock(std::string_view text, std::size_t block)
+{
+    std::size_t from = blockStart(text, block);
+    std::size_t to = blockStart(text, block + 1);
+    HourlyStats stats;
+    stats.lines = forEachReading(
+        text.substr(from, to - from), 1, [&](const Reading &r) { stats.add(r); },
+        [&](std::size_t, const char *, std::string_view) { ++stats.malformedLines; });
+    return stats;
+}
+
+HourlyStats aggregateReadings(std::string_view text, unsigned threads)
+{
+    const std::size_t blocks = (text.size() + ReadingBlockSize - 1) / ReadingBlockSize;
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<std::size_t>(threads, blocks));
+
+    // one result per block; the threads take the next block from a shared counter, so a slow block does not hold up
+    // the others
+    std::vector<HourlyStats> perBlock(blocks);
+    std::atomic<std::size_t> nextBlock{0};
+    auto work = [&] {
+        for (std::size_t b; (b = nextBlock.fetch_add(1, std::memory_order_relaxed)) < blocks;)
+            perBlock[b] = aggregateBlock(text, b);
+    };
+
+    if (threads <= 1)
+        work();
+    else
+    {
+        std::vector<std::thread> workers;
+        workers.reserve(threads);
+        for (unsigned t = 0; t < threads; ++t)
+            workers.emplace_back(work);
+        for (auto &w : workers)
+            w.join();
+    }
+
+    HourlyStats total;
+    for (const auto &b : perBlock) // in text order
+        total.merge(b);
+    return total;
+}
+
+HourlyStats aggregateReadingsFile(const std::string &path, unsigned threads)
+{
+    MappedFile file{path};
+    return aggregateReadings(file.text(), threads);
+}
+
+} // namespace mk
@@ -0,0 +1,396 @@
+/* readings.h */
+#pragma once
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iosfwd>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+Temperature readings: temperatures.txt holds one reading per line, "hour temperature",
+
+    13 33
+    17 30.5
+    23 -2
+
+Reading and its stream operators are what iostream.cpp uses for interactive input and for small files. For large files,
+loadReadings() maps the file (mapped_file.h) and parses the text in place:
+
+    mk::ReadingFile file = mk::loadReadings("temperatures.txt");
+    for (const auto &e : file.errors)
+        std::cerr << "line " << e.line << ": " << e.message << ": " << e.text << "\n";
+
+A line is malformed if the hour is not an integer in [0, 23], the temperature is not a decimal number, or anything but
+blanks follows it. Malformed lines are reported (with their line numbers) and skipped; blank lines are skipped quietly.
+
+Most of the time we only want per-hour statistics (count, min, max, mean), and aggregateReadings() computes them
+straight from the text, without a vector<Reading> in between - in parallel if asked to (see HourlyStats below).
+
+The numbers are parsed by hand (digits accumulate into an integer, and one division by a power of ten makes the double,
+which is then exactly the double std::from_chars would produce); numbers with more than 15 digits, or an exponent, go
+through std::from_chars itself.
+
+Parsing one character at a time costs a compare and a branch per character, and the branches on the length of the
+numbers are mispredicted often. So forEachReading() works in two passes over batches of lines. The first finds the
+newlines of the next 256 lines (SSE2 compares 16 bytes at a time). The second parses each line on its own: a common
+line, "7 -3.5" or "23 21.5" (1 or 2 digits before the '.' and one after, as sensors write them), is checked and
+converted 8 bytes at a time, with a table lookup instead of branches (parseShortReading()); any other line, and every
+malformed one, goes through parseReadingLine(). The lines of a batch no longer wait for each other, and the processor
+overlaps them.
+*/
+namespace mk
+{
+
+// a temperature reading, for reading/writing a struct from file.
+struct Reading
+{
+    int hour{0}; // hour after midnight [0:23]
+    double temperature{0};
+
+    Reading() = default;
+    Reading(int h, double t) : hour(h), temperature(t)
+    {
+    }
+};
+
+std::ostream &operator<<(std::ostream &os, const Reading &r);
+
+// reads "hour temperature"; prompting for it is up to the caller (see saveTemperaturesToFile)
+std::istream &operator>>(std::istream &is, Reading &r);
+
+struct ReadingParseError
+{
+    std::size_t line;    // 1-based
+    std::string message; // what is wrong
+    std::string text;    // the line (its first 80 characters)
+};
+
+struct ReadingFile
+{
+    std::vector<Reading> readings;
+    std::vector<ReadingParseError> errors; // the first maxReportedErrors malformed lines
+    std::size_t malformedLines = 0;        // all of them
+    std::size_t lines = 0;
+};
+
+// count, min, max and mean of the temperatures of one hour
+struct HourStats
+{
+    std::uint64_t count = 0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    double sum = 0;
+
+    void add(double t)
+    {
+        ++count;
+        min = t < min ? t : min;
+        max = t > max ? t : max;
+        sum += t;
+    }
+
+    // other covers readings after ours: sums are added in that order
+    void merge(const HourStats &other)
+    {
+        count += other.count;
+        min = other.min < min ? other.min : min;
+        max = other.max > max ? other.max : max;
+        sum += other.sum;
+    }
+
+    // NaN for an hour without readings
+    double mean() const
+    {
+        return count ? sum / static_cast<double>(count) : std::numeric_limits<double>::quiet_NaN();
+    }
+};
+
+/*
+Per-hour statistics of a whole readings text.
+
+A parallel sum adds the same numbers in a different order, and floating-point addition is not associative: the last
+bits of the result would depend on the number of threads. So the order is fixed by the text alone: the text is cut into
+blocks of ReadingBlockSize bytes (each block ends after a newline; a line belongs to the block it starts in), every
+block is summed from its first line to its last, and the blocks' sums are added in text order. Threads only decide who
+computes which block. The result is the same, bit for bit, for any number of threads, including the single-threaded
+reference.
+*/
+struct HourlyStats
+{
+    std::array<HourStats, 24> hours{};
+    std::size_t readings = 0;
+    std::size_t malformedLines = 0; // not counted in any hour
+    std::size_t lines = 0;
+
+    void add(const Reading &r)
+    {
+        hours[static_cast<std::size_t>(r.hour)].add(r.temperature);
+        ++readings;
+    }
+
+    void merge(const HourlyStats &other)
+    {
+        for (std::size_t h = 0; h < hours.size(); ++h)
+            hours[h].merge(other.hours[h]);
+        readings += other.readings;
+        malformedLines += other.malformedLines;
+        lines += other.lines;
+    }
+};
+
+inline constexpr std::size_t ReadingBlockSize = std::size_t{1} << 20;
+
+// threads == 0: one per hardware thread; threads == 1: the sequential reference
+HourlyStats aggregateReadings(std::string_view text, unsigned threads = 0);
+
+// Throws std::system_error if the file cannot be opened.
+HourlyStats aggregateReadingsFile(const std::string &path, unsigned threads = 0);
+
+// Throws std::system_error if the file cannot be opened. A compressed file (reading_codec.h) is decoded instead of
+// parsed; it throws std::runtime_error if it is corrupt.
+ReadingFile loadReadings(const std::string &path, std::size_t maxReportedErrors = 100);
+
+// the same, for text already in memory
+ReadingFile parseReadings(std::string_view text, std::size_t maxReportedErrors = 100);
+
+namespace detail
+{
+
+inline bool isDigit(char c)
+{
+    return static_cast<unsigned char>(c - '0') < 10;
+}
+
+inline bool isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// [+|-]digits[.digits] at p; advances p past the number. False if there is no number at p.
+inline bool parseTemperature(const char *&p, const char *end, double &out)
+{
+    static constexpr double powersOf10[] = {1e0, 1e1, 1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                            1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15};
+    const char *start = p;
+    const char *q = p;
+    bool negative = false;
+    if (q < end && (*q == '-' || *q == '+'))
+        negative = *q++ == '-';
+
+    std::uint64_t mantissa = 0;
+    int digits = 0, fractionDigits = 0;
+    for (; q < end && isDigit(*q); ++q, ++digits)
+        mantissa = mantissa * 10 + static_cast<unsigned>(*q - '0');
+    if (q < end && *q == '.')
+        for (++q; q < end && isDigit(*q); ++q, ++digits, ++fractionDigits)
+            mantissa = mantissa * 10 + static_cast<unsigned>(*q - '0');
+    if (digits == 0)
+        return false;
+
+    if (digits > 15 || (q < end && (*q == 'e' || *q == 'E')))
+    {
+        // the exact path: from_chars does not take a '+'
+        const char *from = *start == '+' ? start + 1 : start;
+        auto [ptr, ec] = std::from_chars(from, end, out);
+        if (ec != std::errc{})
+            return false;
+        p = ptr;
+        return true;
+    }
+
+    // mantissa < 10^15 < 2^53 and 10^fractionDigits are exact doubles, and the division rounds once: the result is
+    // the correctly rounded value of the decimal number
+    double value = static_cast<double>(mantissa) / powersOf10[fractionDigits];
+    out = negative ? -value : value;
+    p = q;
+    return true;
+}
+
+// Parse the line that starts at p; on return p is at the start of the next line (or at end).
+// Returns nullptr for a reading, "" for a blank line, or an error message.
+inline const char *parseReadingLine(const char *&p, const char *end, Reading &r)
+{
+    const char *q = p;
+    while (q < end && isBlank(*q))
+        ++q;
+    if (q == end || *q == '\n')
+    {
+        p = q == end ? end : q + 1;
+        return "";
+    }
+
+    const char *error = nullptr;
+    if (!isDigit(*q))
+        error = "the hour is not a number";
+    else
+    {
+        int hour = 0;
+        for (; q < end && isDigit(*q) && hour < 100; ++q)
+            hour = hour * 10 + (*q - '0');
+        if (hour > 23 || (q < end && isDigit(*q)))
+            error = "the hour is not in [0, 23]";
+        else if (q == end || !isBlank(*q))
+            error = q == end || *q == '\n' ? "no temperature" : "the hour is not a number";
+        else
+        {
+            while (q < end && isBlank(*q))
+                ++q;
+            if (!parseTemperature(q, end, r.temperature))
+                error = q == end || *q == '\n' ? "no temperature" : "the temperature is not a number";
+            else
+            {
+                while (q < end && isBlank(*q))
+                    ++q;
+                if (q < end && *q != '\n')
+                    error = "unexpected text after the temperature";
+                else
+                    r.hour = hour;
+            }
+        }
+    }
+
+    if (error)
+    {
+        const char *newline = static_cast<const char *>(std::memchr(q, '\n', static_cast<std::size_t>(end - q)));
+        q = newline ? newline : end;
+    }
+    p = q == end ? end : q + 1;
+    return error;
+}
+
+// Stores the newlines of the lines that start at p (at most max, and max >= 16) in ends, in order. Returns their
+// number: 0 if the rest of the text is one line without a newline.
+std::size_t findLineEnds(const char *p, const char *end, const char **ends, std::size_t max);
+
+// The layout of the 8 bytes that end at the newline of a common line "hour temperature": 1 or 2 digits, a space, an
+// optional '-', 1 or 2 digits, '.', 1 digit. lineShapes is indexed by the non-digit bytes of those 8 (bit i: byte i),
+// which include the newline before the line if it is shorter than 8 bytes.
+struct LineShape
+{
+    std::uint64_t separators = ~std::uint64_t{0}; // the non-digit bytes themselves; all ones: not a common line
+    std::uint8_t hourShift = 0;                   // the 2 bytes before the space, in bits
+    std::uint16_t hourDigits = 0;                 // 0xFFFF, or 0xFF00 if the hour has 1 digit
+    std::uint16_t wholeDigits = 0;                // bytes 4 and 5, the digits before the '.', the same way
+    bool negative = false;
+};
+
+constexpr std::array<LineShape, 256> makeLineShapes()
+{
+    std::array<LineShape, 256> shapes{};
+    for (int hourDigits = 1; hourDigits <= 2; ++hourDigits)
+        for (int negative = 0; negative <= 1; ++negative)
+            for (int wholeDigits = 1; wholeDigits <= 2; ++wholeDigits)
+            {
+                const int first = 8 - (hourDigits + 1 + negative + wholeDigits + 2);
+                const int space = first + hourDigits;
+                std::uint64_t separators = 0;
+                unsigned key = 0;
+                auto put = [&](int byte, char c) {
+                    separators |= std::uint64_t{static_cast<unsigned char>(c)} << 8 * byte;
+                    key |= 1u << byte;
+                };
+                if (first > 0)
+                    put(first - 1, '\n');
+                put(space, ' ');
+                if (negative)
+                    put(space + 1, '-');
+                put(6, '.');
+                shapes[key] = {separators, static_cast<std::uint8_t>(8 * (space - 2)),
+                               static_cast<std::uint16_t>(hourDigits == 2 ? 0xFFFF : 0xFF00),
+                               static_cast<std::uint16_t>(wholeDigits == 2 ? 0xFFFF : 0xFF00), negative == 1};
+            }
+    return shapes;
+}
+
+inline constexpr std::array<LineShape, 256> lineShapes = makeLineShapes();
+
+/*
+The line [p, newline), if it is a common line (see LineShape): "7 -3.5", "23 21.5". It reads the 8 bytes that end at
+the newline, finds their non-digit bytes (8 at a time), and looks up the layout they make; one compare checks the
+separators. The 2 digits of the hour, or of the temperature before the '.', are combined by one multiplication:
+bytes d1 d0 times 0x0A01 have d1 * 10 + d0 in their second byte. The temperature is then tenths / 10, the mantissa and
+the division parseTemperature() uses, so the result is the same double. False, with r untouched, for any other line.
+p[-1] must be the previous newline, and newline - 8 in the text.
+*/
+inline bool parseShortReading(const char *p, const char *newline, Reading &r)
+{
+    const std::size_t length = static_cast<std::size_t>(newline - p);
+    if (length - 5 > 3)
+        return false;
+    constexpr std::uint64_t ones = 0x0101010101010101;
+    std::uint64_t bytes;
+    std::memcpy(&bytes, newline - 8, sizeof bytes);
+    const std::uint64_t digits = bytes ^ (ones * '0'); // digits become 0..9, anything else stays above 9
+    std::uint64_t line = ~std::uint64_t{0} << 8 * (8 - length);
+    line |= line >> 8; // and the newline before it
+    const std::uint64_t nonDigits = ((digits + ones * (0x80 - 10)) | digits) & (ones * 0x80) & line;
+    const LineShape &shape = lineShapes[((nonDigits >> 7) * 0x0102040810204080) >> 56];
+    if ((bytes & (nonDigits >> 7) * 0xFF) != shape.separators)
+        return false;
+
+    const unsigned hourDigits = static_cast<unsigned>(digits >> shape.hourShift) & shape.hourDigits;
+    const unsigned hour = (hourDigits * 0x0A01 >> 8) & 0xFF;
+    const unsigned whole = ((static_cast<unsigned>(digits >> 32) & shape.wholeDigits) * 0x0A01 >> 8) & 0xFF;
+    if (hour > 23)
+        return false;
+    const double value = static_cast<double>(whole * 10 + static_cast<unsigned>(digits >> 56)) / 10;
+    r.hour = static_cast<int>(hour);
+    r.temperature = shape.negative ? -value : value;
+    return true;
+}
+
+} // namespace detail
+
+// Calls onReading(const Reading &) for every reading in text, and onError(std::size_t line, const char *message,
+// std::string_view lineText) for every malformed line. Lines are numbered from firstLine. Returns the number of lines.
+template <typename OnReading, typename OnError>
+std::size_t forEachReading(std::string_view text, std::size_t firstLine, OnReading &&onReading, OnError &&onError)
+{
+    const char *p = text.data();
+    const char *end = p + text.size();
+    std::size_t line = firstLine;
+    Reading r;
+    auto parseLine = [&] {
+        const char *lineStart = p;
+        const char *error = detail::parseReadingLine(p, end, r);
+        if (error == nullptr)
+            onReading(r);
+        else if (*error != '\0')
+        {
+            std::size_t length = static_cast<std::size_t>(p - lineStart);
+            if (length > 0 && lineStart[length - 1] == '\n')
+                --length;
+            onError(line, error, std::string_view{lineStart, length});
+        }
+        ++line;
+    };
+
+    constexpr std::size_t LineBatch = 256;
+    const char *ends[LineBatch];
+    const char *fastFrom = text.size() > 8 ? text.data() + 8 : end; // parseShortReading() reads 8 bytes back
+    while (p < end)
+    {
+        const std::size_t n = detail::findLineEnds(p, end, ends, LineBatch);
+        if (n == 0)
+            parseLine(); // the last line, without a newline
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            if (p >= fastFrom && detail::parseShortReading(p, ends[i], r))
+            {
+                onReading(r);
+                ++line;
+                p = ends[i] + 1;
+            }
+            else
+                parseLine(); // stops after ends[i] as well
+        }
+    }
+    return line - firstLine;
+}
+
+} // namespace mk
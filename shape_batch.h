@@ -0,0 +1,86 @@
+/* shape_batch.h */
+#pragma once
+#include <cstddef>
+#include <span>
+#include <vector>
+
+#include "domain.h"
+
+/*
+Data-oriented shapes.
+
+A vector<Shape2D*> is an "array of structures" behind pointers: to sum the areas, the CPU loads a pointer, follows it
+to a heap object somewhere, loads the vtable pointer, makes an indirect call, and only then does a multiplication.
+
+A ShapeBatch stores the same shapes as a "structure of arrays" (SoA): one array per field and per type,
+
+    circles:    radius[]
+    rectangles: width[], height[]
+
+so a computation over all circles is a single tight loop over contiguous doubles. Such loops can use SIMD
+instructions, which process several doubles with one instruction (see shapes.cpp).
+
+The batch does not keep the objects themselves, only their numbers: it is a snapshot for bulk computations.
+*/
+namespace mk
+{
+
+class ShapeBatch
+{
+    std::vector<double> radius;
+    std::vector<double> width;
+    std::vector<double> height;
+
+  public:
+    void add(const Circle &c)
+    {
+        radius.push_back(c.getRadius());
+    }
+
+    void add(const Rectangle &r)
+    {
+        width.push_back(r.getWidth());
+        height.push_back(r.getHeight());
+    }
+
+    void reserve(std::size_t circles, std::size_t rectangles)
+    {
+        radius.reserve(circles);
+        width.reserve(rectangles);
+        height.reserve(rectangles);
+    }
+
+    std::size_t circleCount() const
+    {
+        return radius.size();
+    }
+    std::size_t rectangleCount() const
+    {
+        return width.size();
+    }
+
+    std::span<const double> radii() const
+    {
+        return radius;
+    }
+    std::span<const double> widths() const
+    {
+        return width;
+    }
+    std::span<const double> heights() const
+    {
+        return height;
+    }
+
+    // sums over all shapes of the batch
+    double totalArea() const;
+    double totalPerimeter() const;
+
+    // one result per shape, in insertion order: out.size() must be circleCount() / rectangleCount().
+    void circleAreas(std::span<double> out) const;
+    void circlePerimeters(std::span<double> out) const;
+    void rectangleAreas(std::span<double> out) const;
+    void rectanglePerimeters(std::span<double> out) const;
+};
+
+} // namespace mk
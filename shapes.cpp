@@ -0,0 +1,444 @@
+/*
+Shapes in bulk
+
+inheritanceBasics() shows the classic object-oriented shape: a Shape2D base with virtual functions, and a Circle that
+overrides them. That is the right tool when there are a few shapes of many kinds. When there are millions of shapes
+of a few kinds, and the same computation runs over all of them, the layout of the data decides the speed - see
+shape_batch.h.
+
+SIMD (Single Instruction, Multiple Data)
+Modern CPUs have vector registers that hold several numbers, and instructions that add or multiply all of them at once
+(2 doubles in a 128-bit register). GCC and Clang expose them portably as "vector extensions": a type declared with
+__attribute__((vector_size(N))) behaves like a small array on which +, -, * work element-wise, and the compiler maps it
+to SSE on x86 or NEON on ARM.
+*/
+
+#include "alloc_profiler.h"
+#include "functions.h"
+#include "mk_benchmark.h"
+#include "shape_batch.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <streambuf>
+#include <string>
+#include <variant>
+#include <vector>
+
+using std::cout;
+using std::endl;
+
+namespace
+{
+
+// 2 doubles, processed by one instruction: a 128-bit register is there on every x86-64 (SSE2) and ARM64 (NEON) CPU.
+typedef double double2 __attribute__((vector_size(2 * sizeof(double))));
+
+// The arrays of a std::vector<double> are only 8-byte aligned: copy in and out instead of casting the pointer.
+inline double2 load2(const double *p)
+{
+    double2 v;
+    std::memcpy(&v, p, sizeof v);
+    return v;
+}
+
+inline void store2(double *p, double2 v)
+{
+    std::memcpy(p, &v, sizeof v);
+}
+
+// Reductions keep 4 independent accumulators (8 doubles per iteration), so that the next addition does not have to
+// wait for the previous one to finish.
+
+// sum of x[i] * x[i]
+double sumOfSquares(const double *x, std::size_t n)
+{
+    double2 acc0 = {}, acc1 = {}, acc2 = {}, acc3 = {};
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        double2 a = load2(x + i), b = load2(x + i + 2), c = load2(x + i + 4), d = load2(x + i + 6);
+        acc0 += a * a;
+        acc1 += b * b;
+        acc2 += c * c;
+        acc3 += d * d;
+    }
+    double2 acc = (acc0 + acc1) + (acc2 + acc3);
+    double sum = acc[0] + acc[1];
+    for (; i < n; ++i)
+        sum += x[i] * x[i];
+    return sum;
+}
+
+// sum of x[i] * y[i]
+double sumOfProducts(const double *x, const double *y, std::size_t n)
+{
+    double2 acc0 = {}, acc1 = {}, acc2 = {}, acc3 = {};
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 += load2(x + i) * load2(y + i);
+        acc1 += load2(x + i + 2) * load2(y + i + 2);
+        acc2 += load2(x + i + 4) * load2(y + i + 4);
+        acc3 += load2(x + i + 6) * load2(y + i + 6);
+    }
+    double2 acc = (acc0 + acc1) + (acc2 + acc3);
+    double sum = acc[0] + acc[1];
+    for (; i < n; ++i)
+        sum += x[i] * y[i];
+    return sum;
+}
+
+// sum of x[i]
+double sumOf(const double *x, std::size_t n)
+{
+    double2 acc0 = {}, acc1 = {}, acc2 = {}, acc3 = {};
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        acc0 += load2(x + i);
+        acc1 += load2(x + i + 2);
+        acc2 += load2(x + i + 4);
+        acc3 += load2(x + i + 6);
+    }
+    double2 acc = (acc0 + acc1) + (acc2 + acc3);
+    double sum = acc[0] + acc[1];
+    for (; i < n; ++i)
+        sum += x[i];
+    return sum;
+}
+
+// out[i] = k * x[i] * x[i]
+void scaledSquares(double k, const double *x, double *out, std::size_t n)
+{
+    std::size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+        double2 a = load2(x + i);
+        store2(out + i, k * a * a);
+    }
+    for (; i < n; ++i)
+        out[i] = k * x[i] * x[i];
+}
+
+// out[i] = k * x[i]
+void scaled(double k, const double *x, double *out, std::size_t n)
+{
+    std::size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+        store2(out + i, k * load2(x + i));
+    for (; i < n; ++i)
+        out[i] = k * x[i];
+}
+
+// out[i] = x[i] * y[i]
+void products(const double *x, const double *y, double *out, std::size_t n)
+{
+    std::size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+        store2(out + i, load2(x + i) * load2(y + i));
+    for (; i < n; ++i)
+        out[i] = x[i] * y[i];
+}
+
+// out[i] = 2 * (x[i] + y[i])
+void doubledSums(const double *x, const double *y, double *out, std::size_t n)
+{
+    std::size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+        store2(out + i, 2 * (load2(x + i) + load2(y + i)));
+    for (; i < n; ++i)
+        out[i] = 2 * (x[i] + y[i]);
+}
+
+} // namespace
+
+namespace mk
+{
+
+// pi * r^2 for every circle is pi * (sum of r^2): one multiplication by pi for the whole batch.
+double ShapeBatch::totalArea() const
+{
+    return M_PI * sumOfSquares(radius.data(), radius.size()) + sumOfProducts(width.data(), height.data(), width.size());
+}
+
+double ShapeBatch::totalPerimeter() const
+{
+    return 2 * M_PI * sumOf(radius.data(), radius.size()) +
+           2 * (sumOf(width.data(), width.size()) + sumOf(height.data(), height.size()));
+}
+
+void ShapeBatch::circleAreas(std::span<double> out) const
+{
+    assert(out.size() == radius.size());
+    scaledSquares(M_PI, radius.data(), out.data(), radius.size());
+}
+
+void ShapeBatch::circlePerimeters(std::span<double> out) const
+{
+    assert(out.size() == radius.size());
+    scaled(2 * M_PI, radius.data(), out.data(), radius.size());
+}
+
+void ShapeBatch::rectangleAreas(std::span<double> out) const
+{
+    assert(out.size() == width.size());
+    products(width.data(), height.data(), out.data(), width.size());
+}
+
+void ShapeBatch::rectanglePerimeters(std::span<double> out) const
+{
+    assert(out.size() == width.size());
+    doubledSums(width.data(), height.data(), out.data(), width.size());
+}
+
+} // namespace mk
+
+void shapeBatchBenchmark()
+{
+    MK_PROFILE_FUNCTION();
+    printTitle("Shape Batch Benchmark");
+
+    const int N = 1'000'000;
+    const int RUNS = 10;
+
+    std::mt19937 gen{42};
+    std::uniform_real_distribution<double> dist{0.5, 10.0};
+
+    // the same shapes, once as objects behind base class pointers, once as a batch
+    std::vector<std::unique_ptr<mk::Shape2D>> shapes;
+    mk::ShapeBatch batch;
+    shapes.reserve(N);
+    batch.reserve(N / 2, N / 2);
+    for (int i = 0; i < N; ++i)
+    {
+        if (i % 2 == 0)
+        {
+            mk::Circle c{dist(gen)};
+            batch.add(c);
+            shapes.push_back(std::make_unique<mk::Circle>(c));
+        }
+        else
+        {
+            mk::Rectangle r{dist(gen), dist(gen)};
+            batch.add(r);
+            shapes.push_back(std::make_unique<mk::Rectangle>(r));
+        }
+    }
+
+    cout << N << " shapes, best of " << RUNS << " runs\n";
+
+    double virtualArea = 0, virtualMs = 1e300;
+    for (int run = 0; run < RUNS; ++run)
+    {
+        mk::Stopwatch sw;
+        double total = 0;
+        for (const auto &s : shapes)
+            total += s->area();
+        mk::doNotOptimize(total);
+        virtualMs = std::min(virtualMs, sw.elapsedMs());
+        virtualArea = total;
+    }
+    mk::printTiming("virtual area() over Shape2D*", virtualMs);
+
+    double batchArea = 0, batchMs = 1e300;
+    for (int run = 0; run < RUNS; ++run)
+    {
+        mk::Stopwatch sw;
+        double total = batch.totalArea();
+        mk::doNotOptimize(total);
+        batchMs = std::min(batchMs, sw.elapsedMs());
+        batchArea = total;
+    }
+    mk::printTiming("ShapeBatch::totalArea()", batchMs);
+
+    double perimeterMs = 1e300;
+    for (int run = 0; run < RUNS; ++run)
+    {
+        mk::Stopwatch sw;
+        mk::doNotOptimize(batch.totalPerimeter());
+        perimeterMs = std::min(perimeterMs, sw.elapsedMs());
+    }
+    mk::printTiming("ShapeBatch::totalPerimeter()", perimeterMs);
+
+    // The sums are added up in a different order, so they may differ in the last digits.
+    cout << "total area: virtual " << virtualArea << ", batch " << batchArea
+         << ", relative difference: " << std::abs(virtualArea - batchArea) / virtualArea << endl;
+}
+
+// Discards everything written to it: draw() prints, and the benchmark should measure the dispatch, not the terminal.
+class NullBuffer : public std::streambuf
+{
+  protected:
+    int overflow(int c) override
+    {
+        return c;
+    }
+
+    std::streamsize xsputn(const char *, std::streamsize n) override
+    {
+        return n;
+    }
+};
+
+template <typename F> static double bestOf(int runs, F f)
+{
+    double best = 1e300;
+    for (int run = 0; run < runs; ++run)
+    {
+        mk::Stopwatch sw;
+        f();
+        best = std::min(best, sw.elapsedMs());
+    }
+    return best;
+}
+
+// CRTP shapes have no common base: generic code over them is a template, instantiated per shape type.
+template <typename S> static double totalArea(const std::vector<S> &shapes)
+{
+    double total = 0;
+    for (const auto &s : shapes)
+        total += s.area();
+    return total;
+}
+
+template <typename S> static void drawAll(std::vector<S> &shapes)
+{
+    for (auto &s : shapes)
+        s.draw();
+}
+
+/*
+The same shapes, in the three dispatch styles:
+    virtual  vector<unique_ptr<Shape2D>>       one heap object and one indirect call per shape
+    CRTP     vector<StaticCircle>, vector<StaticRectangle>   one vector per type, calls are inlined
+    variant  vector<ShapeVariant>              shapes by value, std::visit per shape
+"homogeneous" holds circles only; "mixed" holds circles and rectangles in random order (the CRTP version cannot mix
+them, so it keeps them in one vector per type).
+*/
+struct DispatchSet
+{
+    std::vector<std::unique_ptr<mk::Shape2D>> virtualShapes;
+    std::vector<mk::StaticCircle> crtpCircles;
+    std::vector<mk::StaticRectangle> crtpRectangles;
+    std::vector<mk::ShapeVariant> variants;
+};
+
+static DispatchSet makeDispatchSet(int n, bool mixed)
+{
+    std::mt19937 gen{7};
+    std::uniform_real_distribution<double> dist{0.5, 10.0};
+    std::bernoulli_distribution isCircle{mixed ? 0.5 : 1.0};
+
+    DispatchSet set;
+    for (int i = 0; i < n; ++i)
+    {
+        if (isCircle(gen))
+        {
+            double r = dist(gen);
+            set.virtualShapes.push_back(std::make_unique<mk::Circle>(r));
+            set.crtpCircles.emplace_back(r);
+            set.variants.emplace_back(mk::Circle{r});
+        }
+        else
+        {
+            double w = dist(gen), h = dist(gen);
+            set.virtualShapes.push_back(std::make_unique<mk::Rectangle>(w, h));
+            set.crtpRectangles.emplace_back(w, h);
+            set.variants.emplace_back(mk::Rectangle{w, h});
+        }
+    }
+    return set;
+}
+
+// Every style must compute the very same area and perimeter for the very same shape.
+static bool sameResults(const DispatchSet &set)
+{
+    std::size_t c = 0, r = 0;
+    for (std::size_t i = 0; i < set.variants.size(); ++i)
+    {
+        const mk::Shape2D &v = *set.virtualShapes[i];
+        const mk::ShapeVariant &var = set.variants[i];
+        double crtpArea, crtpPerimeter;
+        if (std::holds_alternative<mk::Circle>(var))
+        {
+            crtpArea = set.crtpCircles[c].area();
+            crtpPerimeter = set.crtpCircles[c++].perimeter();
+        }
+        else
+        {
+            crtpArea = set.crtpRectangles[r].area();
+            crtpPerimeter = set.crtpRectangles[r++].perimeter();
+        }
+        if (v.area() != mk::area(var) || v.area() != crtpArea || v.perimeter() != mk::perimeter(var) ||
+            v.perimeter() != crtpPerimeter)
+            return false;
+    }
+    return true;
+}
+
+static void runDispatch(const std::string &title, DispatchSet &set, int runs)
+{
+    cout << title << ", " << set.variants.size() << " shapes, best of " << runs << " runs\n";
+    cout << "identical results: " << std::boolalpha << sameResults(set) << std::noboolalpha << "\n";
+
+    double t = bestOf(runs, [&] {
+        double total = 0;
+        for (const auto &s : set.virtualShapes)
+            total += s->area();
+        mk::doNotOptimize(total);
+    });
+    mk::printTiming("  area()  virtual", t);
+
+    t = bestOf(runs, [&] { mk::doNotOptimize(totalArea(set.crtpCircles) + totalArea(set.crtpRectangles)); });
+    mk::printTiming("  area()  CRTP", t);
+
+    t = bestOf(runs, [&] {
+        double total = 0;
+        for (const auto &s : set.variants)
+            total += mk::area(s);
+        mk::doNotOptimize(total);
+    });
+    mk::printTiming("  area()  variant", t);
+
+    // draw() writes to cout: send it to nowhere while we measure.
+    NullBuffer nowhere;
+    std::streambuf *coutBuffer = cout.rdbuf(&nowhere);
+
+    double tVirtual = bestOf(runs, [&] {
+        for (auto &s : set.virtualShapes)
+            s->draw();
+    });
+    double tCrtp = bestOf(runs, [&] {
+        drawAll(set.crtpCircles);
+        drawAll(set.crtpRectangles);
+    });
+    double tVariant = bestOf(runs, [&] {
+        for (auto &s : set.variants)
+            mk::draw(s);
+    });
+
+    cout.rdbuf(coutBuffer);
+    mk::printTiming("  draw()  virtual", tVirtual);
+    mk::printTiming("  draw()  CRTP", tCrtp);
+    mk::printTiming("  draw()  variant", tVariant);
+}
+
+void shapeDispatchBenchmark()
+{
+    MK_PROFILE_FUNCTION();
+    printTitle("Shape Dispatch Benchmark");
+
+    const int N = 1'000'000;
+    const int RUNS = 10;
+
+    DispatchSet homogeneous = makeDispatchSet(N, false);
+    runDispatch("homogeneous (circles)", homogeneous, RUNS);
+
+    DispatchSet mixed = makeDispatchSet(N, true);
+    runDispatch("mixed (circles and rectangles)", mixed, RUNS);
+}
@@ -0,0 +1,93 @@
+/* sliding_window.cpp */
+#include "sliding_window.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace mk
+{
+
+void SlidingReadingStats::add(const Reading &r, std::int64_t time)
+{
+    // (key - length, key]: the last length readings, or the last length units of time
+    const std::int64_t key = window.kind == SlidingWindow::Kind::Count ? readings : time;
+    ++readings;
+    maxima.push(key, r.temperature);
+    minima.push(key, r.temperature);
+    sums.push(key, r.temperature);
+
+    const std::int64_t oldest = key - window.length + 1;
+    maxima.evictBefore(oldest);
+    minima.evictBefore(oldest);
+    sums.evictBefore(oldest);
+}
+
+HourStats SlidingReadingStats::stats() const
+{
+    HourStats s;
+    if (sums.empty())
+        return s;
+    s.count = sums.size();
+    s.min = minima.top();
+    s.max = maxima.top();
+    s.sum = sums.aggregate();
+    return s;
+}
+
+void slidingReadingStats(std::span<const Reading> readings, std::size_t window, std::span<HourStats> out)
+{
+    if (out.size() != readings.size())
+        throw std::invalid_argument("slidingReadingStats: out must be as long as readings");
+    SlidingReadingStats stats{SlidingWindow::lastReadings(static_cast<std::int64_t>(window))};
+    for (std::size_t i = 0; i < readings.size(); ++i)
+    {
+        stats.add(readings[i]);
+        out[i] = stats.stats();
+    }
+}
+
+void slidingReadingStats(std::span<const Reading> readings, std::span<const std::int64_t> times,
+                         std::int64_t duration, std::span<HourStats> out)
+{
+    if (out.size() != readings.size() || times.size() != readings.size())
+        throw std::invalid_argument("slidingReadingStats: times and out must be as long as readings");
+    SlidingReadingStats stats{SlidingWindow::lastDuration(duration)};
+    for (std::size_t i = 0; i < readings.size(); ++i)
+    {
+        stats.add(readings[i], times[i]);
+        out[i] = stats.stats();
+    }
+}
+
+// The monotonic window of MonotonicWindow, for a whole array: the queue holds indices into values, in one vector that
+// never needs more than values.size() slots, instead of a deque.
+template <typename Compare>
+static void slidingTop(std::span<const double> values, std::size_t window, std::span<double> out, Compare compare)
+{
+    if (out.size() != values.size())
+        throw std::invalid_argument("slidingMax/slidingMin: out must be as long as values");
+    window = std::max<std::size_t>(window, 1);
+    std::vector<std::size_t> queue(values.size());
+    std::size_t head = 0, tail = 0;
+    for (std::size_t i = 0; i < values.size(); ++i)
+    {
+        while (tail > head && !compare(values[i], values[queue[tail - 1]]))
+            --tail;
+        queue[tail++] = i;
+        if (queue[head] + window <= i)
+            ++head;
+        out[i] = values[queue[head]];
+    }
+}
+
+void slidingMax(std::span<const double> values, std::size_t window, std::span<double> out)
+{
+    slidingTop(values, window, out, std::less<double>{});
+}
+
+void slidingMin(std::span<const double> values, std::size_t window, std::span<double> out)
+{
+    slidingTop(values, window, out, std::greater<double>{});
+}
+
+} // namespace mk
@@ -0,0 +1,213 @@
+/* sliding_window.h */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "readings.h"
+
+/*
+Aggregates over a sliding window: the max, min or mean of the last N readings (a count-based window), or of the
+readings of the last 10 minutes (a time-based window), after every reading.
+
+Rescanning the window for every reading costs O(N) per reading. The two classic structures below cost O(1) amortized:
+
+MonotonicWindow - max (or min) only. It keeps the readings that can still become the maximum: a reading older and
+smaller than another in the window never will, so it is dropped. What is left is decreasing from front to back; the
+front is the maximum, and it leaves when it falls out of the window. Every reading enters and leaves once.
+
+TwoStackWindow - any associative operation (sum, min, max, a HourStats merge, ...), no inverse needed. New readings go
+onto a "back" stack that keeps the aggregate of all its elements; old ones leave from a "front" stack in which each
+element keeps the aggregate of itself and everything newer on the stack. When the front stack is empty, the back stack
+is turned over onto it. The window's aggregate is front's top combined with back's aggregate. Every reading is pushed,
+moved and popped once.
+
+Both take a key with every value, increasing: the reading's sequence number for a count-based window, its time for a
+time-based one, in whatever unit the caller counts time (readings only carry their hour, so the time comes with them).
+evictBefore(key) drops everything older than key.
+
+    mk::SlidingReadingStats window{mk::SlidingWindow::lastReadings(1000)};
+    window.add(reading);
+    mk::HourStats s = window.stats(); // count, min, max, mean of the last 1000 readings
+
+The batch functions at the end run a window over a whole array of readings, and write the aggregate after each one.
+*/
+namespace mk
+{
+
+// max with std::less (the default), min with std::greater
+template <typename T, typename Compare = std::less<T>> class MonotonicWindow
+{
+    std::deque<std::pair<std::int64_t, T>> items; // keys increasing, values decreasing (by Compare)
+    Compare compare;
+
+  public:
+    void push(std::int64_t key, const T &value)
+    {
+        // the values that are not above the new one can never be the top again
+        while (!items.empty() && !compare(value, items.back().second))
+            items.pop_back();
+        items.emplace_back(key, value);
+    }
+
+    void evictBefore(std::int64_t key)
+    {
+        while (!items.empty() && items.front().first < key)
+            items.pop_front();
+    }
+
+    bool empty() const
+    {
+        return items.empty();
+    }
+
+    // the max (or min) of the window; it must not be empty
+    const T &top() const
+    {
+        return items.front().second;
+    }
+};
+
+// Combine(a, b) must be associative; a is the older part of the window, b the newer.
+template <typename T, typename Combine> class TwoStackWindow
+{
+    struct Entry
+    {
+        std::int64_t key;
+        T value;
+        T aggregate; // front stack: of this entry and all newer ones on the stack
+    };
+
+    std::vector<Entry> front; // the oldest on top (at the back of the vector)
+    std::vector<Entry> back;  // the newest on top
+    T backAggregate{};
+    Combine combine;
+
+    // turn back over onto front, newest first, so that the oldest ends up on top
+    void flip()
+    {
+        for (auto it = back.rbegin(); it != back.rend(); ++it)
+        {
+            it->aggregate = front.empty() ? it->value : combine(it->value, front.back().aggregate);
+            front.push_back(std::move(*it));
+        }
+        back.clear();
+    }
+
+  public:
+    explicit TwoStackWindow(Combine combine = Combine{}) : combine(std::move(combine))
+    {
+    }
+
+    void push(std::int64_t key, T value)
+    {
+        backAggregate = back.empty() ? value : combine(backAggregate, value);
+        back.push_back({key, std::move(value), T{}});
+    }
+
+    // removes the oldest; the window must not be empty
+    void pop()
+    {
+        if (front.empty())
+            flip();
+        front.pop_back();
+    }
+
+    void evictBefore(std::int64_t key)
+    {
+        while (!empty() && oldestKey() < key)
+            pop();
+    }
+
+    bool empty() const
+    {
+        return front.empty() && back.empty();
+    }
+
+    std::size_t size() const
+    {
+        return front.size() + back.size();
+    }
+
+    std::int64_t oldestKey() const
+    {
+        return front.empty() ? back.front().key : front.back().key;
+    }
+
+    // the aggregate of the whole window, oldest to newest; it must not be empty
+    T aggregate() const
+    {
+        if (front.empty())
+            return backAggregate;
+        if (back.empty())
+            return front.back().aggregate;
+        return combine(front.back().aggregate, backAggregate);
+    }
+};
+
+struct SlidingWindow
+{
+    enum class Kind
+    {
+        Count, // the last length readings
+        Time   // the readings with time in (now - length, now]
+    };
+    Kind kind;
+    std::int64_t length;
+
+    static SlidingWindow lastReadings(std::int64_t n)
+    {
+        return {Kind::Count, n};
+    }
+
+    static SlidingWindow lastDuration(std::int64_t duration)
+    {
+        return {Kind::Time, duration};
+    }
+};
+
+// count, min, max and mean of the temperatures in a window, after every reading
+class SlidingReadingStats
+{
+    struct Sum
+    {
+        double operator()(double a, double b) const
+        {
+            return a + b;
+        }
+    };
+
+    SlidingWindow window;
+    std::int64_t readings = 0;
+    MonotonicWindow<double> maxima;
+    MonotonicWindow<double, std::greater<double>> minima;
+    TwoStackWindow<double, Sum> sums; // summed oldest to newest, without the drift of a running sum that subtracts
+
+  public:
+    explicit SlidingReadingStats(SlidingWindow window) : window(window)
+    {
+    }
+
+    // time is only used by a time-based window; it must not decrease
+    void add(const Reading &r, std::int64_t time = 0);
+
+    // the window's count, min, max and sum (HourStats, so that mean() works); empty before the first reading
+    HourStats stats() const;
+};
+
+// out[i] = the stats of the window ending at readings[i]; out must be as long as readings
+void slidingReadingStats(std::span<const Reading> readings, std::size_t window, std::span<HourStats> out);
+
+// the same for a time-based window: times[i] is the time of readings[i], not decreasing
+void slidingReadingStats(std::span<const Reading> readings, std::span<const std::int64_t> times,
+                         std::int64_t duration, std::span<HourStats> out);
+
+// out[i] = the max (min) of values[i - window + 1 .. i]
+void slidingMax(std::span<const double> values, std::size_t window, std::span<double> out);
+void slidingMin(std::span<const double> values, std::size_t window, std::span<double> out);
+
+} // namespace mk
@@ -0,0 +1,487 @@
+/* small_vector.h */
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+/*
+SmallVector: a vector with a small buffer inside.
+
+A std::vector always keeps its elements on the free store, so even a vector of 3 ints costs an allocation and a free.
+SmallVector<T, N> has room for N elements inside the object itself (on the stack, for a local variable):
+
+    mk::SmallVector<int, 8> v;  // no allocation
+    v.push_back(1);             // still none, up to 8 elements
+    ...                         // the 9th element moves all of them to the free store ("spills")
+
+Beyond N it behaves like std::vector (the capacity doubles). It never goes back to the inline buffer by itself;
+shrink_to_fit() does that when the elements fit again.
+
+Moves do not allocate: a vector on the free store hands over its block; an inline vector moves its elements one by one
+into the inline buffer of the target (which is big enough, as both have the same N). So a moved-from SmallVector is
+empty, and an inline move costs N element moves at most: keep N small. Like the moves of std::vector elements on
+growth, the element moves of a SmallVector should not throw.
+*/
+namespace mk
+{
+
+template <typename T, std::size_t N> class SmallVector
+{
+    static_assert(N > 0, "SmallVector needs room for at least one inline element");
+
+    T *first;              // the elements: the inline buffer, or a block on the free store
+    std::size_t count = 0; // constructed elements
+    std::size_t cap = N;   // room for elements at first
+    alignas(T) std::byte buffer[N * sizeof(T)];
+
+    T *inlineElements()
+    {
+        return reinterpret_cast<T *>(buffer);
+    }
+
+    static T *allocate(std::size_t n)
+    {
+        return std::allocator<T>{}.allocate(n);
+    }
+
+    void deallocate()
+    {
+        if (!isInline())
+            std::allocator<T>{}.deallocate(first, cap);
+    }
+
+    // a new capacity for at least n elements
+    std::size_t grownCapacity(std::size_t n) const
+    {
+        return std::max(n, 2 * cap);
+    }
+
+    // Move the elements to the block at to, with room for newCap elements (newCap >= count), and free the old block.
+    void relocate(T *to, std::size_t newCap)
+    {
+        std::uninitialized_move(first, first + count, to);
+        std::destroy(first, first + count);
+        deallocate();
+        first = to;
+        cap = newCap;
+    }
+
+    // Take the elements of other, which is left empty; *this must be empty, with no block of its own.
+    void stealFrom(SmallVector &other) noexcept(std::is_nothrow_move_constructible_v<T>)
+    {
+        if (other.isInline())
+        {
+            std::uninitialized_move(other.first, other.first + other.count, first);
+            count = other.count;
+            other.clear();
+        }
+        else
+        {
+            first = std::exchange(other.first, other.inlineElements());
+            cap = std::exchange(other.cap, N);
+            count = std::exchange(other.count, 0);
+        }
+    }
+
+  public:
+    using value_type = T;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using reference = T &;
+    using const_reference = const T &;
+    using pointer = T *;
+    using const_pointer = const T *;
+    using iterator = T *;
+    using const_iterator = const T *;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    static constexpr std::size_t inlineCapacity = N;
+
+    SmallVector() : first{inlineElements()}
+    {
+    }
+
+    explicit SmallVector(std::size_t n) : SmallVector()
+    {
+        resize(n);
+    }
+
+    SmallVector(std::size_t n, const T &value) : SmallVector()
+    {
+        assign(n, value);
+    }
+
+    SmallVector(std::initializer_list<T> values) : SmallVector()
+    {
+        assign(values.begin(), values.end());
+    }
+
+    template <std::input_iterator It> SmallVector(It from, It to) : SmallVector()
+    {
+        assign(from, to);
+    }
+
+    SmallVector(const SmallVector &other) : SmallVector()
+    {
+        assign(other.begin(), other.end());
+    }
+
+    SmallVector(SmallVector &&other) noexcept(std::is_nothrow_move_constructible_v<T>) : SmallVector()
+    {
+        stealFrom(other);
+    }
+
+    SmallVector &operator=(const SmallVector &other)
+    {
+        if (this != &other)
+            assign(other.begin(), other.end());
+        return *this;
+    }
+
+    SmallVector &operator=(SmallVector &&other) noexcept(std::is_nothrow_move_constructible_v<T>)
+    {
+        if (this == &other)
+            return *this;
+        clear();
+        if (other.isInline() && !isInline())
+        {
+            // keep our block: it is big enough, as other holds N elements at most
+            std::uninitialized_move(other.first, other.first + other.count, first);
+            count = other.count;
+            other.clear();
+        }
+        else
+        {
+            deallocate();
+            first = inlineElements();
+            cap = N;
+            stealFrom(other);
+        }
+        return *this;
+    }
+
+    SmallVector &operator=(std::initializer_list<T> values)
+    {
+        assign(values.begin(), values.end());
+        return *this;
+    }
+
+    ~SmallVector()
+    {
+        std::destroy(first, first + count);
+        deallocate();
+    }
+
+    void assign(std::size_t n, const T &value)
+    {
+        clear();
+        reserve(n);
+        std::uninitialized_fill_n(first, n, value);
+        count = n;
+    }
+
+    template <std::input_iterator It> void assign(It from, It to)
+    {
+        clear();
+        if constexpr (std::forward_iterator<It>)
+            reserve(static_cast<std::size_t>(std::distance(from, to)));
+        for (; from != to; ++from)
+            emplace_back(*from);
+    }
+
+    // true while the elements live in the inline buffer
+    bool isInline() const
+    {
+        return first == reinterpret_cast<const T *>(buffer);
+    }
+
+    // element access
+
+    T &operator[](std::size_t i)
+    {
+        assert(i < count);
+        return first[i];
+    }
+    const T &operator[](std::size_t i) const
+    {
+        assert(i < count);
+        return first[i];
+    }
+
+    T &at(std::size_t i)
+    {
+        if (i >= count)
+            throw std::out_of_range("SmallVector::at");
+        return first[i];
+    }
+    const T &at(std::size_t i) const
+    {
+        if (i >= count)
+            throw std::out_of_range("SmallVector::at");
+        return first[i];
+    }
+
+    T &front()
+    {
+        assert(count > 0);
+        return first[0];
+    }
+    const T &front() const
+    {
+        assert(count > 0);
+        return first[0];
+    }
+    T &back()
+    {
+        assert(count > 0);
+        return first[count - 1];
+    }
+    const T &back() const
+    {
+        assert(count > 0);
+        return first[count - 1];
+    }
+
+    T *data()
+    {
+        return first;
+    }
+    const T *data() const
+    {
+        return first;
+    }
+
+    // iterators
+
+    iterator begin()
+    {
+        return first;
+    }
+    iterator end()
+    {
+        return first + count;
+    }
+    const_iterator begin() const
+    {
+        return first;
+    }
+    const_iterator end() const
+    {
+        return first + count;
+    }
+    const_iterator cbegin() const
+    {
+        return first;
+    }
+    const_iterator cend() const
+    {
+        return first + count;
+    }
+    reverse_iterator rbegin()
+    {
+        return reverse_iterator{end()};
+    }
+    reverse_iterator rend()
+    {
+        return reverse_iterator{begin()};
+    }
+    const_reverse_iterator rbegin() const
+    {
+        return const_reverse_iterator{end()};
+    }
+    const_reverse_iterator rend() const
+    {
+        return const_reverse_iterator{begin()};
+    }
+
+    // capacity
+
+    bool empty() const
+    {
+        return count == 0;
+    }
+    std::size_t size() const
+    {
+        return count;
+    }
+    std::size_t capacity() const
+    {
+        return cap;
+    }
+
+    void reserve(std::size_t n)
+    {
+        if (n > cap)
+            relocate(allocate(n), n);
+    }
+
+    // back to the inline buffer if the elements fit, otherwise to a block of exactly size() elements
+    void shrink_to_fit()
+    {
+        if (isInline() || count == cap)
+            return;
+        if (count <= N)
+        {
+            T *block = first;
+            std::size_t blockCap = cap;
+            std::uninitialized_move(block, block + count, inlineElements());
+            std::destroy(block, block + count);
+            std::allocator<T>{}.deallocate(block, blockCap);
+            first = inlineElements();
+            cap = N;
+        }
+        else
+            relocate(allocate(count), count);
+    }
+
+    // modifiers
+
+    void clear()
+    {
+        std::destroy(first, first + count);
+        count = 0;
+    }
+
+    template <typename... Args> T &emplace_back(Args &&...args)
+    {
+        if (count == cap)
+        {
+            // Construct the new element in the new block before the old elements move: args may refer to one of them.
+            std::size_t newCap = grownCapacity(count + 1);
+            T *block = allocate(newCap);
+            try
+            {
+                std::construct_at(block + count, std::forward<Args>(args)...);
+            }
+            catch (...)
+            {
+                std::allocator<T>{}.deallocate(block, newCap);
+                throw;
+            }
+            relocate(block, newCap);
+        }
+        else
+            std::construct_at(first + count, std::forward<Args>(args)...);
+        return first[count++];
+    }
+
+    void push_back(const T &value)
+    {
+        emplace_back(value);
+    }
+    void push_back(T &&value)
+    {
+        emplace_back(std::move(value));
+    }
+
+    void pop_back()
+    {
+        assert(count > 0);
+        std::destroy_at(first + --count);
+    }
+
+    void resize(std::size_t n)
+    {
+        if (n < count)
+            std::destroy(first + n, first + count);
+        else
+        {
+            if (n > cap)
+                reserve(grownCapacity(n));
+            std::uninitialized_value_construct(first + count, first + n);
+        }
+        count = n;
+    }
+
+    void resize(std::size_t n, const T &value)
+    {
+        if (n < count)
+            std::destroy(first + n, first + count);
+        else
+        {
+            if (n > cap)
+            {
+                T copy = value; // value may be one of the elements
+                reserve(grownCapacity(n));
+                std::uninitialized_fill(first + count, first + n, copy);
+            }
+            else
+                std::uninitialized_fill(first + count, first + n, value);
+        }
+        count = n;
+    }
+
+    // insert value before pos; returns an iterator to the new element
+    template <typename... Args> iterator emplace(const_iterator pos, Args &&...args)
+    {
+        std::size_t index = static_cast<std::size_t>(pos - first);
+        assert(index <= count);
+        T value(std::forward<Args>(args)...); // before the elements move: args may refer to one of them
+        if (index == count)
+        {
+            emplace_back(std::move(value));
+            return first + index;
+        }
+        emplace_back(std::move(back()));
+        std::move_backward(first + index, first + count - 2, first + count - 1);
+        first[index] = std::move(value);
+        return first + index;
+    }
+
+    iterator insert(const_iterator pos, const T &value)
+    {
+        return emplace(pos, value);
+    }
+    iterator insert(const_iterator pos, T &&value)
+    {
+        return emplace(pos, std::move(value));
+    }
+
+    iterator erase(const_iterator pos)
+    {
+        return erase(pos, pos + 1);
+    }
+
+    // erase [from, to); returns an iterator to the element after the erased ones
+    iterator erase(const_iterator from, const_iterator to)
+    {
+        T *f = first + (from - first);
+        T *t = first + (to - first);
+        assert(first <= f && f <= t && t <= first + count);
+        T *newEnd = std::move(t, first + count, f);
+        std::destroy(newEnd, first + count);
+        count = static_cast<std::size_t>(newEnd - first);
+        return f;
+    }
+
+    void swap(SmallVector &other) noexcept(std::is_nothrow_move_constructible_v<T>)
+    {
+        SmallVector tmp = std::move(other);
+        other = std::move(*this);
+        *this = std::move(tmp);
+    }
+
+    friend void swap(SmallVector &lhs, SmallVector &rhs) noexcept(noexcept(lhs.swap(rhs)))
+    {
+        lhs.swap(rhs);
+    }
+
+    friend bool operator==(const SmallVector &lhs, const SmallVector &rhs)
+    {
+        return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+    }
+
+    friend auto operator<=>(const SmallVector &lhs, const SmallVector &rhs)
+    {
+        return std::lexicographical_compare_three_way(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+    }
+};
+
+} // namespace mk
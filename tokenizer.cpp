@@ -0,0 +1,234 @@
+/* tokenizer.cpp */
+#include "tokenizer.h"
+
+#include <algorithm>
+#include <bit>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace mk
+{
+
+namespace
+{
+
+constexpr std::string_view Whitespace = " \t\n\v\f\r";
+
+#if defined(__AVX2__) || defined(__SSE2__)
+
+#if defined(__AVX2__)
+using Bytes = __m256i;
+inline Bytes load(const char *p)
+{
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+}
+inline Bytes splat(char c)
+{
+    return _mm256_set1_epi8(c);
+}
+inline Bytes equal(Bytes a, Bytes b)
+{
+    return _mm256_cmpeq_epi8(a, b);
+}
+inline Bytes either(Bytes a, Bytes b)
+{
+    return _mm256_or_si256(a, b);
+}
+inline Bytes minimum(Bytes a, Bytes b)
+{
+    return _mm256_min_epu8(a, b);
+}
+inline Bytes minus(Bytes a, Bytes b)
+{
+    return _mm256_sub_epi8(a, b);
+}
+inline std::uint32_t bits(Bytes a)
+{
+    return static_cast<std::uint32_t>(_mm256_movemask_epi8(a));
+}
+#else
+// 32 bytes as two SSE2 registers
+struct Bytes
+{
+    __m128i low, high;
+};
+inline Bytes load(const char *p)
+{
+    return {_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16))};
+}
+inline Bytes splat(char c)
+{
+    return {_mm_set1_epi8(c), _mm_set1_epi8(c)};
+}
+inline Bytes equal(Bytes a, Bytes b)
+{
+    return {_mm_cmpeq_epi8(a.low, b.low), _mm_cmpeq_epi8(a.high, b.high)};
+}
+inline Bytes either(Bytes a, Bytes b)
+{
+    return {_mm_or_si128(a.low, b.low), _mm_or_si128(a.high, b.high)};
+}
+inline Bytes minimum(Bytes a, Bytes b)
+{
+    return {_mm_min_epu8(a.low, b.low), _mm_min_epu8(a.high, b.high)};
+}
+inline Bytes minus(Bytes a, Bytes b)
+{
+    return {_mm_sub_epi8(a.low, b.low), _mm_sub_epi8(a.high, b.high)};
+}
+inline std::uint32_t bits(Bytes a)
+{
+    return static_cast<std::uint32_t>(_mm_movemask_epi8(a.low)) |
+           static_cast<std::uint32_t>(_mm_movemask_epi8(a.high)) << 16;
+}
+#endif
+
+#define MK_TOKENIZER_VECTORS 1
+#endif
+
+} // namespace
+
+Delimiters::Delimiters(std::string_view chars)
+{
+    for (char c : chars)
+    {
+        const auto b = static_cast<unsigned char>(c);
+        if (contains(c))
+            continue;
+        members[b >> 6] |= std::uint64_t{1} << (b & 63);
+        if (count < list.size())
+            list[count] = c;
+        ++count;
+    }
+    whitespace = count == Whitespace.size();
+    for (char c : Whitespace)
+        whitespace = whitespace && contains(c);
+}
+
+const Delimiters &Delimiters::spaces()
+{
+    static const Delimiters whitespace{Whitespace};
+    return whitespace;
+}
+
+/*
+Whitespace is a blank, or one of the five consecutive codes \t (9) ... \r (13): byte - 9 is at most 4, unsigned, which
+is a min and a compare. Other sets compare with each of their characters; a set of more than 16, and the bytes at the
+end of the text, are looked up byte by byte.
+*/
+namespace
+{
+
+std::uint32_t scalarMask(const Delimiters &delimiters, const char *p, std::size_t n)
+{
+    std::uint32_t result = n >= 32 ? 0 : ~std::uint32_t{0} << n; // the padding
+    for (std::size_t i = 0; i < n; ++i)
+        result |= static_cast<std::uint32_t>(delimiters.contains(p[i])) << i;
+    return result;
+}
+
+#ifdef MK_TOKENIZER_VECTORS
+std::uint32_t whitespaceMask(const char *p)
+{
+    const Bytes bytes = load(p);
+    const Bytes fromTab = minus(bytes, splat('\t'));
+    const Bytes control = equal(minimum(fromTab, splat(4)), fromTab);
+    return bits(either(control, equal(bytes, splat(' '))));
+}
+
+std::uint32_t listMask(const char *p, const char *list, unsigned count)
+{
+    const Bytes bytes = load(p);
+    Bytes found = equal(bytes, splat(list[0]));
+    for (unsigned i = 1; i < count; ++i)
+        found = either(found, equal(bytes, splat(list[i])));
+    return bits(found);
+}
+#endif
+
+/*
+A block of 32 bytes at a time. The boundaries - a non-delimiter after a delimiter (a start), a delimiter after a
+non-delimiter (an end); "after" reaches back into the block before - alternate, so they are taken in pairs: the lowest
+bit is a start, the next one its end. Only a token left open by the block before starts with an end.
+*/
+template <typename Mask>
+std::size_t tokenizeBlocks(std::string_view &text, std::span<std::string_view> out, Mask mask)
+{
+    const char *p = text.data();
+    const std::size_t size = text.size();
+    std::string_view *o = out.data();
+    std::string_view *const full = o + out.size();
+    bool inToken = false;
+    std::size_t tokenStart = 0;
+
+    for (std::size_t block = 0; block < size && o != full; block += 32)
+    {
+        const std::uint32_t delimiter = mask(p + block, std::min<std::size_t>(32, size - block));
+        std::uint32_t boundaries = delimiter ^ ((delimiter << 1) | (inToken ? 0u : 1u));
+        if (inToken && boundaries != 0)
+        {
+            *o++ = {p + tokenStart, block + static_cast<unsigned>(std::countr_zero(boundaries)) - tokenStart};
+            boundaries &= boundaries - 1;
+            inToken = false;
+        }
+        while (boundaries != 0 && o != full)
+        {
+            const unsigned start = static_cast<unsigned>(std::countr_zero(boundaries));
+            boundaries &= boundaries - 1;
+            if (boundaries == 0)
+            {
+                inToken = true; // the last token goes on into the next block
+                tokenStart = block + start;
+                break;
+            }
+            const unsigned end = static_cast<unsigned>(std::countr_zero(boundaries));
+            boundaries &= boundaries - 1;
+            *o++ = {p + block + start, end - start};
+        }
+    }
+    if (inToken && o != full) // the text ends in the middle of a token, at a block boundary
+        *o++ = {p + tokenStart, size - tokenStart};
+
+    const std::size_t n = static_cast<std::size_t>(o - out.data());
+    if (n == 0)
+        text = {};
+    else
+        text.remove_prefix(static_cast<std::size_t>(out[n - 1].data() + out[n - 1].size() - p));
+    return n;
+}
+
+} // namespace
+
+std::uint32_t Delimiters::mask(const char *p, std::size_t n) const
+{
+#ifdef MK_TOKENIZER_VECTORS
+    if (n == 32 && whitespace)
+        return whitespaceMask(p);
+    if (n == 32 && count > 0 && count <= list.size())
+        return listMask(p, list.data(), count);
+#endif
+    return scalarMask(*this, p, n);
+}
+
+// the classifier is chosen once, so that the loop over the blocks has it inlined
+std::size_t tokenize(std::string_view &text, std::span<std::string_view> out, const Delimiters &delimiters)
+{
+#ifdef MK_TOKENIZER_VECTORS
+    if (delimiters.whitespace)
+        return tokenizeBlocks(text, out, [&](const char *p, std::size_t n) {
+            return n == 32 ? whitespaceMask(p) : scalarMask(delimiters, p, n);
+        });
+    if (delimiters.count > 0 && delimiters.count <= delimiters.list.size())
+        return tokenizeBlocks(text, out, [&](const char *p, std::size_t n) {
+            return n == 32 ? listMask(p, delimiters.list.data(), delimiters.count) : scalarMask(delimiters, p, n);
+        });
+#endif
+    return tokenizeBlocks(text, out, [&](const char *p, std::size_t n) { return scalarMask(delimiters, p, n); });
+}
+
+} // namespace mk
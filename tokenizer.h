@@ -0,0 +1,142 @@
+/* tokenizer.h */
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <string_view>
+
+/*
+Splitting text into words, without copying them.
+
+    std::istringstream ss{sentence};
+    for (string word; ss >> word;)
+        words.push_back(word);
+
+goes through the stream's locale for every character (is it a space?), and copies every word into a string of its own
+- an allocation for every word longer than the string's small buffer. The words are already there, in the text: a
+std::string_view of each is enough, as long as the text lives.
+
+The delimiters are found 32 bytes at a time: a vector compare of 32 bytes (AVX2, or two SSE2 halves) gives a 32-bit
+mask with a bit set for each delimiter, and the words begin and end where the mask changes from 1 to 0 and back.
+Finding those changes is bit arithmetic on the mask, and the positions of the changes are written out a few at a time
+(count trailing zeros, clear the lowest bit), with no branch per character and hardly one per word.
+
+    for (std::string_view word : mk::tokens(sentence))                // a lazy range: one word at a time
+        ...
+    for (std::string_view field : mk::tokens(line, mk::Delimiters{",;"})) // other delimiters
+        ...
+
+    std::array<std::string_view, 256> batch;                          // the batch form: as many words as fit
+    for (std::size_t n; (n = mk::tokenize(text, batch)) > 0;)          // text is advanced past them
+        ...
+
+Whitespace is what >> skips in the "C" locale: blank, \t, \n, \v, \f and \r. The words are never empty: delimiters next
+to each other separate nothing.
+*/
+namespace mk
+{
+
+class Delimiters
+{
+    std::array<std::uint64_t, 4> members{}; // a bit per byte value
+    std::array<char, 16> list{};            // the same, for the vector compares, when there are at most 16
+    unsigned count = 0;                     // in list; more than 16: the bits only
+    bool whitespace = false;                // exactly the six whitespace characters: compared by range
+
+  public:
+    // every character of chars is a delimiter
+    explicit Delimiters(std::string_view chars);
+
+    static const Delimiters &spaces();
+
+    bool contains(char c) const
+    {
+        const auto b = static_cast<unsigned char>(c);
+        return (members[b >> 6] >> (b & 63)) & 1;
+    }
+
+    // Bit i of the result is set if p[i] is a delimiter, for i < n (n <= 32); the bits from n on are set as well.
+    std::uint32_t mask(const char *p, std::size_t n) const;
+
+    friend std::size_t tokenize(std::string_view &text, std::span<std::string_view> out, const Delimiters &delimiters);
+};
+
+// Fills out with the next tokens of text (as many as there are, or as fit) and returns their number. text is advanced
+// past them, so that the next call goes on where this one stopped; 0 means that the text has no tokens left.
+std::size_t tokenize(std::string_view &text, std::span<std::string_view> out,
+                     const Delimiters &delimiters = Delimiters::spaces());
+
+class TokenRange
+{
+    std::string_view text;
+    Delimiters delimiters; // a copy: the range may outlive the temporary it was made from
+
+  public:
+    // takes the tokens from tokenize() a few dozen at a time
+    class iterator
+    {
+        std::string_view rest;
+        const Delimiters *delimiters;
+        std::array<std::string_view, 32> buffer;
+        std::size_t count = 0, index = 0;
+
+      public:
+        using iterator_concept = std::input_iterator_tag;
+        using value_type = std::string_view;
+        using difference_type = std::ptrdiff_t;
+
+        iterator(std::string_view text, const Delimiters &delimiters) : rest(text), delimiters(&delimiters)
+        {
+            count = tokenize(rest, buffer, delimiters);
+        }
+
+        std::string_view operator*() const
+        {
+            return buffer[index];
+        }
+
+        iterator &operator++()
+        {
+            if (++index == count)
+            {
+                count = tokenize(rest, buffer, *delimiters);
+                index = 0;
+            }
+            return *this;
+        }
+
+        void operator++(int)
+        {
+            ++*this;
+        }
+
+        friend bool operator==(const iterator &it, std::default_sentinel_t)
+        {
+            return it.count == 0;
+        }
+    };
+
+    TokenRange(std::string_view text, const Delimiters &delimiters) : text(text), delimiters(delimiters)
+    {
+    }
+
+    iterator begin() const
+    {
+        return {text, delimiters};
+    }
+
+    std::default_sentinel_t end() const
+    {
+        return {};
+    }
+};
+
+// the words of text, one at a time, as views into text
+inline TokenRange tokens(std::string_view text, const Delimiters &delimiters = Delimiters::spaces())
+{
+    return {text, delimiters};
+}
+
+} // namespace mk
@@ -0,0 +1,248 @@
+/* word_count.cpp */
+#include "word_count.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <latch>
+#include <thread>
+
+namespace mk
+{
+
+namespace
+{
+
+constexpr std::size_t WordCountChunkSize = std::size_t{1} << 20;
+
+constexpr std::uint64_t K0 = 0x9E3779B97F4A7C15ull;
+constexpr std::uint64_t K1 = 0xBF58476D1CE4E5B9ull;
+constexpr std::uint64_t K2 = 0x94D049BB133111EBull;
+
+std::uint64_t load64(const char *p)
+{
+    std::uint64_t v;
+    std::memcpy(&v, p, sizeof v);
+    return v;
+}
+
+std::uint64_t mix(std::uint64_t h, std::uint64_t v)
+{
+    h = (h ^ v) * K1;
+    return h ^ (h >> 31);
+}
+
+std::uint64_t finish(std::uint64_t h)
+{
+    h *= K2;
+    return h ^ (h >> 29);
+}
+
+// The shard of a word: bits of its hash above the ones a table of fewer than 2^40 slots uses to find its slot.
+std::size_t shardOf(std::uint64_t hash, std::size_t shards)
+{
+    return static_cast<std::size_t>(hash >> 40) & (shards - 1);
+}
+
+// the start of chunk c: moved forward to the start of a word, so that no word is split between two chunks
+std::size_t chunkStart(std::string_view text, std::size_t c, const Delimiters &delimiters)
+{
+    std::size_t at = std::min(text.size(), c * WordCountChunkSize);
+    while (at > 0 && at < text.size() && !delimiters.contains(text[at - 1]))
+        ++at;
+    return at;
+}
+
+// wordHead(word), for a word of text that ends at end: an 8-byte load and a mask, unless the load would read past end
+std::uint64_t headWithin(std::string_view word, const char *end)
+{
+    if (end - word.data() < 8)
+        return wordHead(word);
+    const std::uint64_t mask = word.size() >= 8 ? ~std::uint64_t{0} : (std::uint64_t{1} << 8 * word.size()) - 1;
+    return load64(word.data()) & mask;
+}
+
+// hashWord(word, head), for a word of text that ends at end. A text has words of every length, and a branch on it is
+// mispredicted for many of them: up to 16 bytes, both steps are taken, and the length picks the result.
+std::uint64_t hashWithin(std::string_view word, std::uint64_t head, const char *end)
+{
+    const std::size_t n = word.size();
+    if (n > 16 || end - word.data() < 8)
+        return hashWord(word, head);
+    const std::uint64_t h = mix((n + 1) * K0, head);
+    const std::uint64_t last = load64(word.data() + (n > 8 ? n - 8 : 0));
+    return finish(n > 8 ? mix(h, last) : h);
+}
+
+} // namespace
+
+/*
+The words are short: up to 8 bytes are one step, wordHead(); longer ones 8 bytes at a time, the last 8 overlapping the
+ones before. The length goes into the seed, so that the overlaps cannot make two words of different lengths the same.
+*/
+std::uint64_t hashWord(std::string_view word, std::uint64_t head)
+{
+    const char *p = word.data();
+    std::size_t n = word.size();
+    std::uint64_t h = (n + 1) * K0;
+    if (n > 8)
+    {
+        for (; n > 8; p += 8, n -= 8)
+            h = mix(h, load64(p));
+        h = mix(h, load64(p + n - 8));
+    }
+    else
+        h = mix(h, head);
+    return finish(h);
+}
+
+WordTable::WordTable(std::size_t capacity)
+    : slots(std::bit_ceil(std::max<std::size_t>(capacity, 2))), mask(slots.size() - 1)
+{
+}
+
+// twice the slots; the words move with the hash they have
+void WordTable::grow()
+{
+    std::vector<Slot> old(slots.size() * 2);
+    old.swap(slots);
+    mask = slots.size() - 1;
+    for (const Slot &slot : old)
+    {
+        if (slot.data == nullptr)
+            continue;
+        std::size_t i = slot.hash & mask;
+        while (slots[i].data != nullptr)
+            i = (i + 1) & mask;
+        slots[i] = slot;
+    }
+}
+
+std::uint64_t WordTable::count(std::string_view word, std::uint64_t hash) const
+{
+    for (std::size_t i = hash & mask;; i = (i + 1) & mask)
+    {
+        const Slot &slot = slots[i];
+        if (slot.data == nullptr)
+            return 0;
+        if (same(slot, word, hash, wordHead(word)))
+            return slot.count;
+    }
+}
+
+std::size_t WordFrequencies::distinct() const
+{
+    std::size_t n = 0;
+    for (const WordTable &shard : shards)
+        n += shard.size();
+    return n;
+}
+
+std::uint64_t WordFrequencies::count(std::string_view word) const
+{
+    if (shards.empty())
+        return 0;
+    const std::uint64_t hash = hashWord(word);
+    return shards[shardOf(hash, shards.size())].count(word, hash);
+}
+
+std::vector<WordCount> WordFrequencies::top(std::size_t n) const
+{
+    std::vector<WordCount> all;
+    all.reserve(distinct());
+    for (const WordTable &shard : shards)
+        shard.forEach([&](std::string_view word, std::uint64_t, std::uint64_t, std::uint64_t count) {
+            all.push_back({word, count});
+        });
+
+    n = std::min(n, all.size());
+    std::partial_sort(all.begin(), all.begin() + static_cast<std::ptrdiff_t>(n), all.end(),
+                      [](const WordCount &a, const WordCount &b) {
+                          return a.count != b.count ? a.count > b.count : a.word < b.word;
+                      });
+    all.resize(n);
+    return all;
+}
+
+/*
+Two phases, on the same threads:
+    count   every thread takes the next chunk from a shared counter, and counts its words into tables of its own, one
+            per shard (as many shards as threads, rounded up to a power of two)
+    merge   every thread takes the next shard, and adds that shard of the other threads to the first thread's, with the
+            hashes already in the slots
+With one thread there is one shard, and nothing to merge.
+*/
+WordFrequencies countWords(std::string_view text, unsigned threads, const Delimiters &delimiters)
+{
+    const std::size_t chunks = std::max<std::size_t>(1, (text.size() + WordCountChunkSize - 1) / WordCountChunkSize);
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<std::size_t>(threads, chunks));
+    const std::size_t shardCount = std::bit_ceil(std::size_t{threads});
+
+    std::vector<std::vector<WordTable>> local(threads, std::vector<WordTable>(shardCount));
+    std::vector<std::uint64_t> localWords(threads);
+    std::atomic<std::size_t> nextChunk{0}, nextShard{0};
+    const char *const end = text.data() + text.size();
+
+    auto countChunks = [&](unsigned t) {
+        std::vector<WordTable> &tables = local[t];
+        std::array<std::string_view, 256> batch;
+        std::array<std::uint64_t, 256> hashes, heads;
+        std::uint64_t words = 0;
+        for (std::size_t c; (c = nextChunk.fetch_add(1, std::memory_order_relaxed)) < chunks;)
+        {
+            const std::size_t begin = chunkStart(text, c, delimiters);
+            std::string_view rest = text.substr(begin, chunkStart(text, c + 1, delimiters) - begin);
+            for (std::size_t n; (n = tokenize(rest, batch, delimiters)) > 0;)
+            {
+                // the hashes of the batch first, and the slots fetched while the other words are hashed
+                words += n;
+                for (std::size_t i = 0; i < n; ++i)
+                {
+                    heads[i] = headWithin(batch[i], end);
+                    hashes[i] = hashWithin(batch[i], heads[i], end);
+                    tables[shardOf(hashes[i], shardCount)].prefetch(hashes[i]);
+                }
+                for (std::size_t i = 0; i < n; ++i)
+                    tables[shardOf(hashes[i], shardCount)].add(batch[i], hashes[i], heads[i], 1);
+            }
+        }
+        localWords[t] = words;
+    };
+    auto mergeShards = [&] {
+        for (std::size_t s; (s = nextShard.fetch_add(1, std::memory_order_relaxed)) < shardCount;)
+        {
+            WordTable &merged = local[0][s];
+            for (unsigned t = 1; t < threads; ++t)
+                local[t][s].forEach([&](std::string_view word, std::uint64_t hash, std::uint64_t head,
+                                        std::uint64_t count) { merged.add(word, hash, head, count); });
+        }
+    };
+
+    if (threads == 1)
+        countChunks(0);
+    else
+    {
+        std::latch counted{threads};
+        std::vector<std::thread> workers;
+        workers.reserve(threads);
+        for (unsigned t = 0; t < threads; ++t)
+            workers.emplace_back([&, t] {
+                countChunks(t);
+                counted.arrive_and_wait(); // the merge reads the tables of all threads
+                mergeShards();
+            });
+        for (auto &w : workers)
+            w.join();
+    }
+
+    WordFrequencies result;
+    result.shards = std::move(local[0]);
+    for (std::uint64_t words : localWords)
+        result.words += words;
+    return result;
+}
+
+} // namespace mk
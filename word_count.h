@@ -0,0 +1,194 @@
+/* word_count.h */
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#include "tokenizer.h"
+
+/*
+Counting the words of a text - of a corpus of several GB.
+
+    std::map<string, size_t> counts;
+    for (string word; in >> word;)
+        ++counts[word];
+
+pays for every word with a string (an allocation, unless the word fits the small buffer) and about log2(distinct words)
+string compares down the tree, each a cache miss on a node of its own; every new word is a node allocation more.
+
+countWords() keeps a std::string_view into the text instead of a string, and counts in a flat hash table: one vector
+of slots, probed linearly, so that a lookup is a hash and mostly one cache line. The slot keeps bits of the hash and the
+first 8 bytes of the word, so that other words are told apart, and words of up to 8 bytes are recognized, without going
+back to the text. The hash is computed once per word and kept: the table grows, and the tables are merged, without
+hashing again. The words are hashed a batch at a time, and the slots of the batch prefetched, before the first of them
+is counted - so that the cache misses of the words the table has seen rarely overlap.
+
+The text is split into chunks at delimiters, and every thread counts its chunks into tables of its own - no locks, no
+shared cache lines. The tables are split into shards by bits of the hash, so that the merge is parallel too: each
+thread merges one shard of all threads at a time, and a word is only ever in one shard.
+
+    mk::MappedFile corpus{"corpus.txt"};
+    mk::WordFrequencies words = mk::countWords(corpus.text());        // all hardware threads
+    for (const mk::WordCount &w : words.top(10))                      // the most frequent first
+        cout << w.word << ": " << w.count << "\n";
+
+The words are views into the text: it must outlive the counts. Words are counted as they are written ("The" is not
+"the"), as the tokenizer splits them.
+*/
+namespace mk
+{
+
+struct WordCount
+{
+    std::string_view word;
+    std::uint64_t count;
+};
+
+// The first 8 bytes of word (little endian, zeros after its end), read without a loop: words up to 8 bytes long as
+// two overlapping loads, the one from the end shifted into place.
+inline std::uint64_t wordHead(std::string_view word)
+{
+    const char *p = word.data();
+    const std::size_t n = word.size();
+    if (n >= 8)
+    {
+        std::uint64_t v;
+        std::memcpy(&v, p, 8);
+        return v;
+    }
+    if (n >= 4)
+    {
+        std::uint32_t first, last;
+        std::memcpy(&first, p, 4);
+        std::memcpy(&last, p + n - 4, 4);
+        return first | static_cast<std::uint64_t>(last) << 8 * (n - 4);
+    }
+    if (n == 0)
+        return 0;
+    const auto byte = [&](std::size_t i) { return static_cast<std::uint64_t>(static_cast<unsigned char>(p[i])); };
+    return byte(0) | byte(n / 2) << 8 * (n / 2) | byte(n - 1) << 8 * (n - 1);
+}
+
+// 64 bits of hash of a word whose wordHead() is head: words up to 8 bytes in one step, longer ones 8 bytes at a time
+std::uint64_t hashWord(std::string_view word, std::uint64_t head);
+
+inline std::uint64_t hashWord(std::string_view word)
+{
+    return hashWord(word, wordHead(word));
+}
+
+// an open-addressing hash table from words to counts, at most half full
+class WordTable
+{
+    // 32 bytes: two to a cache line
+    struct Slot
+    {
+        std::uint64_t count;
+        const char *data;   // nullptr: an empty slot (there are no empty words)
+        std::uint64_t head; // wordHead(): words of up to 8 bytes are compared without going to the text
+        std::uint32_t size; // words are shorter than 4 GB
+        std::uint32_t hash; // the low bits of the hash: enough for the slot of a table of up to 2^32 slots
+    };
+    std::vector<Slot> slots;
+    std::size_t mask;
+    std::size_t used = 0;
+
+    static bool same(const Slot &slot, std::string_view word, std::uint64_t hash, std::uint64_t head)
+    {
+        return slot.hash == static_cast<std::uint32_t>(hash) && slot.size == word.size() && slot.head == head &&
+               (word.size() <= 8 || std::memcmp(slot.data + 8, word.data() + 8, word.size() - 8) == 0);
+    }
+
+    void grow();
+
+  public:
+    // capacity: a power of two
+    explicit WordTable(std::size_t capacity = 1024);
+
+    // count word, whose hashWord() is hash and whose wordHead() is head, n times more
+    void add(std::string_view word, std::uint64_t hash, std::uint64_t head, std::uint64_t n)
+    {
+        for (std::size_t i = hash & mask;; i = (i + 1) & mask)
+        {
+            Slot &slot = slots[i];
+            if (slot.data == nullptr)
+            {
+                slot.count = n;
+                slot.data = word.data();
+                slot.head = head;
+                slot.size = static_cast<std::uint32_t>(word.size());
+                slot.hash = static_cast<std::uint32_t>(hash);
+                if (++used * 2 > slots.size())
+                    grow();
+                return;
+            }
+            if (same(slot, word, hash, head))
+            {
+                slot.count += n;
+                return;
+            }
+        }
+    }
+
+    void add(std::string_view word, std::uint64_t hash, std::uint64_t n = 1)
+    {
+        add(word, hash, wordHead(word), n);
+    }
+
+    // ask for the cache line of hash's slot now, to add the word a little later
+    void prefetch(std::uint64_t hash) const
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(&slots[hash & mask]);
+#endif
+    }
+
+    std::uint64_t count(std::string_view word, std::uint64_t hash) const;
+
+    // distinct words
+    std::size_t size() const
+    {
+        return used;
+    }
+
+    // f(word, hash, head, count) for every word, in no particular order
+    template <typename F> void forEach(F f) const
+    {
+        for (const Slot &slot : slots)
+            if (slot.data != nullptr)
+                f(std::string_view{slot.data, slot.size}, std::uint64_t{slot.hash}, slot.head, slot.count);
+    }
+};
+
+class WordFrequencies
+{
+    std::vector<WordTable> shards; // a word is in shard shardOf(its hash)
+    std::uint64_t words = 0;
+
+    friend WordFrequencies countWords(std::string_view text, unsigned threads, const Delimiters &delimiters);
+
+  public:
+    // all the words counted
+    std::uint64_t total() const
+    {
+        return words;
+    }
+
+    // different words
+    std::size_t distinct() const;
+
+    std::uint64_t count(std::string_view word) const;
+
+    // The n most frequent words, the most frequent first; words with the same count in alphabetical order.
+    std::vector<WordCount> top(std::size_t n) const;
+};
+
+// The words of text (as tokens() splits them) and how often each occurs, counted by threads threads (0: one per
+// hardware thread).
+WordFrequencies countWords(std::string_view text, unsigned threads = 0,
+                           const Delimiters &delimiters = Delimiters::spaces());
+
+} // namespace mk